@@ -0,0 +1,636 @@
+/* Using mkdtemp, clock_gettime, getopt & strdup, need POSIX 2008 */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "tasklib.h"
+#include "tasklist.h"
+
+/* Number of times every operation is run, keeping the fastest */
+#define RUNS 3
+/* Largest list generated, in bytes */
+#define MAX_LIST_BYTES (256L << 20)
+/* Size of the blocks lists are generated and copied in */
+#define BLOCK_SIZE 65536
+
+static const char usage[] =
+    "Usage: %s [-n max_tasks] OUTPUT [BASELINE]\n"
+    "Times every command on generated lists and writes the results to\n"
+    "OUTPUT, comparing them with an earlier OUTPUT if BASELINE is given.\n";
+
+/* Numbers of tasks in the generated lists */
+static const long list_tasks[] = {1000, 10000, 100000, 1000000, 10000000};
+/* Lengths of the tasks in the generated lists */
+static const int task_lengths[] = {16, 1000};
+
+/* Where a benchmark works */
+struct setup {
+    // Directory holding the working list and nothing else
+    char *dir;
+    // The working list and the generated one it's copied from, which is
+    // kept outside of the directory
+    char *file;
+    char *master;
+    long tasks;
+    int length;
+};
+
+/* An operation to time */
+struct operation {
+    const char *name;
+    // Whether it modifies the list, which then needs a fresh copy per run
+    int modifies;
+    // Runs the operation, returning an error message or NULL on success
+    const char *(*run)(const struct setup *setup);
+    // Prepares every run of the operation without being timed, or NULL if
+    // there is nothing to prepare
+    const char *(*prepare)(const struct setup *setup);
+};
+
+/* A timed operation, as one line of the output */
+struct result {
+    char *name;
+    long tasks;
+    int length;
+    // Fastest run in seconds, or -1 if it failed
+    double seconds;
+    // Peak resident set size in KiB
+    long peak_rss;
+};
+
+/*
+ * Private helper functions
+ */
+
+/**
+ * Returns a position in the middle of the list, as a string.
+ *
+ * @param setup The setup
+ * @param buffer Buffer of at least 24 characters for the string
+ * @return The buffer
+ */
+static char *middle(const struct setup *setup, char *buffer) {
+    sprintf(buffer, "%ld", setup->tasks / 2 + 1);
+
+    return buffer;
+}
+
+/**
+ * Writes a list of tasks of the given length.
+ *
+ * The tasks are words separated by spaces, so long ones need wrapping, and
+ * every one is different, so they have plenty of words to index.
+ *
+ * @param path Where to write the list
+ * @param tasks Number of tasks
+ * @param length Length of every task
+ * @return 0 on success or -1 on error
+ */
+static int generate(const char *path, long tasks, int length) {
+    FILE *fp;
+    if ((fp = fopen(path, "w")) == NULL) {
+        return -1;
+    }
+    static const char *words[] = {
+        "buy", "milk", "call", "mom", "fix", "bike", "write", "report",
+        "water", "plants", "book", "flight", "pay", "rent", "clean", "desk"
+    };
+    char *line = malloc(length + 2);
+    for (long i = 0; i < tasks; ++i) {
+        int n = snprintf(line, length + 1, "task%ld", i);
+        for (unsigned long w = i; n < length; w = w * 7 + 3) {
+            n += snprintf(line + n, length + 1 - n, " %s", words[w % 16]);
+        }
+        line[length] = '\n';
+        if (fwrite(line, 1, length + 1, fp) != (size_t) length + 1) {
+            free(line);
+            fclose(fp);
+            return -1;
+        }
+    }
+    free(line);
+
+    return fclose(fp) == EOF ? -1 : 0;
+}
+
+/**
+ * Copies a file over another one.
+ *
+ * @param from Path of the file to copy
+ * @param to Path of the copy
+ * @return 0 on success or -1 on error
+ */
+static int copy_file(const char *from, const char *to) {
+    int in, out;
+    if ((in = open(from, O_RDONLY)) == -1) {
+        return -1;
+    }
+    if ((out = open(to, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1) {
+        close(in);
+        return -1;
+    }
+    char *buffer = malloc(BLOCK_SIZE);
+    ssize_t got;
+    int result = 0;
+    while ((got = read(in, buffer, BLOCK_SIZE)) > 0) {
+        if (write(out, buffer, got) != got) {
+            result = -1;
+            break;
+        }
+    }
+    free(buffer);
+    if (got == -1) {
+        result = -1;
+    }
+    close(in);
+
+    return close(out) == -1 ? -1 : result;
+}
+
+/**
+ * Deletes all files in a directory.
+ *
+ * @param dir Path of the directory
+ */
+static void clean_dir(const char *dir) {
+    DIR *dp;
+    struct dirent *ep;
+    if ((dp = opendir(dir)) == NULL) {
+        return;
+    }
+    while ((ep = readdir(dp))) {
+        if (strcmp(ep->d_name, ".") == 0 || strcmp(ep->d_name, "..") == 0) {
+            continue;
+        }
+        char *path = malloc(strlen(dir) + strlen(ep->d_name) + 2);
+        sprintf(path, "%s/%s", dir, ep->d_name);
+        unlink(path);
+        free(path);
+    }
+    closedir(dp);
+}
+
+/**
+ * Returns the time elapsed since a point in time.
+ *
+ * @param start The point in time
+ * @return Seconds since then
+ */
+static double seconds_since(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) +
+        (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/*
+ * The operations, each of which gets the setup and returns an error
+ * message or NULL on success
+ */
+
+// The list prepared for the operations on a TaskList itself
+static TaskList prepared = NULL;
+
+/** Appends a task, like t -a. */
+static const char *run_add(const struct setup *setup) {
+    char *tasks[] = {"New task at the end", NULL};
+    return tasklib_add(setup->file, tasks, 0, &sink_stdout);
+}
+
+/** Prepends a task, like t -p. */
+static const char *run_prepend(const struct setup *setup) {
+    char *tasks[] = {"New task at the start", NULL};
+    return tasklib_prepend(setup->file, tasks, 0, &sink_stdout);
+}
+
+/** Inserts a task in the middle, like t -i. */
+static const char *run_insert(const struct setup *setup) {
+    char position[24];
+    char *args[] = {middle(setup, position), "New task in the middle", NULL};
+    return tasklib_insert(setup->file, args, 0, &sink_stdout);
+}
+
+/** Completes the task in the middle, like t -d. */
+static const char *run_done(const struct setup *setup) {
+    char position[24];
+    char *args[] = {middle(setup, position), NULL};
+    return tasklib_done(setup->file, args, 0, &sink_stdout);
+}
+
+/** Moves the first task to the end, like t -m. */
+static const char *run_move(const struct setup *setup) {
+    char last[24];
+    sprintf(last, "%ld", setup->tasks);
+    char *args[] = {"1", last, NULL};
+    return tasklib_move(setup->file, args, 0, &sink_stdout);
+}
+
+/** Sorts the list ignoring case, like t -S i. */
+static const char *run_sort(const struct setup *setup) {
+    char *args[] = {"i", NULL};
+    return tasklib_sort(setup->file, args, 0, &sink_stdout);
+}
+
+/** Prints the list, like t. */
+static const char *run_list(const struct setup *setup) {
+    char *files[] = {setup->file, NULL};
+    return tasklib_list(files, NULL, &sink_stdout);
+}
+
+/** Prints 100 tasks from the middle, like t -R. */
+static const char *run_range(const struct setup *setup) {
+    char page[56], position[24];
+    sprintf(page, "%s-%ld", middle(setup, position), setup->tasks / 2 + 100);
+    char *files[] = {setup->file, NULL};
+    return tasklib_range(files, page, NULL, &sink_stdout);
+}
+
+/** Prints the list names with their number of tasks, like t -l -v. */
+static const char *run_names(const struct setup *setup) {
+    return tasklib_names(setup->dir, 1, NULL, &sink_stdout);
+}
+
+/** Searches for text that doesn't occur, like t -g. */
+static const char *run_search(const struct setup *setup) {
+    char *args[] = {"no such text", NULL};
+    return tasklib_search(setup->dir, args, 0, NULL, &sink_stdout);
+}
+
+/** Looks up a word in the list, like t -k. */
+static const char *run_lookup(const struct setup *setup) {
+    char *args[] = {"report", NULL};
+    return tasklib_lookup(setup->dir, args, NULL, &sink_stdout);
+}
+
+/** Reads the list. */
+static const char *run_read(const struct setup *setup) {
+    TaskList list = tasklist_init(setup->file);
+    const char *error = tasklist_read(list);
+    tasklist_destroy(list);
+    return error;
+}
+
+/** Reads the list for printing it. */
+static const char *prepare_read(const struct setup *setup) {
+    prepared = tasklist_init(setup->file);
+    return tasklist_read(prepared);
+}
+
+/** Reads the list and prepends a task, for writing all of it. */
+static const char *prepare_change(const struct setup *setup) {
+    const char *error = prepare_read(setup);
+    return error ? error :
+        tasklist_insert(prepared, 1, "New task at the start");
+}
+
+/** Writes the prepared list. */
+static const char *run_write(const struct setup *setup) {
+    return tasklist_write(prepared);
+}
+
+/** Prints the prepared list. */
+static const char *run_print(const struct setup *setup) {
+    return tasklist_print(prepared, &sink_stdout);
+}
+
+static const struct operation operations[] = {
+    {"add", 1, run_add, NULL},
+    {"prepend", 1, run_prepend, NULL},
+    {"insert", 1, run_insert, NULL},
+    {"done", 1, run_done, NULL},
+    {"move", 1, run_move, NULL},
+    {"sort", 1, run_sort, NULL},
+    {"list", 0, run_list, NULL},
+    {"range", 0, run_range, NULL},
+    // The catalog and word index are built by the first run and used by
+    // the others, as they would be in daily use
+    {"names", 0, run_names, NULL},
+    {"search", 0, run_search, NULL},
+    {"lookup", 0, run_lookup, NULL},
+    {"tasklist_read", 0, run_read, NULL},
+    {"tasklist_write", 1, run_write, prepare_change},
+    {"tasklist_print", 0, run_print, prepare_read}
+};
+
+/**
+ * Runs an operation in a child process, so it starts out like a fresh
+ * invocation of tasuke and its peak memory use can be told apart.
+ *
+ * @param operation The operation
+ * @param setup The setup
+ * @param fresh Copy the generated list over the working one first (0 =
+ *              false, 1 = true)
+ * @param seconds Set to the time the operation took
+ * @param peak_rss Set to the peak resident set size of the child in KiB
+ * @return 0 on success or -1 on error
+ */
+static int time_operation(
+    const struct operation *operation, const struct setup *setup, int fresh,
+    double *seconds, long *peak_rss) {
+    int pipefd[2];
+    if (pipe(pipefd) == -1) {
+        return -1;
+    }
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid == -1) {
+        close(pipefd[0]);
+        close(pipefd[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        close(pipefd[0]);
+        if (fresh) {
+            clean_dir(setup->dir);
+            if (copy_file(setup->master, setup->file) == -1) {
+                _exit(EXIT_FAILURE);
+            }
+        }
+        // Whatever is printed goes nowhere, but still has to be formatted
+        int null = open("/dev/null", O_WRONLY);
+        if (null == -1 || dup2(null, STDOUT_FILENO) == -1) {
+            _exit(EXIT_FAILURE);
+        }
+        if (operation->prepare && operation->prepare(setup)) {
+            _exit(EXIT_FAILURE);
+        }
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        const char *error = operation->run(setup);
+        fflush(stdout);
+        double result[2] = {seconds_since(&start), 0};
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        result[1] = usage.ru_maxrss;
+        if (error) {
+            fprintf(stderr, "%s: %s", operation->name, error);
+            _exit(EXIT_FAILURE);
+        }
+        if (write(pipefd[1], result, sizeof(result)) != sizeof(result)) {
+            _exit(EXIT_FAILURE);
+        }
+        _exit(EXIT_SUCCESS);
+    }
+
+    close(pipefd[1]);
+    double result[2];
+    ssize_t got = read(pipefd[0], result, sizeof(result));
+    close(pipefd[0]);
+    int status;
+    while (waitpid(pid, &status, 0) == -1 && errno == EINTR);
+    if (got != sizeof(result) || !WIFEXITED(status) ||
+        WEXITSTATUS(status) != EXIT_SUCCESS) {
+        return -1;
+    }
+    *seconds = result[0];
+    *peak_rss = (long) result[1];
+
+    return 0;
+}
+
+/**
+ * Reads the results of an earlier run.
+ *
+ * @param path Path of the earlier output
+ * @param count Set to the number of results
+ * @return Array of results (freed by user with free_results()) or NULL if
+ *         the file can't be read
+ */
+static struct result *read_results(const char *path, int *count) {
+    FILE *fp;
+    if ((fp = fopen(path, "r")) == NULL) {
+        return NULL;
+    }
+    int size = 16;
+    struct result *results = malloc(size * sizeof(struct result));
+    *count = 0;
+    char line[256], name[64];
+    while (fgets(line, sizeof(line), fp)) {
+        struct result result;
+        // Comments and the header don't parse
+        if (sscanf(line, "%63s %ld %d %lf %*s %*s %ld", name, &result.tasks,
+            &result.length, &result.seconds, &result.peak_rss) != 5) {
+            continue;
+        }
+        if (*count == size) {
+            size *= 2;
+            results = realloc(results, size * sizeof(struct result));
+        }
+        result.name = strdup(name);
+        results[(*count)++] = result;
+    }
+    fclose(fp);
+
+    return results;
+}
+
+/**
+ * Frees an array of results.
+ *
+ * @param results The results
+ * @param count Number of results
+ */
+static void free_results(struct result *results, int count) {
+    for (int i = 0; i < count; ++i) {
+        free(results[i].name);
+    }
+    free(results);
+}
+
+/**
+ * Prints how the results compare with earlier ones.
+ *
+ * @param results The results
+ * @param count Number of results
+ * @param baseline The earlier results
+ * @param baseline_count Number of earlier results
+ */
+static void compare(
+    const struct result *results, int count, const struct result *baseline,
+    int baseline_count) {
+    printf("%-16s %9s %6s %12s %12s %8s %8s\n", "operation", "tasks",
+        "length", "baseline_s", "current_s", "time", "rss");
+    for (int i = 0; i < count; ++i) {
+        const struct result *old = NULL;
+        for (int j = 0; j < baseline_count && !old; ++j) {
+            if (strcmp(baseline[j].name, results[i].name) == 0 &&
+                baseline[j].tasks == results[i].tasks &&
+                baseline[j].length == results[i].length) {
+                old = &baseline[j];
+            }
+        }
+        if (old == NULL || old->seconds <= 0 || results[i].seconds <= 0) {
+            continue;
+        }
+        printf("%-16s %9ld %6d %12.6f %12.6f %+7.1f%% %+7.1f%%\n",
+            results[i].name, results[i].tasks, results[i].length,
+            old->seconds, results[i].seconds,
+            100 * (results[i].seconds / old->seconds - 1),
+            100 * ((double) results[i].peak_rss / old->peak_rss - 1));
+    }
+}
+
+int main(int argc, char *argv[]) {
+    /*
+     * Parse the command line
+     */
+    long max_tasks = 10000000;
+    int c;
+    while ((c = getopt(argc, argv, "n:")) != -1) {
+        if (c != 'n' || (max_tasks = strtol(optarg, NULL, 10)) <= 0) {
+            fprintf(stderr, usage, argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (argc - optind < 1 || argc - optind > 2) {
+        fprintf(stderr, usage, argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    const char *output_path = argv[optind];
+    const char *baseline_path = argv[optind + 1];
+    FILE *output;
+    if ((output = fopen(output_path, "w")) == NULL) {
+        fprintf(stderr, "Unable to open %s\n", output_path);
+        exit(EXIT_FAILURE);
+    }
+
+    /*
+     * Work in a directory of our own
+     */
+    const char *tmp = getenv("TMPDIR");
+    char *dir = malloc(strlen(tmp ? tmp : "/tmp") + 21);
+    sprintf(dir, "%s/tasuke-bench-XXXXXX", tmp ? tmp : "/tmp");
+    if (mkdtemp(dir) == NULL) {
+        fprintf(stderr, "Unable to create %s\n", dir);
+        exit(EXIT_FAILURE);
+    }
+    struct setup setup;
+    setup.dir = malloc(strlen(dir) + 6);
+    sprintf(setup.dir, "%s/work", dir);
+    setup.file = malloc(strlen(dir) + 15);
+    sprintf(setup.file, "%s/work/todo.txt", dir);
+    setup.master = malloc(strlen(dir) + 12);
+    sprintf(setup.master, "%s/master.txt", dir);
+    if (mkdir(setup.dir, 0700) == -1) {
+        fprintf(stderr, "Unable to create %s\n", setup.dir);
+        exit(EXIT_FAILURE);
+    }
+
+    // The environment changes what the commands do, so it's noted down
+    const char *variables[] = {
+        "TASUKE_SYNC", "TASUKE_IN_PLACE", "TASUKE_JOURNAL", "TASUKE_INDEX",
+        NULL
+    };
+    fprintf(output, "# tasuke benchmark, fastest of %d runs", RUNS);
+    for (const char **name = variables; *name; ++name) {
+        const char *value = getenv(*name);
+        fprintf(output, ", %s=%s", *name, value ? value : "");
+    }
+    fprintf(output, "\noperation\ttasks\ttask_length\tseconds\t"
+        "tasks_per_second\tmb_per_second\tpeak_rss_kb\n");
+
+    /*
+     * Time every operation on every list
+     */
+    int results_size = 64, result_count = 0;
+    struct result *results = malloc(results_size * sizeof(struct result));
+    int failed = 0;
+    int list_count = sizeof(list_tasks) / sizeof(list_tasks[0]);
+    int length_count = sizeof(task_lengths) / sizeof(task_lengths[0]);
+    int operation_count = sizeof(operations) / sizeof(operations[0]);
+    for (int l = 0; l < length_count; ++l) {
+        for (int t = 0; t < list_count; ++t) {
+            setup.tasks = list_tasks[t];
+            setup.length = task_lengths[l];
+            double bytes = (double) setup.tasks * (setup.length + 1);
+            if (setup.tasks > max_tasks || bytes > MAX_LIST_BYTES) {
+                continue;
+            }
+            fprintf(stderr, "%ld tasks of %d bytes\n", setup.tasks,
+                setup.length);
+            if (generate(setup.master, setup.tasks, setup.length) == -1) {
+                fprintf(stderr, "Unable to generate list\n");
+                exit(EXIT_FAILURE);
+            }
+
+            for (int o = 0; o < operation_count; ++o) {
+                const struct operation *operation = &operations[o];
+                double best = -1;
+                long peak_rss = 0;
+                for (int run = 0; run < RUNS; ++run) {
+                    double seconds;
+                    long rss;
+                    // Lists that aren't modified only need copying once
+                    int fresh = operation->modifies || run == 0;
+                    if (time_operation(
+                        operation, &setup, fresh, &seconds, &rss) == -1) {
+                        best = -1;
+                        break;
+                    }
+                    best = best < 0 || seconds < best ? seconds : best;
+                    peak_rss = rss > peak_rss ? rss : peak_rss;
+                }
+                if (best < 0) {
+                    fprintf(stderr, "%s failed\n", operation->name);
+                    failed = 1;
+                }
+
+                fprintf(output, "%s\t%ld\t%d\t%.6f\t%.0f\t%.1f\t%ld\n",
+                    operation->name, setup.tasks, setup.length, best,
+                    best > 0 ? setup.tasks / best : 0,
+                    best > 0 ? bytes / best / 1e6 : 0, peak_rss);
+                fflush(output);
+                if (result_count == results_size) {
+                    results_size *= 2;
+                    results = realloc(
+                        results, results_size * sizeof(struct result));
+                }
+                results[result_count].name = strdup(operation->name);
+                results[result_count].tasks = setup.tasks;
+                results[result_count].length = setup.length;
+                results[result_count].seconds = best;
+                results[result_count].peak_rss = peak_rss;
+                ++result_count;
+            }
+        }
+    }
+    fclose(output);
+    clean_dir(setup.dir);
+    rmdir(setup.dir);
+    unlink(setup.master);
+    rmdir(dir);
+
+    /*
+     * Compare with the baseline, if there is one
+     */
+    if (baseline_path) {
+        int baseline_count;
+        struct result *baseline = read_results(baseline_path, &baseline_count);
+        if (baseline == NULL) {
+            fprintf(stderr, "Unable to read %s\n", baseline_path);
+            failed = 1;
+        } else {
+            compare(results, result_count, baseline, baseline_count);
+            free_results(baseline, baseline_count);
+        }
+    }
+
+    // Cleanup
+    free_results(results, result_count);
+    free(setup.master);
+    free(setup.file);
+    free(setup.dir);
+    free(dir);
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,605 @@
+/* Using strdup, strndup, strcasecmp & st_mtim, need POSIX 2008 */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "catalog.h"
+
+#define STARTING_CAPACITY 16
+/* Name of the catalog file inside the list directory */
+#define CATALOG_NAME ".catalog"
+/* Identifies (the format of) a catalog */
+#define CATALOG_MAGIC "tasuke-catalog 1"
+
+/* A list in the catalog */
+struct entry {
+    char *name;
+    // Number of tasks, or -1 if they need to be counted
+    long count;
+    // Version of the list the tasks were counted for
+    struct catalog_stamp stamp;
+};
+
+/*
+ * The catalog is a text file in the list directory. Its first line holds
+ * the magic, the number of lists and the modification time the directory
+ * had when it was last scanned. Every list follows on a line of its own,
+ * as its number of tasks, its stamp and its name, in alphabetical order.
+ * It's rewritten in place rather than replaced, since that would change the
+ * modification time of the directory.
+ */
+struct catalog {
+    char *dir;
+    // Descriptor of the locked catalog file, or -1 if it can't be used
+    int fd;
+    // Whether the file can be written (0 = false, 1 = true)
+    int writable;
+    int64_t dir_mtime;
+    int64_t dir_mtime_nsec;
+    struct entry *entries;
+    int length;
+    int array_size;
+    // Whether the entries differ from what's in the file
+    int changed;
+};
+
+/*
+ * Private helper functions
+ */
+
+/**
+ * Builds the path to a file in a directory.
+ *
+ * Because a new string needs to be allocated, the user must free it.
+ *
+ * @param dir Full path to the directory
+ * @param name Name of the file
+ * @param extension Extension to add to the name, including the dot
+ * @return The path (freed by user)
+ */
+static char *dir_path(
+    const char *dir, const char *name, const char *extension) {
+    size_t dir_length = strlen(dir);
+    char *path = malloc(dir_length + strlen(name) + strlen(extension) + 2);
+    // Choose format based on whether there is a trailing slash already
+    const char *path_format =
+        dir_length > 0 && dir[dir_length - 1] == '/' ? "%s%s%s" : "%s/%s%s";
+    sprintf(path, path_format, dir, name, extension);
+
+    return path;
+}
+
+/**
+ * Compares two list names, ignoring case unless that's the only difference.
+ *
+ * @param name1 The first name
+ * @param name2 The second name
+ * @return Integer greater than, equal to or less than 0 depending on how
+ *         name1 compares to name2.
+ */
+static int compare_names(const char *name1, const char *name2) {
+    int result = strcasecmp(name1, name2);
+
+    return result ? result : strcmp(name1, name2);
+}
+
+/**
+ * Compares two entries by their name.
+ *
+ * This is a comparison function to be passed into qsort().
+ *
+ * @param e1 The first entry
+ * @param e2 The second entry
+ * @return Integer greater than, equal to or less than 0 depending on how
+ *         e1 compares to e2.
+ */
+static int cmpentryp(const void *e1, const void *e2) {
+    return compare_names(
+        ((const struct entry *) e1)->name, ((const struct entry *) e2)->name);
+}
+
+/**
+ * Finds where a list is or would be in the sorted entries.
+ *
+ * @param entries The sorted entries
+ * @param length Number of entries
+ * @param name Name of the list
+ * @param found Set to whether the list is there (0 = false, 1 = true)
+ * @return Index of the list or of the first entry after it
+ */
+static int find(
+    const struct entry *entries, int length, const char *name, int *found) {
+    int low = 0, high = length;
+    while (low < high) {
+        int middle = low + (high - low) / 2;
+        if (compare_names(entries[middle].name, name) < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    *found = low < length && strcmp(entries[low].name, name) == 0;
+
+    return low;
+}
+
+/**
+ * Makes room for one more entry.
+ *
+ * @param catalog The Catalog
+ */
+static void reserve(Catalog catalog) {
+    if (catalog->length == catalog->array_size) {
+        catalog->array_size *= 2;
+        catalog->entries = realloc(
+            catalog->entries, catalog->array_size * sizeof(struct entry));
+    }
+}
+
+/**
+ * Frees all entries of the Catalog.
+ *
+ * @param catalog The Catalog
+ */
+static void clear(Catalog catalog) {
+    for (int i = 0; i < catalog->length; ++i) {
+        free(catalog->entries[i].name);
+    }
+    catalog->length = 0;
+}
+
+/**
+ * Parses a number followed by a separator.
+ *
+ * @param text The text, advanced past the separator
+ * @param separator The character that needs to follow the number
+ * @param value Set to the number
+ * @return 0 on success or -1 if there is no such number
+ */
+static int parse_number(char **text, char separator, int64_t *value) {
+    char *end;
+    errno = 0;
+    long long parsed = strtoll(*text, &end, 10);
+    if (end == *text || *end != separator || errno) {
+        return -1;
+    }
+    *value = parsed;
+    *text = end + 1;
+
+    return 0;
+}
+
+/**
+ * Reads the entries from the catalog file.
+ *
+ * Anything that isn't exactly as expected leaves the Catalog empty, as if
+ * the directory was never scanned.
+ *
+ * @param catalog The Catalog (fd open)
+ */
+static void load(Catalog catalog) {
+    struct stat st;
+    if (fstat(catalog->fd, &st) == -1 || st.st_size == 0) {
+        return;
+    }
+    char *buffer = malloc(st.st_size + 1);
+    size_t length = 0;
+    while (length < (size_t) st.st_size) {
+        ssize_t got = pread(
+            catalog->fd, buffer + length, st.st_size - length, length);
+        if (got <= 0) {
+            break;
+        }
+        length += got;
+    }
+    buffer[length] = '\0';
+
+    // Parse the header, then the entries one line each
+    int64_t count, dir_mtime, dir_mtime_nsec;
+    size_t magic_length = strlen(CATALOG_MAGIC);
+    char *line = buffer + magic_length + 1;
+    int valid = length > magic_length &&
+        strncmp(buffer, CATALOG_MAGIC " ", magic_length + 1) == 0 &&
+        parse_number(&line, ' ', &count) == 0 &&
+        parse_number(&line, ' ', &dir_mtime) == 0 &&
+        parse_number(&line, '\n', &dir_mtime_nsec) == 0;
+    char *end = buffer + length;
+    while (valid && line < end) {
+        struct entry entry;
+        int64_t entry_count;
+        char *newline = memchr(line, '\n', end - line);
+        if (newline == NULL || parse_number(&line, ' ', &entry_count) == -1 ||
+            parse_number(&line, ' ', &entry.stamp.ino) == -1 ||
+            parse_number(&line, ' ', &entry.stamp.size) == -1 ||
+            parse_number(&line, ' ', &entry.stamp.mtime) == -1 ||
+            parse_number(&line, ' ', &entry.stamp.mtime_nsec) == -1 ||
+            parse_number(&line, ' ', &entry.stamp.journal_size) == -1 ||
+            line >= newline || entry_count < -1) {
+            valid = 0;
+            break;
+        }
+        entry.count = entry_count;
+        entry.name = strndup(line, newline - line);
+        // Names must be in order for looking them up
+        if (catalog->length > 0 && compare_names(
+            catalog->entries[catalog->length - 1].name, entry.name) >= 0) {
+            free(entry.name);
+            valid = 0;
+            break;
+        }
+        reserve(catalog);
+        catalog->entries[catalog->length++] = entry;
+        line = newline + 1;
+    }
+    free(buffer);
+
+    if (!valid || count != catalog->length) {
+        clear(catalog);
+        return;
+    }
+    catalog->dir_mtime = dir_mtime;
+    catalog->dir_mtime_nsec = dir_mtime_nsec;
+}
+
+/**
+ * Reads the names of the lists from the directory, keeping what's known
+ * about the ones that were there before.
+ *
+ * @param catalog The Catalog
+ * @return 0 on success or -1 if the directory can't be read
+ */
+static int scan(Catalog catalog) {
+    DIR *dp;
+    struct dirent *ep;
+    if ((dp = opendir(catalog->dir)) == NULL) {
+        return -1;
+    }
+
+    int size = STARTING_CAPACITY, length = 0;
+    struct entry *entries = malloc(size * sizeof(struct entry));
+    while ((ep = readdir(dp))) {
+        // Only list files count, not their journals or anything else
+        size_t name_length = strlen(ep->d_name);
+        if (name_length <= 4 ||
+            strcmp(ep->d_name + name_length - 4, ".txt") != 0) {
+            continue;
+        }
+        if (length == size) {
+            size *= 2;
+            entries = realloc(entries, size * sizeof(struct entry));
+        }
+        struct entry *entry = &entries[length++];
+        entry->name = strndup(ep->d_name, name_length - 4);
+        entry->count = -1;
+        memset(&entry->stamp, 0, sizeof(entry->stamp));
+        int found;
+        int i = find(
+            catalog->entries, catalog->length, entry->name, &found);
+        if (found) {
+            entry->count = catalog->entries[i].count;
+            entry->stamp = catalog->entries[i].stamp;
+        }
+    }
+    closedir(dp);
+    qsort(entries, length, sizeof(struct entry), cmpentryp);
+
+    // Replace the old entries
+    clear(catalog);
+    free(catalog->entries);
+    catalog->entries = entries;
+    catalog->length = length;
+    catalog->array_size = size;
+    catalog->changed = 1;
+
+    return 0;
+}
+
+/**
+ * Writes the entries over the catalog file.
+ *
+ * A name containing a newline can't be stored, which leaves the file as it
+ * was, so the directory is scanned again next time.
+ *
+ * @param catalog The Catalog (fd open for writing)
+ */
+static void store(Catalog catalog) {
+    size_t size = 64, length = 0;
+    char *buffer = malloc(size);
+    length += sprintf(buffer, "%s %d %lld %lld\n", CATALOG_MAGIC,
+        catalog->length, (long long) catalog->dir_mtime,
+        (long long) catalog->dir_mtime_nsec);
+    for (int i = 0; i < catalog->length; ++i) {
+        const struct entry *entry = &catalog->entries[i];
+        if (strchr(entry->name, '\n')) {
+            free(buffer);
+            return;
+        }
+        // Room for six numbers with their separators, the name and newline
+        size_t needed = 6 * 22 + strlen(entry->name) + 2;
+        while (size - length < needed) {
+            size *= 2;
+            buffer = realloc(buffer, size);
+        }
+        length += sprintf(
+            buffer + length, "%ld %lld %lld %lld %lld %lld %s\n",
+            entry->count, (long long) entry->stamp.ino,
+            (long long) entry->stamp.size, (long long) entry->stamp.mtime,
+            (long long) entry->stamp.mtime_nsec,
+            (long long) entry->stamp.journal_size, entry->name);
+    }
+
+    // The catalog is only a cache, so a failed write costs a scan at most.
+    // Cut off what's left of a longer one, or all of it if the write
+    // failed, which leaves a catalog that doesn't parse in the worst case.
+    size_t written = 0;
+    while (written < length) {
+        ssize_t n = pwrite(
+            catalog->fd, buffer + written, length - written, written);
+        if (n == -1) {
+            written = 0;
+            break;
+        }
+        written += n;
+    }
+    ftruncate(catalog->fd, written);
+    free(buffer);
+}
+
+/**
+ * Locks the catalog file, waiting as long as it takes.
+ *
+ * @param fd Descriptor of the catalog file
+ * @param type Type of lock (F_RDLCK or F_WRLCK)
+ * @return 0 on success or -1 on error
+ */
+static int lock(int fd, short type) {
+    struct flock lock = {0};
+    lock.l_type = type;
+    lock.l_whence = SEEK_SET;
+    while (fcntl(fd, F_SETLKW, &lock) == -1) {
+        if (errno != EINTR) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Splits the path of a list file into its directory and list name.
+ *
+ * Because new strings need to be allocated, the user must free them.
+ *
+ * @param file Full path to the list file
+ * @param dir Set to the directory (freed by user)
+ * @param name Set to the list name (freed by user)
+ */
+static void split_path(const char *file, char **dir, char **name) {
+    const char *name_start = strrchr(file, '/') + 1;
+    const char *name_end = strrchr(name_start, '.');
+    *dir = strndup(file, name_start - file);
+    *name = name_end ?
+        strndup(name_start, name_end - name_start) : strdup(name_start);
+}
+
+/*
+ * Public functions
+ */
+
+int catalog_stamp(const char *file, struct catalog_stamp *stamp) {
+    struct stat st;
+    if (stat(file, &st) == -1) {
+        return -1;
+    }
+    stamp->ino = st.st_ino;
+    stamp->size = st.st_size;
+    stamp->mtime = st.st_mtim.tv_sec;
+    stamp->mtime_nsec = st.st_mtim.tv_nsec;
+
+    // The journal sits next to the list file, with another extension
+    const char *name_start = strrchr(file, '/') + 1;
+    const char *name_end = strrchr(name_start, '.');
+    int length = name_end ? name_end - file : (int) strlen(file);
+    char *journal = malloc(length + 5);
+    sprintf(journal, "%.*s.log", length, file);
+    stamp->journal_size = stat(journal, &st) == 0 ? st.st_size : -1;
+    free(journal);
+
+    return 0;
+}
+
+Catalog catalog_open(const char *dir, int scan_dir) {
+    char *path = dir_path(dir, CATALOG_NAME, "");
+    int fd = open(path, scan_dir ? O_RDWR | O_CREAT : O_RDWR, 0666);
+    int writable = fd != -1;
+    // Without a catalog of its own, a directory that can't be written to
+    // is simply scanned every time
+    if (fd == -1 && scan_dir) {
+        fd = open(path, O_RDONLY);
+    }
+    free(path);
+    if (fd == -1 && !scan_dir) {
+        return NULL;
+    }
+    if (fd != -1 && lock(fd, writable ? F_WRLCK : F_RDLCK) == -1) {
+        close(fd);
+        if (!scan_dir) {
+            return NULL;
+        }
+        fd = -1;
+    }
+
+    Catalog catalog = malloc(sizeof(struct catalog));
+    catalog->dir = strdup(dir);
+    catalog->fd = fd;
+    catalog->writable = writable;
+    catalog->dir_mtime = -1;
+    catalog->dir_mtime_nsec = -1;
+    catalog->array_size = STARTING_CAPACITY;
+    catalog->entries = malloc(catalog->array_size * sizeof(struct entry));
+    catalog->length = 0;
+    catalog->changed = 0;
+    if (fd != -1) {
+        load(catalog);
+    }
+
+    // Only read the directory if lists may have come or gone since. Its
+    // modification time is taken first, so anything that happens during the
+    // scan makes for another one next time.
+    struct stat st;
+    if (scan_dir) {
+        if (stat(dir, &st) == -1) {
+            catalog_close(catalog);
+            return NULL;
+        }
+        if (st.st_mtim.tv_sec != catalog->dir_mtime ||
+            st.st_mtim.tv_nsec != catalog->dir_mtime_nsec) {
+            if (scan(catalog) == -1) {
+                catalog_close(catalog);
+                return NULL;
+            }
+            catalog->dir_mtime = st.st_mtim.tv_sec;
+            catalog->dir_mtime_nsec = st.st_mtim.tv_nsec;
+        }
+    }
+
+    return catalog;
+}
+
+int catalog_length(Catalog catalog) {
+    return catalog->length;
+}
+
+const char *catalog_name(Catalog catalog, int index) {
+    return catalog->entries[index].name;
+}
+
+long catalog_count(Catalog catalog, int index) {
+    const struct entry *entry = &catalog->entries[index];
+    if (entry->count == -1) {
+        return -1;
+    }
+    char *file = dir_path(catalog->dir, entry->name, ".txt");
+    struct catalog_stamp stamp;
+    int current = catalog_stamp(file, &stamp) == 0 &&
+        memcmp(&stamp, &entry->stamp, sizeof(stamp)) == 0;
+    free(file);
+
+    return current ? entry->count : -1;
+}
+
+void catalog_set(
+    Catalog catalog, const char *name, long count,
+    const struct catalog_stamp *stamp) {
+    int found;
+    int i = find(catalog->entries, catalog->length, name, &found);
+    if (!found) {
+        if (count == -1) {
+            return;
+        }
+        // Make room for the list where it belongs
+        reserve(catalog);
+        memmove(&catalog->entries[i + 1], &catalog->entries[i],
+            (catalog->length - i) * sizeof(struct entry));
+        ++catalog->length;
+        catalog->entries[i].name = strdup(name);
+    } else if (count == -1) {
+        free(catalog->entries[i].name);
+        memmove(&catalog->entries[i], &catalog->entries[i + 1],
+            (catalog->length - i - 1) * sizeof(struct entry));
+        --catalog->length;
+        catalog->changed = 1;
+        return;
+    }
+    catalog->entries[i].count = count;
+    catalog->entries[i].stamp = *stamp;
+    catalog->changed = 1;
+}
+
+void catalog_close(Catalog catalog) {
+    if (catalog->fd != -1) {
+        if (catalog->changed && catalog->writable) {
+            store(catalog);
+        }
+        // Closing the descriptor releases the lock
+        close(catalog->fd);
+    }
+    clear(catalog);
+    free(catalog->entries);
+    free(catalog->dir);
+    free(catalog);
+}
+
+void catalog_update(const char *file, long count) {
+    char *dir, *name;
+    split_path(file, &dir, &name);
+    Catalog catalog = catalog_open(dir, 0);
+    if (catalog) {
+        struct catalog_stamp stamp;
+        if (count != -1 && catalog_stamp(file, &stamp) == -1) {
+            count = -1;
+        }
+        catalog_set(catalog, name, count, &stamp);
+        catalog_close(catalog);
+    }
+    free(dir);
+    free(name);
+}
+
+void catalog_append(
+    const char *file, const struct catalog_stamp *before, char **tasks) {
+    // Tasks with a newline take more than one line, or break the journal
+    long added = 0;
+    for ( ; tasks[added]; ++added) {
+        if (strchr(tasks[added], '\n')) {
+            return;
+        }
+    }
+    char *dir, *name;
+    split_path(file, &dir, &name);
+    Catalog catalog = catalog_open(dir, 0);
+    free(dir);
+    if (catalog == NULL) {
+        free(name);
+        return;
+    }
+
+    // Only a count for the list as it was before can be carried forward,
+    // unless there was no list before
+    int found;
+    int i = find(catalog->entries, catalog->length, name, &found);
+    struct catalog_stamp after;
+    if (before == NULL && !found && catalog_stamp(file, &after) == 0) {
+        catalog_set(catalog, name, added, &after);
+    } else if (before && found && catalog->entries[i].count != -1 &&
+        memcmp(&catalog->entries[i].stamp, before, sizeof(*before)) == 0 &&
+        catalog_stamp(file, &after) == 0) {
+        long count = catalog->entries[i].count + added;
+        // Tasks appended to the file itself rather than its journal join a
+        // final line that lacks its newline
+        if (after.journal_size == before->journal_size && before->size > 0) {
+            char last = '\n';
+            int fd = open(file, O_RDONLY);
+            if (fd == -1 || pread(fd, &last, 1, before->size - 1) != 1) {
+                count = -1;
+            } else if (last != '\n') {
+                --count;
+            }
+            if (fd != -1) {
+                close(fd);
+            }
+        }
+        if (count != -1) {
+            catalog_set(catalog, name, count, &after);
+        }
+    }
+    catalog_close(catalog);
+    free(name);
+}
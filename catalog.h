@@ -0,0 +1,116 @@
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include <stdint.h>
+
+typedef struct catalog *Catalog;
+
+/*
+ * What identifies a version of a list file and its journal, for telling
+ * whether a recorded number of tasks is still right.
+ */
+struct catalog_stamp {
+    int64_t ino;
+    int64_t size;
+    int64_t mtime;
+    int64_t mtime_nsec;
+    // Size of the journal, or -1 if there is none
+    int64_t journal_size;
+};
+
+/**
+ * Takes the stamp of a list file as it is now.
+ *
+ * @param file Full path to the list file
+ * @param stamp Set to the stamp
+ * @return 0 on success, -1 if the file can't be accessed
+ */
+int catalog_stamp(const char *file, struct catalog_stamp *stamp);
+
+/**
+ * Opens the catalog of a directory, which holds the names of its lists in
+ * alphabetical order along with their number of tasks.
+ *
+ * The catalog is locked until it's closed. When scanning, a missing catalog
+ * is created and the names are brought up to date, which only requires
+ * reading the directory if it changed since the catalog was last scanned.
+ * Without scanning, the catalog is only opened if it exists and the names
+ * are taken as they are.
+ *
+ * @param dir Full path to the directory
+ * @param scan Whether to scan the directory (0 = false, 1 = true)
+ * @return The Catalog, or NULL if there is none or the directory can't be
+ *         read
+ */
+Catalog catalog_open(const char *dir, int scan);
+
+/**
+ * Returns the number of lists in the Catalog.
+ *
+ * @param catalog The Catalog
+ * @return Number of lists
+ */
+int catalog_length(Catalog catalog);
+
+/**
+ * Returns the name of a list in the Catalog.
+ *
+ * @param catalog The Catalog
+ * @param index Index of the list (0-based)
+ * @return The name, valid until the Catalog is closed
+ */
+const char *catalog_name(Catalog catalog, int index);
+
+/**
+ * Returns the number of tasks of a list in the Catalog, if it's known.
+ *
+ * It's only known if the list file and its journal haven't changed since
+ * it was recorded, which is checked without opening them.
+ *
+ * @param catalog The Catalog
+ * @param index Index of the list (0-based)
+ * @return Number of tasks or -1 if it isn't known
+ */
+long catalog_count(Catalog catalog, int index);
+
+/**
+ * Records the number of tasks of a list, adding the list if necessary.
+ *
+ * @param catalog The Catalog
+ * @param name Name of the list
+ * @param count Number of tasks, or -1 to remove the list
+ * @param stamp Stamp of the list the tasks were counted for
+ */
+void catalog_set(
+    Catalog catalog, const char *name, long count,
+    const struct catalog_stamp *stamp);
+
+/**
+ * Writes the Catalog if it changed, unlocks and releases it.
+ *
+ * @param catalog The Catalog
+ */
+void catalog_close(Catalog catalog);
+
+/**
+ * Records the number of tasks of a list that was just written or removed,
+ * if its directory has a catalog.
+ *
+ * @param file Full path to the list file
+ * @param count Number of tasks, or -1 if the list was removed
+ */
+void catalog_update(const char *file, long count);
+
+/**
+ * Records tasks that were just appended to a list, if its directory has a
+ * catalog that knew the number of tasks before.
+ *
+ * @param file Full path to the list file
+ * @param before Stamp of the list before appending, or NULL if it didn't
+ *               exist
+ * @param tasks The appended tasks, terminated by a NULL element
+ */
+void catalog_append(
+    const char *file, const struct catalog_stamp *before, char **tasks);
+
+#endif // CATALOG_H
@@ -0,0 +1,230 @@
+#include <stddef.h>
+#include <string.h>
+#include "command.h"
+#include "errors.h"
+
+/* Position of the option parser in a command line */
+struct parser {
+    int argc;
+    char **argv;
+    // Index of the argument being parsed
+    int index;
+    // Next option character in that argument, NULL between arguments
+    const char *next;
+    // Argument of the last option, if it takes one
+    const char *argument;
+};
+
+/**
+ * Returns the next option of a command line, like getopt does.
+ *
+ * Parsing stops at the first operand, "--" ends the options and "-" on its
+ * own is an operand. Unlike getopt, this doesn't print anything or keep any
+ * global state, so command lines can be parsed over and over again.
+ *
+ * @param parser The parser, which starts at index 1 with next set to NULL
+ * @param options The option characters, those taking an argument followed
+ *                by a colon
+ * @return The option, '?' for an unknown one or one missing its argument,
+ *         or -1 after the last option
+ */
+static int next_option(struct parser *parser, const char *options) {
+    // Move on to the next argument if it holds options
+    if (parser->next == NULL) {
+        if (parser->index >= parser->argc) {
+            return -1;
+        }
+        const char *arg = parser->argv[parser->index];
+        if (arg[0] != '-' || arg[1] == '\0') {
+            return -1;
+        }
+        ++parser->index;
+        if (strcmp(arg, "--") == 0) {
+            return -1;
+        }
+        parser->next = arg + 1;
+    }
+
+    // Options can be grouped in a single argument
+    char c = *parser->next++;
+    const char *option = c == ':' ? NULL : strchr(options, c);
+    parser->argument = NULL;
+    if (option && option[1] == ':') {
+        // The option argument is either the rest or the next argument
+        if (*parser->next != '\0') {
+            parser->argument = parser->next;
+        } else if (parser->index < parser->argc) {
+            parser->argument = parser->argv[parser->index++];
+        }
+        parser->next = NULL;
+        return parser->argument ? c : '?';
+    }
+    if (*parser->next == '\0') {
+        parser->next = NULL;
+    }
+
+    return option ? c : '?';
+}
+
+const char *command_parse(struct command *command, int argc, char **argv) {
+    /*
+     * Some flags & option argument variables for user input
+     */
+    int aflg = 0, pflg = 0, iflg = 0, dflg = 0, mflg = 0, Sflg = 0, rflg = 0;
+    int lflg = 0, gflg = 0, yflg = 0, kflg = 0, bflg = 0, Dflg = 0, hflg = 0;
+    int vflg = 0, nflg = 0, Rflg = 0, fflg = 0;
+    // Set to 1 if there is a problem parsing options
+    int errflg = 0;
+    // Pointers to option arguments
+    const char *nvalue = NULL, *svalue = NULL, *Rvalue = NULL;
+    const char *fvalue = NULL;
+
+    /*
+     * Simple argument parsing, mostly just setting flags
+     */
+    struct parser parser = {argc, argv, 1, NULL, NULL};
+    int c;
+    while ((c = next_option(&parser, "apidmSrlgykbDhvn:s:R:f:")) != -1) {
+        switch (c) {
+            case 'a':
+                aflg = 1;
+                break;
+            case 'p':
+                pflg = 1;
+                break;
+            case 'i':
+                iflg = 1;
+                break;
+            case 'd':
+                dflg = 1;
+                break;
+            case 'm':
+                mflg = 1;
+                break;
+            case 'S':
+                Sflg = 1;
+                break;
+            case 'r':
+                rflg = 1;
+                break;
+            case 'l':
+                lflg = 1;
+                break;
+            case 'g':
+                gflg = 1;
+                break;
+            case 'y':
+                yflg = 1;
+                break;
+            case 'k':
+                kflg = 1;
+                break;
+            case 'b':
+                bflg = 1;
+                break;
+            case 'D':
+                Dflg = 1;
+                break;
+            case 'h':
+                hflg = 1;
+                break;
+            case 'v':
+                vflg = 1;
+                break;
+            case 'n':
+                nflg = 1;
+                nvalue = parser.argument;
+                break;
+            case 's':
+                svalue = parser.argument;
+                break;
+            case 'R':
+                Rflg = 1;
+                Rvalue = parser.argument;
+                break;
+            case 'f':
+                fflg = 1;
+                fvalue = parser.argument;
+                break;
+            case '?':
+                // Unrecognized option or missing option argument
+                errflg = 1;
+                break;
+        }
+    }
+
+    // Asking for help trumps everything else
+    if (hflg) {
+        command->type = COMMAND_HELP;
+        return NULL;
+    }
+
+    /*
+     * Several checks for parsing problems and bad usage of flags
+     */
+    if (
+        // Problem noticed by the parser
+        errflg ||
+        // Mutually exclusive flags
+        aflg + pflg + iflg + dflg + mflg + Sflg + rflg + lflg + gflg + kflg +
+            bflg + Dflg + Rflg > 1 ||
+        // -r doesn't have -n option
+        nflg + rflg > 1 ||
+        // -l doesn't have -n option
+        lflg + rflg > 1 ||
+        // -b doesn't have -n option
+        nflg + bflg > 1 ||
+        // -y only applies to -g
+        yflg > gflg ||
+        // -f only applies to showing lists, names and matches
+        fflg + aflg + pflg + iflg + dflg + mflg + Sflg + rflg + bflg +
+            Dflg > 1 ||
+        // -n can't occur on its own
+        nflg > aflg + pflg + iflg + dflg + mflg + Sflg
+    ) {
+        return error_message(ERROR_USAGE);
+    }
+
+    /*
+     * Fill in the command
+     */
+    if (aflg) {
+        command->type = COMMAND_ADD;
+    } else if (pflg) {
+        command->type = COMMAND_PREPEND;
+    } else if (iflg) {
+        command->type = COMMAND_INSERT;
+    } else if (dflg) {
+        command->type = COMMAND_DONE;
+    } else if (mflg) {
+        command->type = COMMAND_MOVE;
+    } else if (Sflg) {
+        command->type = COMMAND_SORT;
+    } else if (rflg) {
+        command->type = COMMAND_REMOVE;
+    } else if (lflg) {
+        command->type = COMMAND_NAMES;
+    } else if (Rflg) {
+        command->type = COMMAND_RANGE;
+    } else if (gflg) {
+        command->type = COMMAND_SEARCH;
+    } else if (kflg) {
+        command->type = COMMAND_LOOKUP;
+    } else if (bflg) {
+        command->type = COMMAND_BATCH;
+    } else if (Dflg) {
+        command->type = COMMAND_SERVE;
+    } else {
+        // No command flag (= list command)
+        command->type = COMMAND_LIST;
+    }
+    command->verbose = vflg;
+    command->ignore_case = yflg;
+    command->list = nvalue;
+    command->dir = svalue;
+    command->range = Rvalue;
+    command->format = fvalue;
+    command->operands = &argv[parser.index];
+
+    return NULL;
+}
@@ -0,0 +1,56 @@
+#ifndef COMMAND_H
+#define COMMAND_H
+
+/* What a command does, by the option selecting it */
+enum command_type {
+    COMMAND_LIST = 0,
+    COMMAND_ADD = 'a',
+    COMMAND_PREPEND = 'p',
+    COMMAND_INSERT = 'i',
+    COMMAND_DONE = 'd',
+    COMMAND_MOVE = 'm',
+    COMMAND_SORT = 'S',
+    COMMAND_REMOVE = 'r',
+    COMMAND_NAMES = 'l',
+    COMMAND_RANGE = 'R',
+    COMMAND_SEARCH = 'g',
+    COMMAND_LOOKUP = 'k',
+    COMMAND_BATCH = 'b',
+    COMMAND_SERVE = 'D',
+    COMMAND_HELP = 'h'
+};
+
+/* A command line, broken down into its parts */
+struct command {
+    enum command_type type;
+    // Show list after modification (0 = false, 1 = true)
+    int verbose;
+    // Ignore case when searching (0 = false, 1 = true)
+    int ignore_case;
+    // Selected list and directory (NULL for default)
+    const char *list;
+    const char *dir;
+    // Positions to show, like "10-20" (NULL for all)
+    const char *range;
+    // Output format, like "json" (NULL for default)
+    const char *format;
+    // Remaining arguments, terminated by a NULL element
+    char **operands;
+};
+
+/**
+ * Parses a command line in the syntax of the tasuke utility.
+ *
+ * Options come before the operands, like with getopt, but parsing doesn't
+ * depend on or change any global state, so it can be repeated for any number
+ * of command lines. The operands point into argv.
+ *
+ * @param command The command to fill in
+ * @param argc Number of arguments, including the program name
+ * @param argv Array of arguments, starting with the program name and
+ *             terminated by a NULL element
+ * @return Error message or NULL on success
+ */
+const char *command_parse(struct command *command, int argc, char **argv);
+
+#endif // COMMAND_H
@@ -0,0 +1,33 @@
+#include <string.h>
+#include "errors.h"
+
+/* The messages and kinds of the errors, in the order of their names */
+static const struct {
+    const char *message;
+    enum tasuke_error kind;
+} errors[ERRORS] = {
+#define ERROR_ENTRY(name, message, kind) {message, kind},
+    ERROR_TABLE(ERROR_ENTRY)
+#undef ERROR_ENTRY
+};
+
+/*
+ * Public functions
+ */
+
+const char *error_message(enum error error) {
+    return errors[error].message;
+}
+
+enum tasuke_error error_kind(const char *message) {
+    if (message == NULL) {
+        return TASUKE_OK;
+    }
+    for (int i = 0; i < ERRORS; ++i) {
+        if (strcmp(message, errors[i].message) == 0) {
+            return errors[i].kind;
+        }
+    }
+
+    return TASUKE_ERROR_OTHER;
+}
@@ -0,0 +1,113 @@
+#ifndef ERRORS_H
+#define ERRORS_H
+
+/* What kind of problem a command ran into */
+enum tasuke_error {
+    TASUKE_OK = 0,
+    // The command or its arguments are invalid
+    TASUKE_ERROR_USAGE,
+    // An environment variable like TASUKE_SYNC has an invalid value
+    TASUKE_ERROR_CONFIG,
+    // The directory can't be accessed, created or read
+    TASUKE_ERROR_DIRECTORY,
+    // A list or its journal can't be read
+    TASUKE_ERROR_READ,
+    // A list or its journal can't be written or deleted
+    TASUKE_ERROR_WRITE,
+    // A list can't be locked
+    TASUKE_ERROR_LOCK,
+    // A list is still locked by someone else after TASUKE_LOCK_TIMEOUT
+    TASUKE_ERROR_TIMEOUT,
+    // A journal doesn't belong to its list or is damaged
+    TASUKE_ERROR_CORRUPT,
+    // The sink failed to take the output
+    TASUKE_ERROR_OUTPUT,
+    // The server for a directory can't be started or reached
+    TASUKE_ERROR_SERVER,
+    // Some of the commands run in batch mode failed
+    TASUKE_ERROR_BATCH,
+    // Anything else
+    TASUKE_ERROR_OTHER
+};
+
+/*
+ * Every error, with the message functions return for it and the kind of
+ * problem it is about. Adding an error here is all it takes for both.
+ */
+#define ERROR_TABLE(X) \
+    X(ERROR_USAGE, "Invalid usage\n", TASUKE_ERROR_USAGE) \
+    X(ERROR_FEW_ARGUMENTS, "Not enough arguments\n", TASUKE_ERROR_USAGE) \
+    X(ERROR_MANY_ARGUMENTS, "Too many arguments\n", TASUKE_ERROR_USAGE) \
+    X(ERROR_POSITION, "Position not a number\n", TASUKE_ERROR_USAGE) \
+    X(ERROR_INVALID_POSITION, "Invalid position\n", TASUKE_ERROR_USAGE) \
+    X(ERROR_RANGE, "Invalid range\n", TASUKE_ERROR_USAGE) \
+    X(ERROR_WORD, "Invalid word\n", TASUKE_ERROR_USAGE) \
+    X(ERROR_FORMAT, "Invalid format\n", TASUKE_ERROR_USAGE) \
+    X(ERROR_ORDER, "Invalid order\n", TASUKE_ERROR_USAGE) \
+    X(ERROR_NEWLINE, "Task contains a newline\n", TASUKE_ERROR_USAGE) \
+    X(ERROR_QUOTE, "Unterminated quote\n", TASUKE_ERROR_USAGE) \
+    X(ERROR_FLUSH_EVERY, "Flush interval not a number\n", \
+        TASUKE_ERROR_USAGE) \
+    X(ERROR_SYNC, "Invalid TASUKE_SYNC value\n", TASUKE_ERROR_CONFIG) \
+    X(ERROR_LOCK_TIMEOUT, "Invalid TASUKE_LOCK_TIMEOUT value\n", \
+        TASUKE_ERROR_CONFIG) \
+    X(ERROR_ACCESS_DIR, "Unable to access directory\n", \
+        TASUKE_ERROR_DIRECTORY) \
+    X(ERROR_OPEN_DIR, "Unable to open directory\n", TASUKE_ERROR_DIRECTORY) \
+    X(ERROR_OPEN_LIST, "Unable to open list\n", TASUKE_ERROR_READ) \
+    X(ERROR_READ_LIST, "Unable to read list\n", TASUKE_ERROR_READ) \
+    X(ERROR_OPEN_JOURNAL, "Unable to open journal\n", TASUKE_ERROR_READ) \
+    X(ERROR_READ_TASKS, "Unable to read tasks\n", TASUKE_ERROR_READ) \
+    X(ERROR_WRITE_LIST, "Unable to write to list\n", TASUKE_ERROR_WRITE) \
+    X(ERROR_CLOSE_LIST, "Unable to close list\n", TASUKE_ERROR_WRITE) \
+    X(ERROR_WRITE_PART, "Unable to write part of a list\n", \
+        TASUKE_ERROR_WRITE) \
+    X(ERROR_WRITE_JOURNAL, "Unable to write to journal\n", \
+        TASUKE_ERROR_WRITE) \
+    X(ERROR_CLOSE_JOURNAL, "Unable to close journal\n", TASUKE_ERROR_WRITE) \
+    X(ERROR_DELETE_LIST, "Unable to delete list\n", TASUKE_ERROR_WRITE) \
+    X(ERROR_DELETE_JOURNAL, "Unable to delete journal\n", \
+        TASUKE_ERROR_WRITE) \
+    X(ERROR_DELETE_INDEX, "Unable to delete index\n", TASUKE_ERROR_WRITE) \
+    X(ERROR_LOCK, "Unable to lock list\n", TASUKE_ERROR_LOCK) \
+    X(ERROR_TIMED_OUT, "Timed out waiting for lock\n", \
+        TASUKE_ERROR_TIMEOUT) \
+    X(ERROR_CORRUPT_JOURNAL, "Corrupt journal\n", TASUKE_ERROR_CORRUPT) \
+    X(ERROR_OUTPUT, "Unable to write output\n", TASUKE_ERROR_OUTPUT) \
+    X(ERROR_SOCKET_PATH, "Directory path too long for socket\n", \
+        TASUKE_ERROR_SERVER) \
+    X(ERROR_SERVER_RUNNING, "Server already running\n", TASUKE_ERROR_SERVER) \
+    X(ERROR_CREATE_SOCKET, "Unable to create socket\n", TASUKE_ERROR_SERVER) \
+    X(ERROR_BIND_SOCKET, "Unable to bind socket\n", TASUKE_ERROR_SERVER) \
+    X(ERROR_LISTEN_SOCKET, "Unable to listen on socket\n", \
+        TASUKE_ERROR_SERVER) \
+    X(ERROR_ACCEPT, "Unable to accept connection\n", TASUKE_ERROR_SERVER) \
+    X(ERROR_CONNECTION, "Lost connection to server\n", TASUKE_ERROR_SERVER) \
+    X(ERROR_BATCH, "Some commands failed\n", TASUKE_ERROR_BATCH)
+
+/* The errors, named like in the table */
+enum error {
+#define ERROR_NAME(name, message, kind) name,
+    ERROR_TABLE(ERROR_NAME)
+#undef ERROR_NAME
+    ERRORS
+};
+
+/**
+ * Returns the message of an error.
+ *
+ * @param error The error
+ * @return The message, ending with a newline
+ */
+const char *error_message(enum error error);
+
+/**
+ * Tells what kind of problem an error message is about.
+ *
+ * @param message The error message, or NULL for none
+ * @return The kind of problem, TASUKE_OK for none and TASUKE_ERROR_OTHER
+ *         for a message that isn't in the table
+ */
+enum tasuke_error error_kind(const char *message);
+
+#endif // ERRORS_H
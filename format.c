@@ -0,0 +1,194 @@
+#include <string.h>
+#include "format.h"
+
+/*
+ * Private helper functions
+ */
+
+/**
+ * Copies a string.
+ *
+ * @param end Where to copy it to
+ * @param text The string
+ * @param length Length of the string
+ * @return Pointer to the byte after the copy
+ */
+static char *put(char *end, const char *text, size_t length) {
+    memcpy(end, text, length);
+
+    return end + length;
+}
+
+/**
+ * Writes a number in decimal.
+ *
+ * @param end Where to write it
+ * @param number The number, at least 0
+ * @return Pointer to the character after the number
+ */
+static char *put_number(char *end, long number) {
+    char digits[24];
+    int count = 0;
+    do {
+        digits[count++] = '0' + number % 10;
+        number /= 10;
+    } while (number > 0);
+    while (count > 0) {
+        *end++ = digits[--count];
+    }
+
+    return end;
+}
+
+/**
+ * Returns whether a character needs to be escaped in a format.
+ *
+ * @param format The format
+ * @param c The character
+ * @return 1 if it does, 0 otherwise
+ */
+static int needs_escape(enum format format, unsigned char c) {
+    if (format == FORMAT_JSON) {
+        return c < 0x20 || c == '"' || c == '\\';
+    }
+
+    return format == FORMAT_TSV && (c == '\t' || c == '\r' || c == '\\');
+}
+
+/**
+ * Copies a string, escaping what needs to be escaped in a format.
+ *
+ * Runs of characters that don't need it are copied at once.
+ *
+ * @param end Where to copy it to
+ * @param format The format
+ * @param text The string
+ * @param length Length of the string
+ * @return Pointer to the byte after the copy
+ */
+static char *put_escaped(
+    char *end, enum format format, const char *text, size_t length) {
+    const char *text_end = text + length;
+    while (text < text_end) {
+        const char *run = text;
+        while (text < text_end && !needs_escape(format, *text)) {
+            ++text;
+        }
+        end = put(end, run, text - run);
+        if (text == text_end) {
+            break;
+        }
+        unsigned char c = *text++;
+        *end++ = '\\';
+        if (c == '\t') {
+            *end++ = 't';
+        } else if (c == '\r') {
+            *end++ = 'r';
+        } else if (c == '"' || c == '\\') {
+            *end++ = c;
+        } else {
+            // Other control characters only need escaping in JSON
+            static const char hex[] = "0123456789abcdef";
+            end = put(end, "u00", 3);
+            *end++ = hex[c >> 4];
+            *end++ = hex[c & 0xf];
+        }
+    }
+
+    return end;
+}
+
+/*
+ * Public functions
+ */
+
+int format_parse(const char *name, enum format *format) {
+    static const char *names[] = {"text", "json", "tsv", "nul"};
+    if (name == NULL) {
+        *format = FORMAT_TEXT;
+        return 0;
+    }
+    for (int i = 0; i < 4; ++i) {
+        if (strcmp(name, names[i]) == 0) {
+            *format = i;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+size_t format_escaped_size(enum format format, size_t length) {
+    switch (format) {
+        case FORMAT_JSON:
+            return 6 * length;
+        case FORMAT_TSV:
+            return 2 * length;
+        default:
+            return length;
+    }
+}
+
+char *format_task(
+    char *end, enum format format, const char *name, size_t name_length,
+    long position, const char *text, size_t length) {
+    switch (format) {
+        case FORMAT_JSON:
+            end = put(end, "{\"list\":\"", 9);
+            end = put_escaped(end, format, name, name_length);
+            end = put(end, "\",\"position\":", 13);
+            end = put_number(end, position);
+            end = put(end, ",\"text\":\"", 9);
+            end = put_escaped(end, format, text, length);
+            end = put(end, "\"}\n", 3);
+            break;
+        case FORMAT_TSV:
+            end = put_escaped(end, format, name, name_length);
+            *end++ = '\t';
+            end = put_number(end, position);
+            *end++ = '\t';
+            end = put_escaped(end, format, text, length);
+            *end++ = '\n';
+            break;
+        default:
+            end = put(end, name, name_length);
+            *end++ = '\0';
+            end = put_number(end, position);
+            *end++ = '\0';
+            end = put(end, text, length);
+            *end++ = '\0';
+    }
+
+    return end;
+}
+
+char *format_list(
+    char *end, enum format format, const char *name, long count) {
+    size_t name_length = strlen(name);
+    if (format == FORMAT_JSON) {
+        end = put(end, "{\"list\":\"", 9);
+        end = put_escaped(end, format, name, name_length);
+        *end++ = '"';
+        if (count >= 0) {
+            end = put(end, ",\"tasks\":", 9);
+            end = put_number(end, count);
+        } else if (count == -1) {
+            end = put(end, ",\"tasks\":null", 13);
+        }
+        return put(end, "}\n", 2);
+    }
+
+    // The other formats only differ in what separates the fields
+    char separator = format == FORMAT_TSV ? '\t' : '\0';
+    char terminator = format == FORMAT_TSV ? '\n' : '\0';
+    end = put_escaped(end, format, name, name_length);
+    if (count != -2) {
+        *end++ = separator;
+        if (count >= 0) {
+            end = put_number(end, count);
+        }
+    }
+    *end++ = terminator;
+
+    return end;
+}
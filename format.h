@@ -0,0 +1,77 @@
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#include <stddef.h>
+
+/* Most bytes a formatted record takes besides its escaped strings */
+#define FORMAT_OVERHEAD 64
+
+/* How tasks and list names are formatted */
+enum format {
+    // For people, aligned, highlighted and wrapped
+    FORMAT_TEXT,
+    // One JSON object per line
+    FORMAT_JSON,
+    // One line per record, with fields separated by tabs
+    FORMAT_TSV,
+    // Every field terminated by a NUL byte
+    FORMAT_NUL
+};
+
+/**
+ * Converts the name of a format like "json" to the format.
+ *
+ * @param name The name, one of text, json, tsv and nul (NULL for text)
+ * @param format Set to the format
+ * @return 0 on success or -1 if there is no such format
+ */
+int format_parse(const char *name, enum format *format);
+
+/**
+ * Returns the most bytes a string can take once it's escaped.
+ *
+ * @param format The format, other than FORMAT_TEXT
+ * @param length Length of the string
+ * @return The most bytes it takes
+ */
+size_t format_escaped_size(enum format format, size_t length);
+
+/**
+ * Formats a task as a record of its list name, position and text.
+ *
+ * The record is written to a buffer with room for at least
+ * FORMAT_OVERHEAD bytes plus the escaped size of the name and the text.
+ * In JSON it's an object {"list": ..., "position": ..., "text": ...}. In
+ * TSV, backslashes, tabs and carriage returns are escaped as \\, \t and
+ * \r. With NUL bytes, nothing needs to be escaped.
+ *
+ * @param end Where to write the record
+ * @param format The format, other than FORMAT_TEXT
+ * @param name Name of the list (doesn't need to be terminated)
+ * @param name_length Length of the name
+ * @param position Position of the task
+ * @param text The task text (doesn't need to be terminated)
+ * @param length Length of the task text
+ * @return End of the record
+ */
+char *format_task(
+    char *end, enum format format, const char *name, size_t name_length,
+    long position, const char *text, size_t length);
+
+/**
+ * Formats a list as a record of its name and, if wanted, number of tasks.
+ *
+ * The record is written to a buffer with room for at least
+ * FORMAT_OVERHEAD bytes plus the escaped size of the name. In JSON it's an
+ * object {"list": ..., "tasks": ...}, with null if the number isn't known.
+ * In the other formats, an unknown number is left empty.
+ *
+ * @param end Where to write the record
+ * @param format The format, other than FORMAT_TEXT
+ * @param name Name of the list (terminated)
+ * @param count Number of tasks, -1 if it isn't known or -2 to leave it out
+ * @return End of the record
+ */
+char *format_list(char *end, enum format format, const char *name, long count);
+
+#endif // FORMAT_H
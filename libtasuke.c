@@ -0,0 +1,55 @@
+#include <stdlib.h>
+#include <string.h>
+#include "libtasuke.h"
+#include "tasklib.h"
+
+/*
+ * Public functions
+ */
+
+enum tasuke_error tasuke_open(
+    const char *dir, const struct sink *sink, Session *session) {
+    char *dir_cpy = get_dir(dir);
+    if (dir_cpy == NULL) {
+        return TASUKE_ERROR_DIRECTORY;
+    }
+    *session = session_init(dir_cpy, sink);
+    free(dir_cpy);
+
+    return TASUKE_OK;
+}
+
+enum tasuke_error tasuke_run(
+    Session session, char **args, const char **message) {
+    // Commands are parsed like a command line, starting with the program
+    int argc = 1;
+    while (args[argc - 1]) {
+        ++argc;
+    }
+    char **argv = malloc((argc + 1) * sizeof(char *));
+    argv[0] = "tasuke";
+    memcpy(argv + 1, args, argc * sizeof(char *));
+    const char *error = session_run(session, argc, argv);
+    free(argv);
+    // Write through, so the files are up to date for everyone else
+    const char *flush_error = session_flush(session);
+    error = error ? error : flush_error;
+    if (message) {
+        *message = error;
+    }
+
+    return tasuke_error_code(error);
+}
+
+enum tasuke_error tasuke_close(Session session, const char **message) {
+    const char *error = session_destroy(session);
+    if (message) {
+        *message = error;
+    }
+
+    return tasuke_error_code(error);
+}
+
+enum tasuke_error tasuke_error_code(const char *message) {
+    return error_kind(message);
+}
@@ -0,0 +1,62 @@
+#ifndef LIBTASUKE_H
+#define LIBTASUKE_H
+
+#include "errors.h"
+#include "session.h"
+#include "sink.h"
+
+/**
+ * Opens a directory of task lists for running commands in, creating the
+ * directory if it doesn't exist yet.
+ *
+ * The lists stay loaded between commands and are only read again when
+ * somebody else changed them. Every command is written through before it
+ * returns and holds no locks after, so other processes can use the lists
+ * at the same time.
+ * A Session must only be used by one thread at a time. Commands are parsed
+ * without any global state, so several threads can each run commands in a
+ * Session of their own.
+ *
+ * @param dir Path to the directory (NULL for .tasuke in the user home)
+ * @param sink Where the output of commands goes, copied into the Session
+ * @param session Set to the new Session
+ * @return TASUKE_OK on success or TASUKE_ERROR_DIRECTORY
+ */
+enum tasuke_error tasuke_open(
+    const char *dir, const struct sink *sink, Session *session);
+
+/**
+ * Runs a command, given in the syntax of the tasuke utility.
+ *
+ * Batch mode, serving and the directory option are not available.
+ *
+ * @param session The Session
+ * @param args Array of arguments, without the program name, terminated by
+ *             a NULL element
+ * @param message Set to the error message, or NULL on success (may be
+ *                NULL if it isn't needed)
+ * @return TASUKE_OK on success or what went wrong
+ */
+enum tasuke_error tasuke_run(
+    Session session, char **args, const char **message);
+
+/**
+ * Writes whatever is left to write and releases the Session.
+ *
+ * @param session The Session
+ * @param message Set to the error message, or NULL on success (may be
+ *                NULL if it isn't needed)
+ * @return TASUKE_OK on success or what went wrong
+ */
+enum tasuke_error tasuke_close(Session session, const char **message);
+
+/**
+ * Tells what kind of problem an error message returned by any of the
+ * functions of tasuke is about.
+ *
+ * @param message The error message, or NULL for none
+ * @return The kind of problem, TASUKE_OK for none
+ */
+enum tasuke_error tasuke_error_code(const char *message);
+
+#endif // LIBTASUKE_H
@@ -0,0 +1,61 @@
+/* Using pthreads, need POSIX 2008 */
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include "pool.h"
+
+/*
+ * Maximum number of threads, including the calling one. Jobs are expected to
+ * wait on I/O rather than the CPU, so this doesn't depend on the cores.
+ */
+#define POOL_THREADS 8
+
+/* The jobs shared by all threads */
+struct pool {
+    void (*job)(void *context, int index);
+    void *context;
+    int count;
+    // Index of the next job to start
+    int next;
+    pthread_mutex_t mutex;
+};
+
+/**
+ * Runs jobs until there are none left.
+ *
+ * @param arg The pool
+ * @return NULL
+ */
+static void *work(void *arg) {
+    struct pool *pool = arg;
+    while (1) {
+        // Claim the next job
+        pthread_mutex_lock(&pool->mutex);
+        int index = pool->next < pool->count ? pool->next++ : -1;
+        pthread_mutex_unlock(&pool->mutex);
+        if (index == -1) {
+            return NULL;
+        }
+        pool->job(pool->context, index);
+    }
+}
+
+void pool_run(
+    int count, void (*job)(void *context, int index), void *context) {
+    struct pool pool = {job, context, count, 0, PTHREAD_MUTEX_INITIALIZER};
+
+    // Start as many helpers as there is work for
+    pthread_t threads[POOL_THREADS - 1];
+    int started = 0;
+    while (started < POOL_THREADS - 1 && started < count - 1 &&
+        pthread_create(&threads[started], NULL, work, &pool) == 0) {
+        ++started;
+    }
+
+    // Help out, then wait for the others to finish
+    work(&pool);
+    for (int i = 0; i < started; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_mutex_destroy(&pool.mutex);
+}
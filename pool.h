@@ -0,0 +1,19 @@
+#ifndef POOL_H
+#define POOL_H
+
+/**
+ * Runs a number of independent jobs on a few threads.
+ *
+ * Every job receives the context and its index, from 0 to count - 1. Jobs
+ * are started in the order of their index, but may finish in any order.
+ * The calling thread takes part as well, and runs all jobs by itself if no
+ * other threads can be started.
+ *
+ * @param count Number of jobs
+ * @param job The function running a job
+ * @param context Passed on to every job
+ */
+void pool_run(
+    int count, void (*job)(void *context, int index), void *context);
+
+#endif // POOL_H
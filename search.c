@@ -0,0 +1,130 @@
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "search.h"
+
+/*
+ * Private helper functions
+ */
+
+/**
+ * Converts an ASCII letter to lowercase.
+ *
+ * @param c The character
+ * @return The lowercase letter or the character itself if it isn't one
+ */
+static char to_lower(char c) {
+    return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+/**
+ * Converts an ASCII letter to uppercase.
+ *
+ * @param c The character
+ * @return The uppercase letter or the character itself if it isn't one
+ */
+static char to_upper(char c) {
+    return c >= 'a' && c <= 'z' ? c - 'a' + 'A' : c;
+}
+
+/**
+ * Checks whether the pattern occurs at the start of the text.
+ *
+ * @param text The text, at least n characters long
+ * @param pattern The pattern
+ * @param n Length of the pattern
+ * @param ignore_case Whether to ignore case (0 = false, 1 = true)
+ * @return 1 if it does, 0 otherwise
+ */
+static int matches(
+    const char *text, const char *pattern, size_t n, int ignore_case) {
+    if (!ignore_case) {
+        return memcmp(text, pattern, n) == 0;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        if (to_lower(text[i]) != to_lower(pattern[i])) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/*
+ * Public functions
+ */
+
+const char *search_find(
+    const char *text, size_t text_length, const char *pattern,
+    size_t pattern_length, int ignore_case) {
+    if (pattern_length == 0) {
+        return text;
+    }
+    if (pattern_length > text_length) {
+        return NULL;
+    }
+    // Number of positions the pattern could start at
+    size_t starts = text_length - pattern_length + 1;
+    char first = pattern[0], last = pattern[pattern_length - 1];
+    size_t i = 0;
+
+#ifdef __SSE2__
+    /*
+     * Compare the first and last character of the pattern with 16 starting
+     * positions at once, and only compare the rest where both are equal
+     */
+    const __m128i first_lower = _mm_set1_epi8(
+        ignore_case ? to_lower(first) : first);
+    const __m128i first_upper = _mm_set1_epi8(
+        ignore_case ? to_upper(first) : first);
+    const __m128i last_lower = _mm_set1_epi8(
+        ignore_case ? to_lower(last) : last);
+    const __m128i last_upper = _mm_set1_epi8(
+        ignore_case ? to_upper(last) : last);
+    for ( ; i + 16 <= starts; i += 16) {
+        __m128i block_first = _mm_loadu_si128((const __m128i *) (text + i));
+        __m128i block_last = _mm_loadu_si128(
+            (const __m128i *) (text + i + pattern_length - 1));
+        __m128i equal_first = _mm_or_si128(
+            _mm_cmpeq_epi8(block_first, first_lower),
+            _mm_cmpeq_epi8(block_first, first_upper));
+        __m128i equal_last = _mm_or_si128(
+            _mm_cmpeq_epi8(block_last, last_lower),
+            _mm_cmpeq_epi8(block_last, last_upper));
+        unsigned mask = _mm_movemask_epi8(
+            _mm_and_si128(equal_first, equal_last));
+        // Check the candidates in order
+        for (int bit = 0; mask; ++bit, mask >>= 1) {
+            if ((mask & 1) && matches(
+                text + i + bit, pattern, pattern_length, ignore_case)) {
+                return text + i + bit;
+            }
+        }
+    }
+#endif
+
+    /*
+     * Check the remaining positions one at a time
+     */
+    char first_lower_char = to_lower(first);
+    while (i < starts) {
+        if (!ignore_case) {
+            // Skip ahead to the next occurrence of the first character
+            const char *candidate = memchr(text + i, first, starts - i);
+            if (candidate == NULL) {
+                return NULL;
+            }
+            i = candidate - text;
+        } else if (to_lower(text[i]) != first_lower_char) {
+            ++i;
+            continue;
+        }
+        if (matches(text + i, pattern, pattern_length, ignore_case)) {
+            return text + i;
+        }
+        ++i;
+    }
+
+    return NULL;
+}
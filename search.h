@@ -0,0 +1,23 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stddef.h>
+
+/**
+ * Finds the first occurrence of a pattern in a text.
+ *
+ * Where SSE2 is available, 16 candidate positions are checked at once.
+ * Ignoring case only applies to ASCII letters.
+ *
+ * @param text The text to search (doesn't need to be terminated)
+ * @param text_length Length of the text
+ * @param pattern The pattern to look for (doesn't need to be terminated)
+ * @param pattern_length Length of the pattern
+ * @param ignore_case Whether to ignore case (0 = false, 1 = true)
+ * @return Pointer to the first occurrence or NULL if there is none
+ */
+const char *search_find(
+    const char *text, size_t text_length, const char *pattern,
+    size_t pattern_length, int ignore_case);
+
+#endif // SEARCH_H
@@ -0,0 +1,614 @@
+/* Using sockets, sigaction, stpcpy, dup2 & environ, need POSIX 2008 */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include "errors.h"
+#include "server.h"
+#include "session.h"
+#include "trace.h"
+
+/* Name of the socket in the list directory */
+#define SOCKET_NAME ".tasuke.sock"
+/* Largest command the server accepts, in bytes */
+#define REQUEST_LIMIT (1 << 20)
+/* Seconds the server waits for a client to send its command */
+#define REQUEST_TIMEOUT 5
+/* Prefix of the environment variables that change how commands run */
+#define VARIABLE_PREFIX "TASUKE_"
+
+/*
+ * A request starts with the size of the command as uint32_t. The command
+ * consists of one byte each for its type, the verbose and ignore case flags,
+ * whether a list, a range and a format are selected and the number of the
+ * client's TASUKE_ environment variables. They're followed by the
+ * terminated list name, range and format if there are any, the terminated
+ * variables (as NAME=value) and the terminated operands. The start of a
+ * request carries the client's stdout and stderr along with it. The server
+ * answers with a single byte, '0' if the command succeeded, '1' if it
+ * failed and '2' if it wasn't run because the client's variables differ
+ * from the server's.
+ */
+
+extern char **environ;
+
+// Set once the server should stop serving
+static volatile sig_atomic_t stop = 0;
+
+/*
+ * Private helper functions
+ */
+
+/**
+ * Stops the server after the current command.
+ *
+ * @param signum The signal that was received
+ */
+static void handle_stop(int signum) {
+    (void) signum;
+    stop = 1;
+}
+
+/**
+ * Builds the address of the socket in a directory.
+ *
+ * @param dir Full path to the directory
+ * @param address The address to fill in
+ * @return 0 on success or -1 if the path is too long for a socket
+ */
+static int socket_address(const char *dir, struct sockaddr_un *address) {
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    // Choose format based on whether there is a trailing slash already
+    size_t dir_length = strlen(dir);
+    const char *path_format =
+        dir_length > 0 && dir[dir_length - 1] == '/' ? "%s%s" : "%s/%s";
+    int length = snprintf(
+        address->sun_path, sizeof(address->sun_path), path_format, dir,
+        SOCKET_NAME);
+
+    return length < 0 || (size_t) length >= sizeof(address->sun_path) ?
+        -1 : 0;
+}
+
+/**
+ * Counts the TASUKE_ variables in the environment.
+ *
+ * @return Number of variables
+ */
+static size_t count_variables(void) {
+    size_t count = 0;
+    for (char **variable = environ; *variable; ++variable) {
+        count += strncmp(
+            *variable, VARIABLE_PREFIX, strlen(VARIABLE_PREFIX)) == 0;
+    }
+
+    return count;
+}
+
+/**
+ * Checks whether a client's TASUKE_ variables match the environment.
+ *
+ * @param variables The client's variables, as NAME=value
+ * @param count Number of variables
+ * @return 1 if they're the same as the environment's or 0
+ */
+static int same_variables(char **variables, size_t count) {
+    if (count != count_variables()) {
+        return 0;
+    }
+    // Names are unique, so each variable needs a match of its own
+    for (size_t i = 0; i < count; ++i) {
+        char **variable = environ;
+        while (*variable && strcmp(*variable, variables[i]) != 0) {
+            ++variable;
+        }
+        if (*variable == NULL) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * Connects to the server listening on a socket.
+ *
+ * @param address Address of the socket
+ * @return The connected socket or -1 if no server is listening
+ */
+static int connect_server(const struct sockaddr_un *address) {
+    int fd;
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+        return -1;
+    }
+    if (connect(fd, (const struct sockaddr *) address, sizeof(*address)) ==
+        -1) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/**
+ * Reads exactly the given number of bytes from a file descriptor.
+ *
+ * @param fd The file descriptor
+ * @param buffer The buffer to read into
+ * @param size Number of bytes to read
+ * @return 0 on success or -1 on error or end of file
+ */
+static int read_all(int fd, char *buffer, size_t size) {
+    while (size > 0) {
+        ssize_t got = read(fd, buffer, size);
+        if (got == -1 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return -1;
+        }
+        buffer += got;
+        size -= got;
+    }
+
+    return 0;
+}
+
+/**
+ * Sends a buffer on a socket, retrying partial sends.
+ *
+ * @param fd The socket
+ * @param buffer The data to send
+ * @param size Number of bytes to send
+ * @return 0 on success or -1 on error
+ */
+static int send_all(int fd, const char *buffer, size_t size) {
+    while (size > 0) {
+        ssize_t sent = send(fd, buffer, size, MSG_NOSIGNAL);
+        if (sent == -1 && errno == EINTR) {
+            continue;
+        }
+        if (sent == -1) {
+            return -1;
+        }
+        buffer += sent;
+        size -= sent;
+    }
+
+    return 0;
+}
+
+/**
+ * Encodes a command as a request, along with the TASUKE_ variables.
+ *
+ * Because a new buffer needs to be allocated, the user must free it.
+ *
+ * @param command The command
+ * @param size Set to the size of the request
+ * @return The request (freed by user) or NULL if there are too many
+ *         variables to send
+ */
+static char *encode(const struct command *command, size_t *size) {
+    size_t variables = count_variables();
+    if (variables > UCHAR_MAX) {
+        return NULL;
+    }
+
+    // Determine the size of the command
+    size_t length = 7 + (command->list ? strlen(command->list) + 1 : 0) +
+        (command->range ? strlen(command->range) + 1 : 0) +
+        (command->format ? strlen(command->format) + 1 : 0);
+    for (char **variable = environ; *variable; ++variable) {
+        if (strncmp(*variable, VARIABLE_PREFIX, strlen(VARIABLE_PREFIX)) ==
+            0) {
+            length += strlen(*variable) + 1;
+        }
+    }
+    for (char **operand = command->operands; *operand; ++operand) {
+        length += strlen(*operand) + 1;
+    }
+    *size = sizeof(uint32_t) + length;
+
+    // Write the size, the flags and then the strings
+    char *request = malloc(*size);
+    uint32_t header = length;
+    memcpy(request, &header, sizeof(header));
+    char *end = request + sizeof(header);
+    *end++ = command->type;
+    *end++ = command->verbose;
+    *end++ = command->ignore_case;
+    *end++ = command->list != NULL;
+    *end++ = command->range != NULL;
+    *end++ = command->format != NULL;
+    *end++ = variables;
+    if (command->list) {
+        end = stpcpy(end, command->list) + 1;
+    }
+    if (command->range) {
+        end = stpcpy(end, command->range) + 1;
+    }
+    if (command->format) {
+        end = stpcpy(end, command->format) + 1;
+    }
+    for (char **variable = environ; *variable; ++variable) {
+        if (strncmp(*variable, VARIABLE_PREFIX, strlen(VARIABLE_PREFIX)) ==
+            0) {
+            end = stpcpy(end, *variable) + 1;
+        }
+    }
+    for (char **operand = command->operands; *operand; ++operand) {
+        end = stpcpy(end, *operand) + 1;
+    }
+
+    return request;
+}
+
+/**
+ * Decodes a command received by the server.
+ *
+ * The strings of the command point into the buffer, only the operands
+ * array is allocated and must be freed by the user. The client's variables
+ * come first in it, followed by the operands of the command.
+ *
+ * @param buffer The command as received
+ * @param size Size of the command
+ * @param command The command to fill in
+ * @param variables Set to the number of the client's variables
+ * @return 0 on success or -1 if the command is malformed
+ */
+static int decode(
+    char *buffer, size_t size, struct command *command, size_t *variables) {
+    // All strings need to be terminated
+    if (size < 7 || (size > 7 && buffer[size - 1] != '\0')) {
+        return -1;
+    }
+    command->type = buffer[0];
+    command->verbose = buffer[1];
+    command->ignore_case = buffer[2];
+    command->list = NULL;
+    command->dir = NULL;
+    command->range = NULL;
+    command->format = NULL;
+    *variables = (unsigned char) buffer[6];
+    char *string = buffer + 7, *end = buffer + size;
+    if (buffer[3]) {
+        if (string == end) {
+            return -1;
+        }
+        command->list = string;
+        string += strlen(string) + 1;
+    }
+    if (buffer[4]) {
+        if (string == end) {
+            return -1;
+        }
+        command->range = string;
+        string += strlen(string) + 1;
+    }
+    if (buffer[5]) {
+        if (string == end) {
+            return -1;
+        }
+        command->format = string;
+        string += strlen(string) + 1;
+    }
+
+    // Collect the variables and operands, one per terminated string
+    size_t count = 0;
+    for (char *c = string; c < end; ++c) {
+        count += *c == '\0';
+    }
+    if (count < *variables) {
+        return -1;
+    }
+    char **strings = malloc((count + 1) * sizeof(char *));
+    for (size_t i = 0; i < count; ++i) {
+        strings[i] = string;
+        string += strlen(string) + 1;
+    }
+    strings[count] = NULL;
+    command->operands = strings + *variables;
+
+    return 0;
+}
+
+/**
+ * Sends the start of a request along with the caller's stdout and stderr.
+ *
+ * @param fd The socket
+ * @param request The request
+ * @param size Size of the request
+ * @return 0 on success or -1 on error
+ */
+static int send_request(int fd, const char *request, size_t size) {
+    union {
+        struct cmsghdr header;
+        char buffer[CMSG_SPACE(2 * sizeof(int))];
+    } control;
+    memset(&control, 0, sizeof(control));
+    struct iovec iov = {(void *) request, size};
+    struct msghdr message = {0};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(2 * sizeof(int));
+    int fds[2] = {STDOUT_FILENO, STDERR_FILENO};
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    ssize_t sent;
+    while ((sent = sendmsg(fd, &message, MSG_NOSIGNAL)) == -1 &&
+        errno == EINTR) {
+    }
+    if (sent == -1) {
+        return -1;
+    }
+
+    // Send the rest, if it didn't fit at once
+    return send_all(fd, request + sent, size - sent);
+}
+
+/**
+ * Receives the start of a request along with the client's stdout and stderr.
+ *
+ * @param fd The client's socket
+ * @param size Set to the size of the command
+ * @param fds Set to the client's stdout and stderr (closed by user)
+ * @return 0 on success or -1 on error
+ */
+static int receive_header(int fd, uint32_t *size, int fds[2]) {
+    union {
+        struct cmsghdr header;
+        char buffer[CMSG_SPACE(2 * sizeof(int))];
+    } control;
+    struct iovec iov = {size, sizeof(*size)};
+    struct msghdr message = {0};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+
+    ssize_t got;
+    while ((got = recvmsg(fd, &message, 0)) == -1 && errno == EINTR) {
+    }
+    if (got <= 0) {
+        return -1;
+    }
+
+    // Take whatever descriptors came along, expecting exactly two
+    int received = 0;
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+    if (cmsg && cmsg->cmsg_level == SOL_SOCKET &&
+        cmsg->cmsg_type == SCM_RIGHTS) {
+        int all[2];
+        received = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        memcpy(all, CMSG_DATA(cmsg), received * sizeof(int));
+        if (received != 2) {
+            for (int i = 0; i < received; ++i) {
+                close(all[i]);
+            }
+            return -1;
+        }
+        fds[0] = all[0];
+        fds[1] = all[1];
+    }
+    if (received != 2) {
+        return -1;
+    }
+
+    // The rest of the size may arrive separately
+    if ((size_t) got < sizeof(*size) &&
+        read_all(fd, (char *) size + got, sizeof(*size) - got) == -1) {
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Runs the command a client sent and answers it.
+ *
+ * @param session The Session to run the command in
+ * @param client The client's socket
+ * @param saved Duplicates of the server's own stdout and stderr
+ */
+static void serve(Session session, int client, const int saved[2]) {
+    // Don't let a client that never sends anything hold up the others
+    struct timeval timeout = {REQUEST_TIMEOUT, 0};
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    // Receive the request
+    uint32_t size;
+    int fds[2];
+    if (receive_header(client, &size, fds) == -1) {
+        return;
+    }
+    char *buffer = NULL;
+    struct command command;
+    size_t variables;
+    if (size > REQUEST_LIMIT || (buffer = malloc(size)) == NULL ||
+        read_all(client, buffer, size) == -1 ||
+        decode(buffer, size, &command, &variables) == -1) {
+        free(buffer);
+        close(fds[0]);
+        close(fds[1]);
+        return;
+    }
+    char **strings = command.operands - variables;
+
+    // Lists are loaded the way our variables say, so the client needs to
+    // run the command itself if it asks for something else
+    if (!same_variables(strings, variables)) {
+        close(fds[0]);
+        close(fds[1]);
+        free(strings);
+        free(buffer);
+        char status = '2';
+        send_all(client, &status, 1);
+        return;
+    }
+
+    // Run the command, printing to the client's stdout and stderr
+    fflush(stdout);
+    dup2(fds[0], STDOUT_FILENO);
+    dup2(fds[1], STDERR_FILENO);
+    close(fds[0]);
+    close(fds[1]);
+    const char *error = session_execute(session, &command);
+    // Write through, so the files are up to date for everyone else
+    const char *flush_error = session_flush(session);
+    error = error ? error : flush_error;
+    if (error) {
+        fputs(error, stderr);
+    }
+    fflush(stdout);
+    clearerr(stdout);
+    dup2(saved[0], STDOUT_FILENO);
+    dup2(saved[1], STDERR_FILENO);
+    free(strings);
+    free(buffer);
+
+    // Tell the client how it went
+    char status = error ? '1' : '0';
+    send_all(client, &status, 1);
+    trace_report(command.type);
+}
+
+/*
+ * Public functions
+ */
+
+const char *server_run(const char *dir) {
+    struct sockaddr_un address;
+    if (socket_address(dir, &address) == -1) {
+        return error_message(ERROR_SOCKET_PATH);
+    }
+
+    /*
+     * Take over the socket, unless another server is using it
+     */
+    int listener;
+    if ((listener = connect_server(&address)) != -1) {
+        close(listener);
+        return error_message(ERROR_SERVER_RUNNING);
+    }
+    // Whatever is left at the path belongs to a server that's gone
+    unlink(address.sun_path);
+    if ((listener = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+        return error_message(ERROR_CREATE_SOCKET);
+    }
+    // Commands run with our permissions, so only we may send them. The
+    // socket is created with those permissions right away, leaving no
+    // moment for anyone else to connect.
+    mode_t mask = umask(S_IRWXG | S_IRWXO | S_IXUSR);
+    int bound =
+        bind(listener, (struct sockaddr *) &address, sizeof(address));
+    umask(mask);
+    if (bound == -1) {
+        close(listener);
+        return error_message(ERROR_BIND_SOCKET);
+    }
+    if (listen(listener, SOMAXCONN) == -1) {
+        close(listener);
+        unlink(address.sun_path);
+        return error_message(ERROR_LISTEN_SOCKET);
+    }
+
+    /*
+     * Handle signals
+     */
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    sigemptyset(&action.sa_mask);
+    // Stop on SIGINT and SIGTERM, which also interrupt waiting for clients
+    action.sa_handler = handle_stop;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    // A client that goes away mustn't take the server with it
+    action.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &action, NULL);
+
+    /*
+     * Serve clients one after the other
+     */
+    int saved[2] = {dup(STDOUT_FILENO), dup(STDERR_FILENO)};
+    Session session = session_init(dir, &sink_stdout);
+    const char *error = NULL;
+    while (!stop) {
+        int client = accept(listener, NULL, NULL);
+        if (client == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            error = error_message(ERROR_ACCEPT);
+            break;
+        }
+        // Every command is traced on its own, not the waiting in between
+        trace_reset();
+        serve(session, client, saved);
+        close(client);
+    }
+
+    // Clean up, writing whatever is left to write
+    close(listener);
+    unlink(address.sun_path);
+    close(saved[0]);
+    close(saved[1]);
+    const char *destroy_error = session_destroy(session);
+
+    return error ? error : destroy_error;
+}
+
+const char *server_forward(
+    const char *dir, const struct command *command, int *status) {
+    // Unless the server answers, the command needs to be run directly
+    *status = -1;
+    struct sockaddr_un address;
+    if (socket_address(dir, &address) == -1) {
+        return NULL;
+    }
+    size_t size;
+    char *request = encode(command, &size);
+    int fd = -1;
+    if (request == NULL || size - sizeof(uint32_t) > REQUEST_LIMIT ||
+        (fd = connect_server(&address)) == -1 ||
+        send_request(fd, request, size) == -1) {
+        free(request);
+        if (fd != -1) {
+            close(fd);
+        }
+        return NULL;
+    }
+    free(request);
+
+    // Wait for the command to finish
+    char answer;
+    int got = read_all(fd, &answer, 1);
+    close(fd);
+    if (got == -1) {
+        return error_message(ERROR_CONNECTION);
+    }
+    // The server can't run commands asking for other variables than its own
+    if (answer != '2') {
+        *status = answer != '0';
+    }
+
+    return NULL;
+}
@@ -0,0 +1,37 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "command.h"
+
+/**
+ * Serves commands for the lists in a directory until interrupted.
+ *
+ * The server listens on the socket .tasuke.sock in the directory and runs
+ * the commands it receives in a single Session, so lists stay loaded
+ * between them. Modified lists are written before a command is answered.
+ *
+ * @param dir Full path to the directory where task lists are stored (must
+ *            exist already)
+ * @return Error message or NULL on success
+ */
+const char *server_run(const char *dir);
+
+/**
+ * Has the server for a directory run a command, if one is running.
+ *
+ * The server prints to the same stdout and stderr as the caller, including
+ * the error message if the command fails. It only runs the command if the
+ * caller's TASUKE_ environment variables are the same as its own.
+ *
+ * @param dir Full path to the directory where task lists are stored
+ * @param command The command to run (one operating on lists or list names)
+ * @param status Set to -1 if no server is reachable or it didn't run the
+ *               command, so it needs to be run directly, 0 if it succeeded
+ *               or 1 if it failed
+ * @return Error message if the server was lost while running the command,
+ *         NULL otherwise
+ */
+const char *server_forward(
+    const char *dir, const struct command *command, int *status);
+
+#endif // SERVER_H
@@ -0,0 +1,495 @@
+/* Using strdup & getline, need POSIX 2008 */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "command.h"
+#include "errors.h"
+#include "session.h"
+#include "tasklib.h"
+#include "tasklist.h"
+#include "trace.h"
+
+#define STARTING_CAPACITY 8
+
+/* A list the session has loaded */
+struct loaded_list {
+    char *path;
+    TaskList list;
+    // Whether it was modified since it was loaded or last written
+    int modified;
+};
+
+struct session {
+    char *dir;
+    // Where the output of commands goes
+    struct sink sink;
+    struct loaded_list *lists;
+    int array_size;
+    int length;
+};
+
+/*
+ * Private helper functions
+ */
+
+/**
+ * Builds the full path to a list file in the session's directory.
+ *
+ * Because a new string needs to be allocated, the user must free it.
+ *
+ * @param session The Session
+ * @param name Name of the list (NULL for default)
+ * @return Full path to the list file (freed by user)
+ */
+static char *list_path(Session session, const char *name) {
+    // If no list name was set, use the default
+    if (!name) {
+        name = "todo";
+    }
+    size_t dir_length = strlen(session->dir);
+    char *path = malloc(dir_length + strlen(name) + 6);
+    // Choose format based on whether there is a trailing slash already
+    const char *path_format =
+        dir_length > 0 && session->dir[dir_length - 1] == '/' ?
+        "%s%s.txt" : "%s/%s.txt";
+    sprintf(path, path_format, session->dir, name);
+
+    return path;
+}
+
+/**
+ * Returns the index of a loaded list.
+ *
+ * @param session The Session
+ * @param path Full path to the list file
+ * @return Index of the list or -1 if it isn't loaded
+ */
+static int find(Session session, const char *path) {
+    for (int i = 0; i < session->length; ++i) {
+        if (strcmp(session->lists[i].path, path) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Forgets a loaded list, without writing it.
+ *
+ * @param session The Session
+ * @param i Index of the list
+ */
+static void unload(Session session, int i) {
+    free(session->lists[i].path);
+    tasklist_destroy(session->lists[i].list);
+    // Fill the hole with the last list
+    session->lists[i] = session->lists[--(session->length)];
+}
+
+/**
+ * Returns a list, locking it and loading it first if necessary.
+ *
+ * @param session The Session
+ * @param name Name of the list (NULL for default)
+ * @param exclusive Whether to lock the list for modification
+ * @param loaded Set to the loaded list
+ * @return Error message or NULL on success
+ */
+static const char *load(
+    Session session, const char *name, int exclusive,
+    struct loaded_list **loaded) {
+    char *path = list_path(session, name);
+    int i = find(session, path);
+    if (i != -1) {
+        const char *error = tasklist_lock(session->lists[i].list, exclusive);
+        if (error) {
+            free(path);
+            return error;
+        }
+        // Someone else may have changed the file since it was loaded. Unless
+        // there are modifications of our own, read it again.
+        if (!session->lists[i].modified &&
+            tasklist_changed(session->lists[i].list)) {
+            unload(session, i);
+            i = -1;
+        }
+    }
+    if (i == -1) {
+        // Attempt reading the list
+        TaskList list = tasklist_init(path);
+        const char *error = tasklist_lock(list, exclusive);
+        if (!error) {
+            error = tasklist_read(list);
+        }
+        if (error) {
+            tasklist_destroy(list);
+            free(path);
+            return error;
+        }
+        // Add it to the loaded lists, growing the array if necessary
+        if (session->length == session->array_size) {
+            session->array_size *= 2;
+            session->lists = realloc(
+                session->lists,
+                session->array_size * sizeof(struct loaded_list));
+        }
+        i = session->length++;
+        session->lists[i].path = path;
+        session->lists[i].list = list;
+        session->lists[i].modified = 0;
+    } else {
+        free(path);
+    }
+    *loaded = &session->lists[i];
+
+    return NULL;
+}
+
+/**
+ * Splits a command line into arguments, in place.
+ *
+ * Arguments are separated by blanks. Single quotes preserve everything
+ * between them, double quotes everything but backslash escapes.
+ *
+ * @param line The command line (terminated, without newline), overwritten
+ *             with the arguments
+ * @param argv Set to an array of arguments, starting with a dummy program
+ *             name and terminated by a NULL element (freed by user)
+ * @return Number of arguments (including the program name) or -1 on error
+ */
+static int split(char *line, char ***argv) {
+    int size = 8, argc = 0;
+    *argv = malloc(size * sizeof(char *));
+    (*argv)[argc++] = "t";
+    char *in = line, *out = line;
+    while (1) {
+        // Skip blanks between arguments
+        while (*in == ' ' || *in == '\t') {
+            ++in;
+        }
+        if (*in == '\0') {
+            break;
+        }
+        // Make sure there's room for this argument and the terminator
+        if (argc + 2 > size) {
+            size *= 2;
+            *argv = realloc(*argv, size * sizeof(char *));
+        }
+        (*argv)[argc++] = out;
+        // Copy the argument, removing quotes and escapes
+        char quote = '\0';
+        for ( ; *in != '\0' && (quote || (*in != ' ' && *in != '\t')); ++in) {
+            if (quote == '\'') {
+                if (*in == '\'') {
+                    quote = '\0';
+                } else {
+                    *out++ = *in;
+                }
+            } else if (*in == '\\' && in[1] != '\0' &&
+                (!quote || in[1] == '"' || in[1] == '\\')) {
+                *out++ = *++in;
+            } else if (quote == '"' && *in == '"') {
+                quote = '\0';
+            } else if (!quote && (*in == '\'' || *in == '"')) {
+                quote = *in;
+            } else {
+                *out++ = *in;
+            }
+        }
+        if (quote) {
+            free(*argv);
+            return -1;
+        }
+        // Terminate the argument, reading on after the separator
+        int at_end = *in == '\0';
+        *out++ = '\0';
+        if (at_end) {
+            break;
+        }
+        ++in;
+    }
+    (*argv)[argc] = NULL;
+
+    return argc;
+}
+
+/*
+ * Public functions
+ */
+
+Session session_init(const char *dir, const struct sink *sink) {
+    // Allocate memory for ADT
+    Session session = malloc(sizeof(*session));
+
+    // Initialize members
+    session->dir = strdup(dir);
+    session->sink = *sink;
+    session->lists = malloc(STARTING_CAPACITY * sizeof(struct loaded_list));
+    session->array_size = STARTING_CAPACITY;
+    session->length = 0;
+
+    return session;
+}
+
+const char *session_destroy(Session session) {
+    // Write what's left to write
+    const char *error = session_flush(session);
+    // Free all loaded lists
+    while (session->length > 0) {
+        unload(session, session->length - 1);
+    }
+    // Free other properties
+    free(session->lists);
+    free(session->dir);
+    // Free ADT
+    free(session);
+
+    return error;
+}
+
+const char *session_run(Session session, int argc, char **argv) {
+    // Find out what to do
+    struct command command;
+    if (command_parse(&command, argc, argv) || command.dir) {
+        return error_message(ERROR_USAGE);
+    }
+
+    return session_execute(session, &command);
+}
+
+const char *session_execute(Session session, const struct command *command) {
+    const char *error = NULL;
+    struct loaded_list *loaded = NULL;
+    const char *(*apply)(TaskList, char **) = NULL;
+    switch (command->type) {
+        case COMMAND_ADD: {
+            char *path = list_path(session, command->list);
+            int i = find(session, path);
+            if (i == -1) {
+                // Not loaded, so there's no need to load it for appending
+                TaskList list = tasklist_init(path);
+                error = tasklist_lock(list, 1);
+                if (!error) {
+                    error = tasklist_append(list, command->operands);
+                }
+                tasklist_destroy(list);
+                free(path);
+                if (error || !command->verbose) {
+                    return error;
+                }
+                if ((error = load(session, command->list, 0, &loaded))) {
+                    return error;
+                }
+                return tasklist_print(loaded->list, &session->sink);
+            }
+            free(path);
+            apply = tasklib_apply_add;
+            break;
+        }
+        case COMMAND_PREPEND:
+            apply = tasklib_apply_prepend;
+            break;
+        case COMMAND_INSERT:
+            apply = tasklib_apply_insert;
+            break;
+        case COMMAND_DONE:
+            apply = tasklib_apply_done;
+            break;
+        case COMMAND_MOVE:
+            apply = tasklib_apply_move;
+            break;
+        case COMMAND_SORT:
+            apply = tasklib_apply_sort;
+            break;
+        case COMMAND_NAMES:
+            return tasklib_names(
+                session->dir, command->verbose, command->format,
+                &session->sink);
+        case COMMAND_SEARCH:
+            // The files need to be up to date, since they're searched
+            if ((error = session_flush(session))) {
+                return error;
+            }
+            return tasklib_search(
+                session->dir, command->operands, command->ignore_case,
+                command->format, &session->sink);
+        case COMMAND_LOOKUP:
+            if ((error = session_flush(session))) {
+                return error;
+            }
+            return tasklib_lookup(
+                session->dir, command->operands, command->format,
+                &session->sink);
+        case COMMAND_RANGE: {
+            // The range is read from the files, which need to be up to date
+            if ((error = session_flush(session))) {
+                return error;
+            }
+            char **files = get_files(session->dir, command->operands);
+            if (files == NULL) {
+                return error_message(ERROR_ACCESS_DIR);
+            }
+            error = tasklib_range(
+                files, command->range, command->format, &session->sink);
+            for (char **file = files; *file; ++file) {
+                free(*file);
+            }
+            free(files);
+            return error;
+        }
+        case COMMAND_LIST: {
+            enum format format;
+            if (format_parse(command->format, &format) == -1) {
+                return error_message(ERROR_FORMAT);
+            }
+            // Default list if none were given
+            char *default_names[] = {"todo", NULL};
+            char **names = *command->operands ?
+                command->operands : default_names;
+            for ( ; *names; ++names) {
+                if ((error = load(session, *names, 0, &loaded))) {
+                    return error;
+                }
+                if (format != FORMAT_TEXT) {
+                    // Records for other programs follow each other directly
+                    size_t size;
+                    char *output = tasklist_export(
+                        loaded->list, format, &size);
+                    int result = sink_write(&session->sink, output, size);
+                    free(output);
+                    if (result == -1) {
+                        return error_message(ERROR_OUTPUT);
+                    }
+                    continue;
+                }
+                if ((error = tasklist_print(loaded->list, &session->sink))) {
+                    return error;
+                }
+                // Print empty line if there is yet another list
+                if (*(names + 1) && sink_write(&session->sink, "\n", 1)) {
+                    return error_message(ERROR_OUTPUT);
+                }
+            }
+            return NULL;
+        }
+        case COMMAND_REMOVE: {
+            // Default list if none were given
+            char *default_names[] = {"todo", NULL};
+            char **names = *command->operands ?
+                command->operands : default_names;
+            for ( ; *names; ++names) {
+                char *path = list_path(session, *names);
+                // Forget the list, it doesn't need to be written anymore
+                int i = find(session, path);
+                if (i != -1) {
+                    unload(session, i);
+                }
+                TaskList list = tasklist_init(path);
+                error = tasklist_lock(list, 1);
+                if (!error) {
+                    error = tasklist_remove(list);
+                }
+                tasklist_destroy(list);
+                free(path);
+                if (error) {
+                    return error;
+                }
+            }
+            return NULL;
+        }
+        default:
+            return error_message(ERROR_USAGE);
+    }
+
+    /*
+     * Modify the loaded list
+     */
+    if ((error = load(session, command->list, 1, &loaded))) {
+        return error;
+    }
+    struct trace_mark mark;
+    trace_begin(&mark);
+    error = apply(loaded->list, command->operands);
+    trace_end(TRACE_MODIFY, &mark);
+    if (error) {
+        return error;
+    }
+    loaded->modified = 1;
+    // Show the modified list
+    if (command->verbose) {
+        return tasklist_print(loaded->list, &session->sink);
+    }
+
+    return NULL;
+}
+
+const char *session_flush(Session session) {
+    const char *error = NULL;
+    for (int i = 0; i < session->length; ++i) {
+        if (session->lists[i].modified) {
+            // Keep going, but remember the first problem
+            const char *write_error = tasklist_write(session->lists[i].list);
+            if (write_error) {
+                // Keep others out of the list, it's still to be written
+                error = error ? error : write_error;
+                continue;
+            }
+            session->lists[i].modified = 0;
+        }
+        tasklist_unlock(session->lists[i].list);
+    }
+
+    return error;
+}
+
+const char *session_batch(Session session, FILE *in, long flush_every) {
+    char *line = NULL;
+    size_t size = 0;
+    ssize_t length;
+    long line_number = 0, commands = 0;
+    int failed = 0;
+    while ((length = getline(&line, &size, in)) != -1) {
+        ++line_number;
+        // Drop the newline
+        if (length > 0 && line[length - 1] == '\n') {
+            line[--length] = '\0';
+        }
+        // Skip empty lines and comments
+        size_t start = strspn(line, " \t");
+        if (line[start] == '\0' || line[start] == '#') {
+            continue;
+        }
+        // Run the command, reporting any problem
+        char **argv;
+        int argc = split(line, &argv);
+        const char *error = argc == -1 ?
+            error_message(ERROR_QUOTE) : session_run(session, argc, argv);
+        if (argc != -1) {
+            free(argv);
+        }
+        if (error) {
+            // Keep the output in order with what was printed so far
+            fflush(stdout);
+            fprintf(stderr, "Line %ld: %s", line_number, error);
+            failed = 1;
+        }
+        // Write the modified lists every so often
+        if (flush_every > 0 && ++commands % flush_every == 0) {
+            if ((error = session_flush(session))) {
+                fflush(stdout);
+                fprintf(stderr, "Line %ld: %s", line_number, error);
+                failed = 1;
+            }
+        }
+    }
+    free(line);
+
+    if (failed) {
+        return error_message(ERROR_BATCH);
+    }
+
+    return NULL;
+}
@@ -0,0 +1,86 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <stdio.h>
+#include "command.h"
+#include "sink.h"
+
+typedef struct session *Session;
+
+/**
+ * Returns a new Session for running commands against the lists in a
+ * directory.
+ *
+ * A Session keeps every list it touches loaded, so that consecutive
+ * commands don't need to read and write it again. Modified lists are only
+ * written when the Session is flushed. Until then, lists stay locked
+ * against other processes. Lists that weren't modified are read again when
+ * their file was changed by someone else in the meantime.
+ *
+ * @param dir Full path to the directory where task lists are stored (must
+ *            exist already)
+ * @param sink Where the output of commands goes, copied into the Session
+ * @return The new Session
+ */
+Session session_init(const char *dir, const struct sink *sink);
+
+/**
+ * Writes all modified lists and releases the Session.
+ *
+ * @param session The Session to free
+ * @return Error message or NULL on success
+ */
+const char *session_destroy(Session session);
+
+/**
+ * Runs a single command, given in the syntax of the tasuke utility.
+ *
+ * Batch mode and the directory option are not available inside a Session.
+ *
+ * @param session The Session
+ * @param argc Number of arguments, including the program name
+ * @param argv Array of arguments, starting with the program name and
+ *             terminated by a NULL element
+ * @return Error message or NULL on success
+ */
+const char *session_run(Session session, int argc, char **argv);
+
+/**
+ * Runs a single command that was already parsed.
+ *
+ * Only the commands operating on lists or list names are available, and the
+ * directory of the command is ignored.
+ *
+ * @param session The Session
+ * @param command The command
+ * @return Error message or NULL on success
+ */
+const char *session_execute(Session session, const struct command *command);
+
+/**
+ * Writes all lists that were modified since they were loaded or last
+ * written, and releases the locks on all lists that are up to date.
+ *
+ * @param session The Session
+ * @return Error message or NULL on success
+ */
+const char *session_flush(Session session);
+
+/**
+ * Runs newline-delimited commands read from a stream.
+ *
+ * Every line is a command in the syntax of the tasuke utility, without the
+ * program name. Arguments are separated by blanks and can be quoted with
+ * single or double quotes, or escaped with a backslash. Empty lines and
+ * lines starting with # are skipped.
+ * Errors are reported on stderr along with their line number, and don't
+ * stop the batch.
+ *
+ * @param session The Session
+ * @param in The stream to read commands from
+ * @param flush_every Flush after this many commands (0 = only at the end)
+ * @return Error message if any command failed, NULL otherwise
+ */
+const char *session_batch(Session session, FILE *in, long flush_every);
+
+#endif // SESSION_H
@@ -0,0 +1,123 @@
+/* Using isatty & write, need POSIX 1990 */
+#define _POSIX_C_SOURCE 1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include "sink.h"
+
+/* Size of formatted output that doesn't need to be allocated */
+#define FORMAT_BUFFER_SIZE 256
+
+/*
+ * Private helper functions
+ */
+
+/**
+ * Writes output to stdout.
+ *
+ * Small pieces go through stdio's buffer, large ones like whole lists
+ * straight to the file descriptor, after whatever was buffered before.
+ *
+ * @param context Not used
+ * @param data The data to write
+ * @param size Number of bytes to write
+ * @return 0 on success or -1 on error
+ */
+static int write_stdout(void *context, const char *data, size_t size) {
+    (void) context;
+    if (size < BUFSIZ) {
+        return fwrite(data, 1, size, stdout) == size ? 0 : -1;
+    }
+    if (fflush(stdout) == EOF) {
+        return -1;
+    }
+    while (size > 0) {
+        ssize_t written = write(STDOUT_FILENO, data, size);
+        if (written == -1) {
+            return -1;
+        }
+        data += written;
+        size -= written;
+    }
+
+    return 0;
+}
+
+/**
+ * Appends output to a buffer.
+ *
+ * @param context The struct sink_buffer
+ * @param data The data to write
+ * @param size Number of bytes to write
+ * @return 0 on success or -1 if there isn't enough memory
+ */
+static int write_buffer(void *context, const char *data, size_t size) {
+    struct sink_buffer *buffer = context;
+    if (buffer->length + size > buffer->size) {
+        size_t new_size = buffer->size ? buffer->size : FORMAT_BUFFER_SIZE;
+        while (new_size < buffer->length + size) {
+            new_size *= 2;
+        }
+        char *data_new = realloc(buffer->data, new_size);
+        if (data_new == NULL) {
+            return -1;
+        }
+        buffer->data = data_new;
+        buffer->size = new_size;
+    }
+    memcpy(buffer->data + buffer->length, data, size);
+    buffer->length += size;
+
+    return 0;
+}
+
+/*
+ * Public functions
+ */
+
+const struct sink sink_stdout = {write_stdout, NULL};
+
+int sink_write(const struct sink *sink, const char *data, size_t size) {
+    return sink->write(sink->context, data, size);
+}
+
+int sink_printf(const struct sink *sink, const char *format, ...) {
+    // Format into the stack unless it's too long for that
+    char small[FORMAT_BUFFER_SIZE];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(small, sizeof(small), format, args);
+    va_end(args);
+    if (length < 0) {
+        return -1;
+    }
+    if ((size_t) length < sizeof(small)) {
+        return sink_write(sink, small, length);
+    }
+    char *large = malloc(length + 1);
+    if (large == NULL) {
+        return -1;
+    }
+    va_start(args, format);
+    vsnprintf(large, length + 1, format, args);
+    va_end(args);
+    int result = sink_write(sink, large, length);
+    free(large);
+
+    return result;
+}
+
+int sink_terminal(const struct sink *sink) {
+    return sink->write == write_stdout && isatty(STDOUT_FILENO);
+}
+
+void sink_buffer_init(struct sink *sink, struct sink_buffer *buffer) {
+    buffer->data = NULL;
+    buffer->length = 0;
+    buffer->size = 0;
+    sink->write = write_buffer;
+    sink->context = buffer;
+}
@@ -0,0 +1,64 @@
+#ifndef SINK_H
+#define SINK_H
+
+#include <stddef.h>
+
+/* Where the output of a command goes */
+struct sink {
+    // Takes the next piece of output, returning 0 on success or -1 on error
+    int (*write)(void *context, const char *data, size_t size);
+    // Passed on to every call of write
+    void *context;
+};
+
+/* Output collected in memory, growing as needed */
+struct sink_buffer {
+    char *data;
+    size_t length;
+    size_t size;
+};
+
+/* Writes to stdout, which is what the tasuke utility uses */
+extern const struct sink sink_stdout;
+
+/**
+ * Writes output to a sink.
+ *
+ * @param sink The sink
+ * @param data The data to write
+ * @param size Number of bytes to write
+ * @return 0 on success or -1 on error
+ */
+int sink_write(const struct sink *sink, const char *data, size_t size);
+
+/**
+ * Writes formatted output to a sink.
+ *
+ * @param sink The sink
+ * @param format printf-style format
+ * @param ... Arguments for the format
+ * @return 0 on success or -1 on error
+ */
+int sink_printf(const struct sink *sink, const char *format, ...);
+
+/**
+ * Returns whether a sink writes to a terminal, which output is formatted
+ * for by highlighting it and wrapping it at the terminal's width.
+ *
+ * @param sink The sink
+ * @return 1 if it writes to a terminal, 0 otherwise
+ */
+int sink_terminal(const struct sink *sink);
+
+/**
+ * Sets up a sink collecting output in an empty buffer.
+ *
+ * The buffer's data is allocated as output arrives, so the user must free
+ * it. It isn't terminated.
+ *
+ * @param sink The sink to fill in
+ * @param buffer The buffer, which needs to stay around as long as the sink
+ */
+void sink_buffer_init(struct sink *sink, struct sink_buffer *buffer);
+
+#endif // SINK_H
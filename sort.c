@@ -0,0 +1,384 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sort.h"
+
+/* Depth of the keys from which strings sharing a prefix are compared */
+#define PREFIX_DEPTH_LIMIT 64
+/* Number of strings below which they're compared instead of radix sorted */
+#define RADIX_LIMIT 64
+/* Number of strings below which they're sorted by insertion */
+#define INSERTION_LIMIT 16
+
+/* What follows the prefix of a key */
+enum rest {
+    // Nothing, the prefix holds the rest of the key
+    REST_NONE,
+    // More bytes of the key
+    REST_MORE,
+    // A number too long for the key, which only comparing can tell apart
+    REST_COMPARE
+};
+
+/* A string being sorted, with the prefix of its key at the current depth */
+struct item {
+    uint64_t prefix;
+    int index;
+    enum rest rest;
+};
+
+/* A prefix of a key being built */
+struct prefix {
+    uint64_t bytes;
+    // Offset in the key of the next byte
+    size_t offset;
+    // Offset in the key of the first byte of the prefix
+    size_t depth;
+};
+
+/* The strings being sorted and how */
+struct context {
+    const struct sort_string *strings;
+    int flags;
+};
+
+/*
+ * Private helper functions
+ */
+
+/**
+ * Converts an ASCII letter to lowercase.
+ *
+ * @param c The character
+ * @return The lowercase letter or the character itself if it isn't one
+ */
+static unsigned char to_lower(unsigned char c) {
+    return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+/**
+ * Returns whether a character is an ASCII digit.
+ *
+ * @param c The character
+ * @return 1 if it is, 0 otherwise
+ */
+static int is_digit(unsigned char c) {
+    return c >= '0' && c <= '9';
+}
+
+/**
+ * Adds a byte of a key to a prefix, if it falls into the prefix.
+ *
+ * @param prefix The prefix being built
+ * @param c The byte
+ */
+static void put_byte(struct prefix *prefix, unsigned char c) {
+    size_t shift = 8 * (prefix->offset - prefix->depth);
+    if (prefix->offset >= prefix->depth && shift < 64) {
+        prefix->bytes |= (uint64_t) c << (56 - shift);
+    }
+    ++prefix->offset;
+}
+
+/**
+ * Computes 8 bytes of a string's key, as a number that orders like them.
+ *
+ * The key is the string itself, with ASCII letters in lowercase when
+ * ignoring case. In natural order, every number in it becomes a '0' (no
+ * other byte lies between the digits), the number of its digits without
+ * leading zeros and those digits, so comparing keys byte by byte compares
+ * the numbers by value.
+ *
+ * @param context The strings and how to sort them
+ * @param index Index of the string
+ * @param depth Offset of the first byte in the key
+ * @param rest Set to what follows the bytes in the key
+ * @return The bytes, most significant first and padded with zeros
+ */
+static uint64_t key_prefix(
+    const struct context *context, int index, size_t depth,
+    enum rest *rest) {
+    const struct sort_string *string = &context->strings[index];
+    const unsigned char *text = (const unsigned char *) string->text;
+    uint64_t bytes = 0;
+    *rest = REST_NONE;
+    if (!(context->flags & SORT_NATURAL)) {
+        // The key is as long as the string
+        size_t end = string->length < depth + 8 ? string->length : depth + 8;
+        for (size_t i = depth; i < end; ++i) {
+            unsigned char c = context->flags & SORT_IGNORE_CASE ?
+                to_lower(text[i]) : text[i];
+            bytes |= (uint64_t) c << (56 - 8 * (i - depth));
+        }
+        *rest = end < string->length ? REST_MORE : REST_NONE;
+        return context->flags & SORT_REVERSE ? ~bytes : bytes;
+    }
+
+    // Numbers change the length of the key, so it has to be walked from its
+    // start
+    struct prefix prefix = {0, 0, depth};
+    size_t i = 0;
+    while (i < string->length && prefix.offset < depth + 8) {
+        if (is_digit(text[i])) {
+            while (i < string->length && text[i] == '0') {
+                ++i;
+            }
+            size_t start = i;
+            while (i < string->length && is_digit(text[i])) {
+                ++i;
+            }
+            put_byte(&prefix, '0');
+            if (i - start >= 255) {
+                // Nothing short tells these apart
+                put_byte(&prefix, 255);
+                *rest = REST_COMPARE;
+                break;
+            }
+            put_byte(&prefix, i - start);
+            for (size_t j = start; j < i; ++j) {
+                put_byte(&prefix, text[j]);
+            }
+            continue;
+        }
+        put_byte(&prefix, context->flags & SORT_IGNORE_CASE ?
+            to_lower(text[i]) : text[i]);
+        ++i;
+    }
+    if (*rest == REST_NONE &&
+        (i < string->length || prefix.offset > depth + 8)) {
+        *rest = REST_MORE;
+    }
+
+    return context->flags & SORT_REVERSE ? ~prefix.bytes : prefix.bytes;
+}
+
+/**
+ * Compares the keys of two strings in full.
+ *
+ * @param context The strings and how to sort them
+ * @param a Index of the first string
+ * @param b Index of the second string
+ * @return Less than, equal to or greater than zero if the first key is
+ *         smaller, equal or larger
+ */
+static int compare_keys(const struct context *context, int a, int b) {
+    const struct sort_string *s = &context->strings[a];
+    const struct sort_string *t = &context->strings[b];
+    size_t i = 0, j = 0;
+    while (i < s->length && j < t->length) {
+        unsigned char c = s->text[i], d = t->text[j];
+        if ((context->flags & SORT_NATURAL) && is_digit(c) && is_digit(d)) {
+            // Without leading zeros, the longer number is the larger one
+            while (i < s->length && s->text[i] == '0') {
+                ++i;
+            }
+            while (j < t->length && t->text[j] == '0') {
+                ++j;
+            }
+            size_t s_start = i, t_start = j;
+            while (i < s->length && is_digit(s->text[i])) {
+                ++i;
+            }
+            while (j < t->length && is_digit(t->text[j])) {
+                ++j;
+            }
+            if (i - s_start != j - t_start) {
+                return i - s_start < j - t_start ? -1 : 1;
+            }
+            int result = memcmp(
+                s->text + s_start, t->text + t_start, i - s_start);
+            if (result != 0) {
+                return result;
+            }
+            continue;
+        }
+        if (context->flags & SORT_IGNORE_CASE) {
+            c = to_lower(c);
+            d = to_lower(d);
+        }
+        if (c != d) {
+            return c < d ? -1 : 1;
+        }
+        ++i;
+        ++j;
+    }
+
+    return (i < s->length) - (j < t->length);
+}
+
+/**
+ * Compares two strings in sorted order, keeping equal ones in their order.
+ *
+ * @param context The strings and how to sort them
+ * @param a The first string
+ * @param b The second string
+ * @return Less than or greater than zero if the first one goes first or
+ *         last
+ */
+static int compare(
+    const struct context *context, const struct item *a,
+    const struct item *b) {
+    int result = compare_keys(context, a->index, b->index);
+    if (context->flags & SORT_REVERSE) {
+        result = -result;
+    }
+
+    return result != 0 ? result : (a->index > b->index) - (a->index < b->index);
+}
+
+/**
+ * Sorts strings by comparing them in full.
+ *
+ * @param context The strings and how to sort them
+ * @param items The strings to sort
+ * @param scratch Room for as many items
+ * @param count Number of strings
+ */
+static void merge_sort(
+    const struct context *context, struct item *items, struct item *scratch,
+    int count) {
+    if (count <= INSERTION_LIMIT) {
+        for (int i = 1; i < count; ++i) {
+            struct item item = items[i];
+            int j = i;
+            for ( ; j > 0 && compare(context, &items[j - 1], &item) > 0; --j) {
+                items[j] = items[j - 1];
+            }
+            items[j] = item;
+        }
+        return;
+    }
+
+    // Sort both halves, then merge them through the scratch space
+    int half = count / 2;
+    merge_sort(context, items, scratch, half);
+    merge_sort(context, items + half, scratch, count - half);
+    int i = 0, j = half, k = 0;
+    while (i < half && j < count) {
+        if (compare(context, &items[j], &items[i]) < 0) {
+            scratch[k++] = items[j++];
+        } else {
+            scratch[k++] = items[i++];
+        }
+    }
+    while (i < half) {
+        scratch[k++] = items[i++];
+    }
+    memcpy(items, scratch, k * sizeof(struct item));
+}
+
+/**
+ * Sorts items by their prefixes, stably.
+ *
+ * The bytes are sorted from least to most significant, skipping those that
+ * are the same for all items.
+ *
+ * @param items The items to sort
+ * @param scratch Room for as many items
+ * @param count Number of items
+ */
+static void radix_sort(struct item *items, struct item *scratch, int count) {
+    // Count the values of every byte at once
+    int counts[8][256];
+    memset(counts, 0, sizeof(counts));
+    for (int i = 0; i < count; ++i) {
+        for (int b = 0; b < 8; ++b) {
+            ++counts[b][(items[i].prefix >> 8 * b) & 0xff];
+        }
+    }
+
+    struct item *from = items, *to = scratch;
+    for (int b = 0; b < 8; ++b) {
+        if (counts[b][(items[0].prefix >> 8 * b) & 0xff] == count) {
+            continue;
+        }
+        // Turn the counts into where every value starts
+        int total = 0;
+        for (int value = 0; value < 256; ++value) {
+            int value_count = counts[b][value];
+            counts[b][value] = total;
+            total += value_count;
+        }
+        for (int i = 0; i < count; ++i) {
+            to[counts[b][(from[i].prefix >> 8 * b) & 0xff]++] = from[i];
+        }
+        struct item *swap = from;
+        from = to;
+        to = swap;
+    }
+    if (from != items) {
+        memcpy(items, from, count * sizeof(struct item));
+    }
+}
+
+/**
+ * Sorts strings by their keys from a depth on.
+ *
+ * @param context The strings and how to sort them
+ * @param items The strings to sort, sharing their keys up to the depth
+ * @param scratch Room for as many items
+ * @param count Number of strings
+ * @param depth Offset in the keys to start from
+ */
+static void sort_items(
+    const struct context *context, struct item *items, struct item *scratch,
+    int count, size_t depth) {
+    if (count < RADIX_LIMIT || depth >= PREFIX_DEPTH_LIMIT) {
+        merge_sort(context, items, scratch, count);
+        return;
+    }
+    for (int i = 0; i < count; ++i) {
+        items[i].prefix = key_prefix(
+            context, items[i].index, depth, &items[i].rest);
+    }
+    radix_sort(items, scratch, count);
+
+    // Only the strings sharing a prefix need to be looked at again
+    int end;
+    for (int start = 0; start < count; start = end) {
+        enum rest rest = REST_NONE;
+        int lengths_differ = 0;
+        size_t length = context->strings[items[start].index].length;
+        for (end = start + 1;
+            end < count && items[end].prefix == items[start].prefix; ++end) {
+            if (items[end].rest > rest) {
+                rest = items[end].rest;
+            }
+            lengths_differ |=
+                context->strings[items[end].index].length != length;
+        }
+        if (end - start == 1) {
+            continue;
+        }
+        if (items[start].rest > rest) {
+            rest = items[start].rest;
+        }
+        if (rest == REST_MORE) {
+            sort_items(context, items + start, scratch, end - start, depth + 8);
+        } else if (rest == REST_COMPARE || lengths_differ) {
+            // Equal keys can still differ in leading zeros, or in NUL bytes
+            // that look like padding
+            merge_sort(context, items + start, scratch, end - start);
+        }
+    }
+}
+
+/*
+ * Public functions
+ */
+
+void sort_strings(
+    const struct sort_string *strings, int count, int flags, int *order) {
+    struct context context = {strings, flags};
+    struct item *items = malloc((count ? count : 1) * sizeof(struct item));
+    struct item *scratch = malloc((count ? count : 1) * sizeof(struct item));
+    for (int i = 0; i < count; ++i) {
+        items[i].index = i;
+    }
+    sort_items(&context, items, scratch, count, 0);
+    for (int i = 0; i < count; ++i) {
+        order[i] = items[i].index;
+    }
+    free(items);
+    free(scratch);
+}
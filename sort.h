@@ -0,0 +1,40 @@
+#ifndef SORT_H
+#define SORT_H
+
+#include <stddef.h>
+
+/* How strings are ordered, combined with | */
+enum sort_flags {
+    // Ignore the case of ASCII letters
+    SORT_IGNORE_CASE = 1,
+    // Compare runs of digits by the numbers they stand for
+    SORT_NATURAL = 2,
+    // Put the largest first (equal strings still keep their order)
+    SORT_REVERSE = 4
+};
+
+/* A string to sort */
+struct sort_string {
+    const char *text;
+    size_t length;
+};
+
+/**
+ * Sorts strings byte by byte, stably.
+ *
+ * The strings are radix sorted by cached 8-byte prefixes of their keys, and
+ * only those that share a prefix are looked at again, by their next 8 bytes
+ * or, past a number in natural order, by comparing them in full.
+ * The order only depends on the strings and the flags, which journals rely
+ * on to replay sorting.
+ *
+ * @param strings Array of strings (don't need to be terminated)
+ * @param count Number of strings
+ * @param flags How to order them, see enum sort_flags
+ * @param order Array of count elements, set to the indices of the strings in
+ *              sorted order
+ */
+void sort_strings(
+    const struct sort_string *strings, int count, int flags, int *order);
+
+#endif // SORT_H
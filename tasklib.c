@@ -10,8 +10,53 @@
 #include <sys/stat.h>
 #include <errno.h>
 #include <dirent.h>
+#include "catalog.h"
+#include "errors.h"
+#include "pool.h"
 #include "tasklib.h"
 #include "tasklist.h"
+#include "trace.h"
+#include "words.h"
+
+/* A list formatted in memory, for printing several in order */
+struct rendering {
+    const char *file;
+    // Whether to highlight the list (0 = false, 1 = true)
+    int ansi;
+    // Number of columns to wrap tasks at
+    int columns;
+    // How to format the list
+    enum format format;
+    // Positions to show, or NULL for the whole list
+    const struct tasklist_range *range;
+    // The formatted list, or NULL if there was an error
+    char *output;
+    size_t size;
+    const char *error;
+};
+
+/* A search through several lists */
+struct search {
+    const char *pattern;
+    // Whether to ignore case (0 = false, 1 = true)
+    int ignore_case;
+    // Whether words starting with the pattern match too (0 = false,
+    // 1 = true), when looking up a word
+    int prefix;
+    // How to format the matches
+    enum format format;
+    // The matches in each list
+    struct rendering *renderings;
+};
+
+/* A list whose tasks are counted for the catalog */
+struct tally {
+    char *file;
+    // Number of tasks, or -1 if the list can't be read
+    long count;
+    // Version of the list that was counted
+    struct catalog_stamp stamp;
+};
 
 /*
  * Private helper functions
@@ -50,6 +95,86 @@ static long strtopos(const char *posarg) {
     return position;
 }
 
+/**
+ * Converts a position or range string like "7" or "10-20" to a range.
+ *
+ * A single position results in a range containing only that position.
+ * Positions below 1 are rejected like anything else that isn't one.
+ *
+ * @param rangearg The string to convert
+ * @param range The range to fill in
+ * @return 0 on success or -1 on error
+ */
+static int strtorange(const char *rangearg, struct tasklist_range *range) {
+    // Reset errno to use it for strtol error checking
+    errno = 0;
+    // Will point to first character that is not a digit
+    char *endptr;
+    range->first = strtol(rangearg, &endptr, 10);
+    // Handle conversion error, including a missing number, and positions
+    // below 1, which would also end the array of ranges early
+    if (errno || endptr == rangearg || range->first < 1) {
+        return -1;
+    }
+    // Single position
+    if (*endptr == '\0') {
+        range->last = range->first;
+        return 0;
+    }
+    // Otherwise there needs to be a dash followed by the last position
+    if (*endptr != '-') {
+        return -1;
+    }
+    const char *last_start = endptr + 1;
+    range->last = strtol(last_start, &endptr, 10);
+    if (errno || endptr == last_start || *endptr != '\0' ||
+        range->last < 1) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Converts a page string to a range of positions.
+ *
+ * A page is either a range like "10-20", a first position followed by a
+ * dash for everything from there on, a number of tasks from the start like
+ * "20" or a number of tasks from the end like "-20". Counting from the end
+ * gives negative positions, -1 being the last task.
+ *
+ * @param pagearg The string to convert
+ * @param range The range to fill in
+ * @return 0 on success or -1 on error
+ */
+static int strtopage(const char *pagearg, struct tasklist_range *range) {
+    const char *dash = strchr(pagearg, '-');
+    // The first tasks
+    if (dash == NULL) {
+        range->first = 1;
+        range->last = strtopos(pagearg);
+        return range->last < 1 ? -1 : 0;
+    }
+    // The last tasks
+    if (dash == pagearg) {
+        long count = strtopos(dash + 1);
+        range->first = -count;
+        range->last = -1;
+        return count < 1 ? -1 : 0;
+    }
+    // A range, which may be open at the end
+    char *first = strndup(pagearg, dash - pagearg);
+    range->first = strtopos(first);
+    free(first);
+    range->last = dash[1] == '\0' ? -1 : strtopos(dash + 1);
+    if (range->first < 1 ||
+        (dash[1] != '\0' && range->last < range->first)) {
+        return -1;
+    }
+
+    return 0;
+}
+
 /**
  * Returns the name of a task list based on its filename.
  *
@@ -86,11 +211,516 @@ static int cmpstringp(const void *s1, const void *s2) {
     return strcasecmp(* (char * const *) s1, * (char * const *) s2);
 }
 
+/**
+ * Collects the names of all task lists in a directory.
+ *
+ * Because a new array needs to be allocated, the user must free it with
+ * free_names().
+ *
+ * @param dir Full path to directory
+ * @param count Set to the number of names
+ * @return Array of names sorted alphabetically, terminated by a NULL
+ *         element, or NULL if the directory can't be opened
+ */
+static char **collect_names(const char *dir, int *count) {
+    DIR *dp;
+    struct dirent *ep;
+
+    // Attempt opening the directory stream
+    if ((dp = opendir(dir)) == NULL) {
+        return NULL;
+    }
+
+    // Read dir entries into array
+    char **names = malloc(8 * sizeof(char *));
+    int size = 8;
+    int i = 0;
+    while ((ep = readdir (dp))) {
+        // Only list files count, not their journals or anything else
+        size_t length = strlen(ep->d_name);
+        if (length > 4 && strcmp(ep->d_name + length - 4, ".txt") == 0) {
+            // Increase array size if necessary, leaving room for terminator
+            if (i + 1 == size) {
+                names = realloc(names, 2 * size * sizeof(char *));
+                size *= 2;
+            }
+            // Insert name into array
+            names[i++] = filename_to_name(ep->d_name);
+        }
+    }
+    closedir(dp);
+    names[i] = NULL;
+
+    // Sort array alphabetically
+    qsort(names, i, sizeof(char *), cmpstringp);
+    *count = i;
+
+    return names;
+}
+
+/**
+ * Frees an array of names.
+ *
+ * @param names Array of names, terminated by a NULL element
+ */
+static void free_names(char **names) {
+    for (char **name = names; *name; ++name) {
+        free(*name);
+    }
+    free(names);
+}
+
+/**
+ * Reads a list and formats it into a buffer.
+ *
+ * This is a job for pool_run().
+ *
+ * @param context Array of renderings
+ * @param index Index of the rendering to fill in
+ */
+static void render(void *context, int index) {
+    struct rendering *rendering = (struct rendering *) context + index;
+    rendering->output = NULL;
+    rendering->size = 0;
+    // Attempt reading the list, while nobody is writing it
+    TaskList list = tasklist_init(rendering->file);
+    rendering->error = tasklist_lock(list, 0);
+    if (!rendering->error) {
+        rendering->error = rendering->range ?
+            tasklist_read_range(
+                list, rendering->range->first, rendering->range->last) :
+            tasklist_read(list);
+    }
+    // If there was no problem, format it, still holding the lock since the
+    // tasks point into the file, which a writer may shrink
+    if (!rendering->error && rendering->format != FORMAT_TEXT) {
+        rendering->output = tasklist_export(
+            list, rendering->format, &rendering->size);
+    } else if (!rendering->error) {
+        rendering->output = tasklist_render(
+            list, rendering->ansi, rendering->columns, &rendering->size);
+    }
+    tasklist_unlock(list);
+    tasklist_destroy(list);
+}
+
+/**
+ * Searches a list for a pattern, formatting the matches into a buffer.
+ *
+ * This is a job for pool_run().
+ *
+ * @param context The search
+ * @param index Index of the rendering to fill in
+ */
+static void search_list(void *context, int index) {
+    const struct search *search = context;
+    struct rendering *rendering = &search->renderings[index];
+    rendering->output = NULL;
+    rendering->size = 0;
+    // Attempt searching the list, while nobody is writing it
+    TaskList list = tasklist_init(rendering->file);
+    rendering->error = tasklist_lock(list, 0);
+    if (!rendering->error) {
+        rendering->error = tasklist_search(
+            list, search->pattern, search->ignore_case, search->format,
+            &rendering->output, &rendering->size);
+    }
+    tasklist_destroy(list);
+}
+
+/**
+ * Looks up a word in a list, formatting the matches into a buffer.
+ *
+ * This is a job for pool_run().
+ *
+ * @param context The search
+ * @param index Index of the rendering to fill in
+ */
+static void lookup_list(void *context, int index) {
+    const struct search *search = context;
+    struct rendering *rendering = &search->renderings[index];
+    rendering->output = NULL;
+    rendering->size = 0;
+    // Attempt looking it up, while nobody is writing the list
+    TaskList list = tasklist_init(rendering->file);
+    rendering->error = tasklist_lock(list, 0);
+    if (!rendering->error) {
+        rendering->error = tasklist_lookup(
+            list, search->pattern, search->prefix, search->format,
+            &rendering->output, &rendering->size);
+    }
+    tasklist_destroy(list);
+}
+
+/**
+ * Counts the tasks of a list.
+ *
+ * This is a job for pool_run().
+ *
+ * @param context Array of tallies
+ * @param index Index of the tally to fill in
+ */
+static void count_list(void *context, int index) {
+    struct tally *tally = (struct tally *) context + index;
+    tally->count = -1;
+    if (tally->file == NULL) {
+        return;
+    }
+    // Take the stamp while nobody is writing the list, so it's the version
+    // that is read
+    TaskList list = tasklist_init(tally->file);
+    if (!tasklist_lock(list, 0) &&
+        catalog_stamp(tally->file, &tally->stamp) == 0 &&
+        !tasklist_read(list)) {
+        tally->count = tasklist_length(list);
+    }
+    tasklist_destroy(list);
+}
+
+/**
+ * Prints renderings in order and frees them.
+ *
+ * Printing stops at the first rendering that has an error.
+ *
+ * @param renderings Array of renderings
+ * @param count Number of renderings
+ * @param separate Print an empty line between renderings (0 = false,
+ *                 1 = true)
+ * @param sink Where to print them
+ * @return The first error or NULL if there was none
+ */
+static const char *print_renderings(
+    struct rendering *renderings, int count, int separate,
+    const struct sink *sink) {
+    struct trace_mark mark;
+    trace_begin(&mark);
+    const char *error = NULL;
+    for (int i = 0; i < count; ++i) {
+        if (!error) {
+            if ((error = renderings[i].error) == NULL &&
+                (sink_write(sink, renderings[i].output, renderings[i].size) ||
+                // Print empty line if there is yet another list
+                (separate && i + 1 < count && sink_write(sink, "\n", 1)))) {
+                error = error_message(ERROR_OUTPUT);
+            }
+        }
+        free(renderings[i].output);
+    }
+    free(renderings);
+    trace_end(TRACE_PRINT, &mark);
+
+    return error;
+}
+
+/**
+ * Prints list names, along with their number of tasks if there are any.
+ *
+ * @param names Array of names
+ * @param count Number of names
+ * @param counts Number of tasks of every list (-1 if it isn't known), or
+ *               NULL to print only the names
+ * @param format How to format them
+ * @param sink Where to print them
+ * @return Error message or NULL on success
+ */
+static const char *print_names(
+    const char **names, int count, const long *counts, enum format format,
+    const struct sink *sink) {
+    int result = 0;
+    if (format != FORMAT_TEXT) {
+        // Format them all at once
+        size_t size = 1;
+        for (int i = 0; i < count; ++i) {
+            size += FORMAT_OVERHEAD +
+                format_escaped_size(format, strlen(names[i]));
+        }
+        char *output = malloc(size), *end = output;
+        for (int i = 0; i < count; ++i) {
+            end = format_list(
+                end, format, names[i], counts ? counts[i] : -2);
+        }
+        result = sink_write(sink, output, end - output);
+        free(output);
+    } else if (counts == NULL) {
+        for (int i = 0; i < count && result == 0; ++i) {
+            result = sink_printf(sink, "%s\n", names[i]);
+        }
+    } else {
+        // Print the number of tasks in front of every name, aligned like wc
+        long most = 0;
+        for (int i = 0; i < count; ++i) {
+            most = counts[i] > most ? counts[i] : most;
+        }
+        int width = snprintf(NULL, 0, "%ld", most);
+        for (int i = 0; i < count && result == 0; ++i) {
+            if (counts[i] == -1) {
+                result = sink_printf(sink, "%*s %s\n", width, "?", names[i]);
+            } else {
+                result = sink_printf(
+                    sink, "%*ld %s\n", width, counts[i], names[i]);
+            }
+        }
+    }
+
+    return result == -1 ? error_message(ERROR_OUTPUT) : NULL;
+}
+
+/**
+ * Prints lists or a range of each of them.
+ *
+ * @param files Array of file paths, terminated by a NULL element
+ * @param range Positions to show, or NULL for the whole lists
+ * @param formatarg Name of the format (NULL for text)
+ * @param sink Where to print them
+ * @return Error message or NULL on success
+ */
+static const char *render_lists(
+    char **files, const struct tasklist_range *range, const char *formatarg,
+    const struct sink *sink) {
+    enum format format;
+    if (format_parse(formatarg, &format) == -1) {
+        return error_message(ERROR_FORMAT);
+    }
+
+    // Load and render all lists at once, since reading them may take a while
+    int count = 0;
+    while (files[count]) {
+        ++count;
+    }
+    struct rendering *renderings = malloc(count * sizeof(struct rendering));
+    int ansi = sink_terminal(sink), columns = tasklist_columns(sink);
+    for (int i = 0; i < count; ++i) {
+        renderings[i].file = files[i];
+        renderings[i].ansi = ansi;
+        renderings[i].columns = columns;
+        renderings[i].format = format;
+        renderings[i].range = range;
+    }
+    pool_run(count, render, renderings);
+
+    // Records for other programs follow each other directly
+    return print_renderings(renderings, count, format == FORMAT_TEXT, sink);
+}
+
+/**
+ * Runs a search through some lists or all lists in a directory and prints
+ * the matches.
+ *
+ * @param dir Full path to directory
+ * @param names Array of list names to search (all lists if empty),
+ *              terminated by a NULL element
+ * @param search The search, its renderings are filled in
+ * @param job The function searching a single list, see pool_run()
+ * @param sink Where to print the matches
+ * @return Error message or NULL on success
+ */
+static const char *search_lists(
+    const char *dir, char **names, struct search *search,
+    void (*job)(void *, int), const struct sink *sink) {
+    // Search the given lists or otherwise all of them
+    char **all_names = NULL;
+    if (!*names) {
+        int count;
+        if ((all_names = collect_names(dir, &count)) == NULL) {
+            return error_message(ERROR_OPEN_DIR);
+        }
+        if (count == 0) {
+            free_names(all_names);
+            return NULL;
+        }
+        names = all_names;
+    }
+    char **files = get_files(dir, names);
+    if (all_names) {
+        free_names(all_names);
+    }
+    if (files == NULL) {
+        return error_message(ERROR_ACCESS_DIR);
+    }
+
+    // Search all lists at once, since reading them may take a while
+    int count = 0;
+    while (files[count]) {
+        ++count;
+    }
+    search->renderings = malloc(count * sizeof(struct rendering));
+    for (int i = 0; i < count; ++i) {
+        search->renderings[i].file = files[i];
+    }
+    struct trace_mark mark;
+    trace_begin(&mark);
+    pool_run(count, job, search);
+    trace_end(TRACE_SEARCH, &mark);
+    const char *error = print_renderings(search->renderings, count, 0, sink);
+
+    // Free all paths in files array
+    for (int i = 0; files[i]; ++i) {
+        free(files[i]);
+    }
+    free(files);
+
+    return error;
+}
+
+/**
+ * Reads the newline-separated tasks from a file descriptor until its end.
+ *
+ * Empty lines are skipped. The tasks point into a single buffer, which the
+ * user must free along with the array.
+ *
+ * @param fd File descriptor open for reading
+ * @param buffer Set to the buffer holding the tasks (freed by user)
+ * @return Array of tasks, terminated by a NULL element (freed by user), or
+ *         NULL if reading failed
+ */
+static char **read_tasks(int fd, char **buffer) {
+    // Read everything, leaving room to terminate the last line
+    size_t size = 65536, length = 0;
+    char *data = malloc(size);
+    while (1) {
+        if (size - length < 2) {
+            size *= 2;
+            data = realloc(data, size);
+        }
+        ssize_t got = read(fd, data + length, size - length - 1);
+        if (got == -1 && errno == EINTR) {
+            continue;
+        }
+        if (got == -1) {
+            free(data);
+            return NULL;
+        }
+        if (got == 0) {
+            break;
+        }
+        length += got;
+    }
+    data[length] = '\n';
+
+    // Terminate the lines in place, skipping empty ones
+    size_t count = 0;
+    for (size_t i = 0; i < length; ++i) {
+        count += data[i] == '\n';
+    }
+    char **tasks = malloc((count + 2) * sizeof(char *));
+    count = 0;
+    for (char *line = data, *end = data + length; line < end; ) {
+        char *newline = memchr(line, '\n', end - line + 1);
+        if (newline > line) {
+            tasks[count++] = line;
+        }
+        *newline = '\0';
+        line = newline + 1;
+    }
+    tasks[count] = NULL;
+    *buffer = data;
+
+    return tasks;
+}
+
+/**
+ * Reads a list from file, modifies it and writes it back.
+ *
+ * @param file Full path to the file
+ * @param apply The modification
+ * @param args Arguments for the modification, terminated by a NULL element
+ * @param verbose Show list after modification (0 = false, 1 = true)
+ * @param sink Where to show it
+ * @return Error message or NULL on success
+ */
+static const char *modify(
+    const char *file, const char *(*apply)(TaskList, char **), char **args,
+    int verbose, const struct sink *sink) {
+    // Build TaskList ADT
+    TaskList list = tasklist_init(file);
+    // Keep others out until the modification is written, then read the list
+    const char *error = tasklist_lock(list, 1);
+    if (!error) {
+        error = tasklist_read(list);
+    }
+    if (error) {
+        tasklist_destroy(list);
+        return error;
+    }
+    // Try modifying it
+    struct trace_mark mark;
+    trace_begin(&mark);
+    error = apply(list, args);
+    trace_end(TRACE_MODIFY, &mark);
+    if (error) {
+        tasklist_destroy(list);
+        return error;
+    }
+    // Try writing the updated list to file
+    error = tasklist_write(list);
+    if (error) {
+        tasklist_destroy(list);
+        return error;
+    }
+    // Show the modified list before unlocking, since its tasks may still
+    // point into the file
+    if (verbose) {
+        error = tasklist_print(list, sink);
+    }
+    tasklist_unlock(list);
+    tasklist_destroy(list);
+
+    return error;
+}
+
+/**
+ * Appends tasks to a file without reading it.
+ *
+ * @param file Full path to the file
+ * @param tasks Array of tasks, terminated by a NULL element, or NULL to
+ *              read them from the file descriptor
+ * @param fd File descriptor to read newline-separated tasks from, if there
+ *           is no array
+ * @param verbose Show list after modification (0 = false, 1 = true)
+ * @param sink Where to show it
+ * @return Error message or NULL on success
+ */
+static const char *append(
+    const char *file, char **tasks, int fd, int verbose,
+    const struct sink *sink) {
+    // Initialize TaskList ADT
+    TaskList list = tasklist_init(file);
+    // Append the tasks without reading the list, but not during a rewrite
+    const char *error = tasklist_lock(list, 1);
+    if (!error) {
+        error = tasks ?
+            tasklist_append(list, tasks) : tasklist_append_fd(list, fd);
+    }
+    if (error) {
+        tasklist_destroy(list);
+        return error;
+    }
+
+    // Show new list
+    if (verbose) {
+        // Attempt reading the list
+        error = tasklist_read(list);
+        if (error) {
+            tasklist_destroy(list);
+            return error;
+        }
+        // If there was no problem, print it
+        error = tasklist_print(list, sink);
+    }
+    // Cleanup
+    tasklist_destroy(list);
+
+    return error;
+}
+
 /*
  * Public helper functions
  */
 
 char *get_dir(const char *dir) {
+    struct trace_mark mark;
+    trace_begin(&mark);
+
     /*
      * Use default value if dir has not been set
      */
@@ -123,9 +753,10 @@ char *get_dir(const char *dir) {
         if (mkdir(dir_cpy, S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH) == -1) {
             // There was an error, free memory and return
             free(dir_cpy);
-            return NULL;
+            dir_cpy = NULL;
         }
     }
+    trace_end(TRACE_DIR, &mark);
 
     return dir_cpy;
 }
@@ -203,82 +834,19 @@ char **get_files(const char *dir, char **lists) {
 }
 
 /*
- * Commands
+ * Modifications of loaded lists
  */
 
-const char *tasklib_add(const char *file, char **tasks, int verbose) {
-    // Open file in append mode
-    FILE *fp;
-    if ((fp = fopen(file, "a")) == NULL) {
-        return "Unable to open list\n";
-    }
-
-    // Write all tasks to file
-    for ( ; *tasks; ++tasks) {
-        if (fprintf(fp, "%s\n", *tasks) < 0) {
-            fclose(fp);
-            return "Unable to write to list\n";
-        }
-    }
-
-    // Close file
-    if (fclose(fp) == EOF) {
-        return "Unable to close list\n";
-    }
-
-    // Show new list
-    if (verbose) {
-        // Initialize TaskList ADT
-        TaskList list = tasklist_init(file);
-        // Attempt reading the list
-        const char *error = tasklist_read(list);
-        if (error) {
-            tasklist_destroy(list);
-            return error;
-        }
-        // If there was no problem, print it
-        tasklist_print(list);
-        // Cleanup
-        tasklist_destroy(list);
-    }
-
-    return NULL;
+const char *tasklib_apply_add(TaskList list, char **tasks) {
+    return tasklist_insert_many(list, tasklist_length(list) + 1, tasks);
 }
 
-const char *tasklib_prepend(const char *file, char **tasks, int verbose) {
-    // Build TaskList ADT
-    TaskList list = tasklist_init(file);
-    // Try reading the list
-    const char *error = tasklist_read(list);
-    if (error) {
-        tasklist_destroy(list);
-        return error;
-    }
-    // Try inserting all tasks
-    for (int ipos = 1; *tasks; ++tasks) {
-        error = tasklist_insert(list, ipos++, *tasks);
-        if (error) {
-            tasklist_destroy(list);
-            return error;
-        }
-    }
-    // Try writing the updated list to file
-    error = tasklist_write(list);
-    if (error) {
-        tasklist_destroy(list);
-        return error;
-    }
-    // Show the modified list
-    if (verbose) {
-        tasklist_print(list);
-    }
-    tasklist_destroy(list);
-
-    return NULL;
+const char *tasklib_apply_prepend(TaskList list, char **tasks) {
+    // Insert all tasks at once
+    return tasklist_insert_many(list, 1, tasks);
 }
 
-const char *tasklib_insert(
-    const char *file, char **position_task, int verbose) {
+const char *tasklib_apply_insert(TaskList list, char **position_task) {
     /*
      * Extract position and task argument, checking for sanity
      */
@@ -290,168 +858,46 @@ const char *tasklib_insert(
             position = strtopos(*position_task);
             // Handle conversion error
             if (position == -1) {
-                return "Position not a number\n";
+                return error_message(ERROR_POSITION);
             }
         } else if (i == 1) {
             // Extract task text
             task = *position_task;
         } else {
             // There is an additional invalid argument
-            return "Too many arguments\n";
+            return error_message(ERROR_MANY_ARGUMENTS);
         }
     }
     // Abort if we don't have all required arguments
     if (position == -1 || task == NULL) {
-        return "Not enough arguments\n";
+        return error_message(ERROR_FEW_ARGUMENTS);
     }
 
-    /*
-     * Use TaskList to handle the insertion
-     */
-    // Build TaskList ADT
-    TaskList list = tasklist_init(file);
-    // Try reading the list
-    const char *error = tasklist_read(list);
-    if (error) {
-        tasklist_destroy(list);
-        return error;
-    }
-    // Try inserting the task
-    error = tasklist_insert(list, position, task);
-    if (error) {
-        tasklist_destroy(list);
-        return error;
-    }
-    // Try writing the updated list to file
-    error = tasklist_write(list);
-    if (error) {
-        tasklist_destroy(list);
-        return error;
-    }
-    // Show the modified list
-    if (verbose) {
-        tasklist_print(list);
-    }
-    tasklist_destroy(list);
-
-    return NULL;
+    // Use TaskList to handle the insertion
+    return tasklist_insert(list, position, task);
 }
 
-const char *tasklib_done(const char *file, char **posargs, int verbose) {
+const char *tasklib_apply_done(TaskList list, char **posargs) {
     // Determine number of positional arguments
     int length;
     for (length = 0; posargs[length]; ++length);
-    // Create array to store converted positions
-    long positions[length + 1];
+    // Create array to store converted ranges
+    struct tasklist_range ranges[length + 1];
     // Set terminator element
-    positions[length] = -1;
-    // Iterate over all positional arguments, building array of positions
+    ranges[length].first = ranges[length].last = -1;
+    // Iterate over all positional arguments, building array of ranges
     for (int i = 0; i < length; ++i) {
-        long position = strtopos(posargs[i]);
         // Handle conversion error
-        if (position == -1) {
-            return "Position not a number\n";
+        if (strtorange(posargs[i], &ranges[i]) == -1) {
+            return error_message(ERROR_POSITION);
         }
-        positions[i] = position;
     }
 
-    // Build TaskList ADT
-    TaskList list = tasklist_init(file);
-    // Try reading the list
-    const char *error = tasklist_read(list);
-    if (error) {
-        tasklist_destroy(list);
-        return error;
-    }
-    // Try deleting tasks
-    error = tasklist_done(list, positions);
-    if (error) {
-        tasklist_destroy(list);
-        return error;
-    }
-    // Try writing the updated list to file
-    error = tasklist_write(list);
-    if (error) {
-        tasklist_destroy(list);
-        return error;
-    }
-    // Show the modified list
-    if (verbose) {
-        tasklist_print(list);
-    }
-    tasklist_destroy(list);
-
-    return NULL;
+    // Use TaskList to delete the tasks
+    return tasklist_done_ranges(list, ranges);
 }
 
-const char *tasklib_names(const char *dir) {
-    DIR *dp;
-    struct dirent *ep;
-
-    // Attempt opening the directory stream
-    if ((dp = opendir(dir)) == NULL) {
-        return "Unable to open directory\n";
-    }
-
-    // Read dir entries into array
-    char **names = malloc(8 * sizeof(char *));
-    int size = 8;
-    int i = 0;
-    while ((ep = readdir (dp))) {
-        if (strcmp(ep->d_name, ".") != 0 && strcmp(ep->d_name, "..") != 0) {
-            // Increase array size if necessary
-            if (i == size) {
-                names = realloc(names, 2 * size * sizeof(char *));
-                size *= 2;
-            }
-            // Insert name into array
-            names[i++] = filename_to_name(ep->d_name);
-        }
-    }
-
-    // Sort array alphabetically
-    qsort(names, i, sizeof(char *), cmpstringp);
-
-    // Print list names
-    for (int y = 0; y < i; ++y) {
-        printf("%s\n", names[y]);
-    }
-
-    // Cleanup
-    closedir(dp);
-    for (i -= 1; i >= 0; --i) {
-        free(names[i]);
-    }
-    free(names);
-
-    return NULL;
-}
-
-const char *tasklib_list(char **files) {
-    // Iterate over path array until terminator is encountered
-    for ( ; *files; ++files) {
-        // Initialize TaskList ADT
-        TaskList list = tasklist_init(*files);
-        // Attempt reading current list
-        const char *error = tasklist_read(list);
-        if (error) {
-            tasklist_destroy(list);
-            return error;
-        }
-        // If there was no problem, print it
-        tasklist_print(list);
-        // Cleanup
-        tasklist_destroy(list);
-        // Print empty line if there is yet another list
-        if (*(files + 1)) {
-            printf("\n");
-        }
-    }
-
-    return NULL;
-}
-
-const char *tasklib_move(const char *file, char **from_to, int verbose) {
+const char *tasklib_apply_move(TaskList list, char **from_to) {
     /*
      * Extract position arguments, checking for sanity
      */
@@ -462,63 +908,258 @@ const char *tasklib_move(const char *file, char **from_to, int verbose) {
             from_pos = strtopos(*from_to);
             // Handle conversion error
             if (from_pos == -1) {
-                return "Position not a number\n";
+                return error_message(ERROR_POSITION);
             }
         } else if (i == 1) {
             // Extract to position
             to_pos = strtopos(*from_to);
             // Handle conversion error
             if (to_pos == -1) {
-                return "Position not a number\n";
+                return error_message(ERROR_POSITION);
             }
         } else {
             // There is an additional invalid argument
-            return "Too many arguments\n";
+            return error_message(ERROR_MANY_ARGUMENTS);
         }
     }
     // Abort if we don't have all required arguments
     if (from_pos == -1 || to_pos == -1) {
-        return "Not enough arguments\n";
+        return error_message(ERROR_FEW_ARGUMENTS);
     }
 
-    /*
-     * Use TaskList to handle the insertion
-     */
-    // Build TaskList ADT
-    TaskList list = tasklist_init(file);
-    // Try reading the list
-    const char *error = tasklist_read(list);
-    if (error) {
-        tasklist_destroy(list);
-        return error;
+    // Use TaskList to handle the movement
+    return tasklist_move(list, from_pos, to_pos);
+}
+
+const char *tasklib_apply_sort(TaskList list, char **order) {
+    // The order is given by letters, all of them optional
+    int flags = 0;
+    if (order[0]) {
+        if (order[1]) {
+            return error_message(ERROR_MANY_ARGUMENTS);
+        }
+        for (const char *c = order[0]; *c; ++c) {
+            if (*c == 'i') {
+                flags |= SORT_IGNORE_CASE;
+            } else if (*c == 'n') {
+                flags |= SORT_NATURAL;
+            } else if (*c == 'r') {
+                flags |= SORT_REVERSE;
+            } else {
+                return error_message(ERROR_ORDER);
+            }
+        }
     }
-    // Try inserting the task
-    error = tasklist_move(list, from_pos, to_pos);
-    if (error) {
-        tasklist_destroy(list);
-        return error;
+
+    // Use TaskList to sort the tasks
+    return tasklist_sort(list, flags);
+}
+
+/*
+ * Commands
+ */
+
+const char *tasklib_add(
+    const char *file, char **tasks, int verbose, const struct sink *sink) {
+    return append(file, tasks, -1, verbose, sink);
+}
+
+const char *tasklib_add_fd(
+    const char *file, int fd, int verbose, const struct sink *sink) {
+    return append(file, NULL, fd, verbose, sink);
+}
+
+const char *tasklib_prepend(
+    const char *file, char **tasks, int verbose, const struct sink *sink) {
+    return modify(file, tasklib_apply_prepend, tasks, verbose, sink);
+}
+
+const char *tasklib_prepend_fd(
+    const char *file, int fd, int verbose, const struct sink *sink) {
+    // The tasks all go in front, so the list is rewritten only once
+    char *buffer;
+    char **tasks = read_tasks(fd, &buffer);
+    if (tasks == NULL) {
+        return error_message(ERROR_READ_TASKS);
     }
-    // Try writing the updated list to file
-    error = tasklist_write(list);
-    if (error) {
-        tasklist_destroy(list);
+    const char *error = modify(
+        file, tasklib_apply_prepend, tasks, verbose, sink);
+    free(tasks);
+    free(buffer);
+
+    return error;
+}
+
+const char *tasklib_insert(
+    const char *file, char **position_task, int verbose,
+    const struct sink *sink) {
+    return modify(file, tasklib_apply_insert, position_task, verbose, sink);
+}
+
+const char *tasklib_done(
+    const char *file, char **posargs, int verbose,
+    const struct sink *sink) {
+    return modify(file, tasklib_apply_done, posargs, verbose, sink);
+}
+
+const char *tasklib_names(
+    const char *dir, int verbose, const char *formatarg,
+    const struct sink *sink) {
+    enum format format;
+    if (format_parse(formatarg, &format) == -1) {
+        return error_message(ERROR_FORMAT);
+    }
+
+    // Get the sorted names from the catalog
+    struct trace_mark mark;
+    trace_begin(&mark);
+    Catalog catalog = catalog_open(dir, 1);
+    trace_end(TRACE_CATALOG, &mark);
+    if (catalog == NULL) {
+        return error_message(ERROR_OPEN_DIR);
+    }
+    int count = catalog_length(catalog);
+    if (!verbose) {
+        const char **names = malloc((count ? count : 1) * sizeof(char *));
+        for (int i = 0; i < count; ++i) {
+            names[i] = catalog_name(catalog, i);
+        }
+        const char *error = print_names(names, count, NULL, format, sink);
+        free(names);
+        catalog_close(catalog);
         return error;
     }
-    // Show the modified list
-    if (verbose) {
-        tasklist_print(list);
+
+    // Take the known numbers of tasks, and note which lists need counting
+    char **names = malloc((count + 1) * sizeof(char *));
+    long *counts = malloc((count ? count : 1) * sizeof(long));
+    struct tally *tallies = malloc((count ? count : 1) * sizeof(struct tally));
+    int *counted = malloc((count ? count : 1) * sizeof(int));
+    int stale = 0;
+    for (int i = 0; i < count; ++i) {
+        names[i] = strdup(catalog_name(catalog, i));
+        if ((counts[i] = catalog_count(catalog, i)) == -1) {
+            counted[stale++] = i;
+        }
     }
-    tasklist_destroy(list);
+    names[count] = NULL;
+    catalog_close(catalog);
 
-    return NULL;
+    // Count them all at once, without holding on to the catalog while
+    // waiting for the lists, and record the results for next time
+    if (stale > 0) {
+        for (int i = 0; i < stale; ++i) {
+            tallies[i].file = get_file(dir, names[counted[i]]);
+        }
+        pool_run(stale, count_list, tallies);
+        catalog = catalog_open(dir, 0);
+        for (int i = 0; i < stale; ++i) {
+            counts[counted[i]] = tallies[i].count;
+            if (catalog && tallies[i].count != -1) {
+                catalog_set(catalog, names[counted[i]], tallies[i].count,
+                    &tallies[i].stamp);
+            }
+            free(tallies[i].file);
+        }
+        if (catalog) {
+            catalog_close(catalog);
+        }
+    }
+
+    const char *error = print_names(
+        (const char **) names, count, counts, format, sink);
+
+    // Cleanup
+    free_names(names);
+    free(counts);
+    free(tallies);
+    free(counted);
+
+    return error;
+}
+
+const char *tasklib_search(
+    const char *dir, char **args, int ignore_case, const char *formatarg,
+    const struct sink *sink) {
+    if (!args[0]) {
+        return error_message(ERROR_FEW_ARGUMENTS);
+    }
+    struct search search = {args[0], ignore_case, 0, FORMAT_TEXT, NULL};
+    if (format_parse(formatarg, &search.format) == -1) {
+        return error_message(ERROR_FORMAT);
+    }
+
+    return search_lists(dir, args + 1, &search, search_list, sink);
+}
+
+const char *tasklib_lookup(
+    const char *dir, char **args, const char *formatarg,
+    const struct sink *sink) {
+    if (!args[0]) {
+        return error_message(ERROR_FEW_ARGUMENTS);
+    }
+    enum format format;
+    if (format_parse(formatarg, &format) == -1) {
+        return error_message(ERROR_FORMAT);
+    }
+    // A trailing * asks for all words starting with the word
+    size_t length = strlen(args[0]);
+    int prefix = length > 0 && args[0][length - 1] == '*';
+    char *word = strndup(args[0], length - prefix);
+    length -= prefix;
+    // It needs to be exactly one word, since that's what the index holds
+    size_t word_length;
+    if (words_next(word, word + length, &word_length) != word ||
+        word_length != length) {
+        free(word);
+        return error_message(ERROR_WORD);
+    }
+    struct search search = {word, 1, prefix, format, NULL};
+    const char *error = search_lists(
+        dir, args + 1, &search, lookup_list, sink);
+    free(word);
+
+    return error;
+}
+
+const char *tasklib_list(
+    char **files, const char *formatarg, const struct sink *sink) {
+    return render_lists(files, NULL, formatarg, sink);
+}
+
+const char *tasklib_range(
+    char **files, const char *page, const char *formatarg,
+    const struct sink *sink) {
+    struct tasklist_range range;
+    if (strtopage(page, &range) == -1) {
+        return error_message(ERROR_RANGE);
+    }
+
+    return render_lists(files, &range, formatarg, sink);
+}
+
+const char *tasklib_move(
+    const char *file, char **from_to, int verbose, const struct sink *sink) {
+    return modify(file, tasklib_apply_move, from_to, verbose, sink);
+}
+
+const char *tasklib_sort(
+    const char *file, char **order, int verbose, const struct sink *sink) {
+    return modify(file, tasklib_apply_sort, order, verbose, sink);
 }
 
 const char *tasklib_remove(char **files) {
     // Iterate over path array until terminator is encountered
     for ( ; *files; ++files) {
-        // Attempt unlinking
-        if (unlink(*files) != 0) {
-            return "Unable to delete list\n";
+        // Attempt deleting the list with everything that belongs to it
+        TaskList list = tasklist_init(*files);
+        const char *error = tasklist_lock(list, 1);
+        if (!error) {
+            error = tasklist_remove(list);
+        }
+        tasklist_destroy(list);
+        if (error) {
+            return error;
         }
     }
 
@@ -1,15 +1,34 @@
 #ifndef TASKLIB_H
 #define TASKLIB_H
 
+#include "tasklist.h"
+
 /**
  * Appends tasks to a file.
  *
  * @param file Full path to the file
  * @param tasks Array of tasks, terminated by a NULL element
  * @param verbose Show list after modification (0 = false, 1 = true)
+ * @param sink Where to show it
  * @return Error message or NULL on success
  */
-const char *tasklib_add(const char *file, char **tasks, int verbose);
+const char *tasklib_add(
+    const char *file, char **tasks, int verbose, const struct sink *sink);
+
+/**
+ * Appends the newline-separated tasks read from a file descriptor to a file.
+ *
+ * The tasks are appended in blocks as they're read, so there can be more of
+ * them than fit in memory. Empty lines are skipped.
+ *
+ * @param file Full path to the file
+ * @param fd File descriptor to read the tasks from until its end
+ * @param verbose Show list after modification (0 = false, 1 = true)
+ * @param sink Where to show it
+ * @return Error message or NULL on success
+ */
+const char *tasklib_add_fd(
+    const char *file, int fd, int verbose, const struct sink *sink);
 
 /**
  * Prepends tasks to a file.
@@ -17,9 +36,26 @@ const char *tasklib_add(const char *file, char **tasks, int verbose);
  * @param file Full path to the file
  * @param tasks Array of tasks, terminated by a NULL element
  * @param verbose Show list after modification (0 = false, 1 = true)
+ * @param sink Where to show it
  * @return Error message or NULL on success
  */
-const char *tasklib_prepend(const char *file, char **tasks, int verbose);
+const char *tasklib_prepend(
+    const char *file, char **tasks, int verbose, const struct sink *sink);
+
+/**
+ * Prepends the newline-separated tasks read from a file descriptor to a
+ * file, rewriting it once.
+ *
+ * Empty lines are skipped.
+ *
+ * @param file Full path to the file
+ * @param fd File descriptor to read the tasks from until its end
+ * @param verbose Show list after modification (0 = false, 1 = true)
+ * @param sink Where to show it
+ * @return Error message or NULL on success
+ */
+const char *tasklib_prepend_fd(
+    const char *file, int fd, int verbose, const struct sink *sink);
 
 /**
  * Inserts a task into a list at a specific position.
@@ -30,37 +66,117 @@ const char *tasklib_prepend(const char *file, char **tasks, int verbose);
  * @param position_task Array containing the position (1-based, string), task
  *                      text and a terminating NULL element
  * @param verbose Show list after modification (0 = false, 1 = true)
+ * @param sink Where to show it
  * @return Error message or NULL on success
  */
 const char *tasklib_insert(
-    const char *file, char **position_task, int verbose);
+    const char *file, char **position_task, int verbose,
+    const struct sink *sink);
 
 /**
  * Deletes tasks from a list.
  *
+ * Positions and ranges may overlap, each task is deleted only once.
+ *
  * @param file Full path to file
- * @param positions Array of task indices (1-based, type string), terminated
- *                  by a NULL element
+ * @param positions Array of task indices or ranges of them (1-based, type
+ *                  string, e.g. "7" or "10-20"), terminated by a NULL
+ *                  element
  * @param verbose Show list after modification (0 = false, 1 = true)
+ * @param sink Where to show it
  * @return Error message or NULL on success
  */
-const char *tasklib_done(const char *file, char **positions, int verbose);
+const char *tasklib_done(
+    const char *file, char **positions, int verbose,
+    const struct sink *sink);
 
 /**
  * Prints the names of all task lists in the directory.
  *
+ * The names are taken from the directory's catalog, which is brought up to
+ * date first. The numbers of tasks it holds are used unless the lists
+ * changed since, in which case they're counted again.
+ *
  * @param dir Full path to directory
+ * @param verbose Show the number of tasks of every list (0 = false,
+ *                1 = true)
+ * @param format Name of the output format, one of text, json, tsv and nul
+ *               (NULL for text)
+ * @param sink Where to print them
  * @return Error message or NULL on success
  */
-const char *tasklib_names(const char *dir);
+const char *tasklib_names(
+    const char *dir, int verbose, const char *format,
+    const struct sink *sink);
 
 /**
- * Prints task lists to stdout.
+ * Prints the tasks containing a pattern, in the format "list:position: text"
+ * unless another format is given.
+ *
+ * @param dir Full path to directory
+ * @param args Array containing the pattern, optionally followed by the
+ *             names of the lists to search (all lists by default),
+ *             terminated by a NULL element
+ * @param ignore_case Ignore the case of ASCII letters (0 = false, 1 = true)
+ * @param format Name of the output format, one of text, json, tsv and nul
+ *               (NULL for text)
+ * @param sink Where to print them
+ * @return Error message or NULL on success
+ */
+const char *tasklib_search(
+    const char *dir, char **args, int ignore_case, const char *format,
+    const struct sink *sink);
+
+/**
+ * Prints the tasks containing a word, in the format "list:position: text".
+ *
+ * Case is ignored for ASCII letters. A trailing * also finds the words
+ * starting with the word. The lists' word indexes are used, built or
+ * updated as needed.
+ *
+ * @param dir Full path to directory
+ * @param args Array containing the word, optionally followed by the names
+ *             of the lists to search (all lists by default), terminated by
+ *             a NULL element
+ * @param format Name of the output format, one of text, json, tsv and nul
+ *               (NULL for text)
+ * @param sink Where to print them
+ * @return Error message or NULL on success
+ */
+const char *tasklib_lookup(
+    const char *dir, char **args, const char *format,
+    const struct sink *sink);
+
+/**
+ * Prints task lists.
+ *
+ * @param files Array of file paths, terminated by a NULL element
+ * @param format Name of the output format, one of text, json, tsv and nul
+ *               (NULL for text)
+ * @param sink Where to print them
+ * @return Error message or NULL on success
+ */
+const char *tasklib_list(
+    char **files, const char *format, const struct sink *sink);
+
+/**
+ * Prints a range of the tasks of task lists.
+ *
+ * Only as much of a list is read as it takes to get to the end of the
+ * range, unless it counts from the end.
  *
  * @param files Array of file paths, terminated by a NULL element
+ * @param page The positions to show, like "10-20" or "10-" for everything
+ *             from 10 on, "20" for the first 20 tasks or "-20" for the
+ *             last 20
+ * @param format Name of the output format, one of text, json, tsv and nul
+ *               (NULL for text)
+ * @param sink Where to print them
  * @return Error message or NULL on success
  */
-const char *tasklib_list(char **files);
+const char *tasklib_range(
+    char **files, const char *page, const char *format,
+    const struct sink *sink);
 
 /**
  * Moves a task inside a list by bubbling it up or down.
@@ -69,9 +185,25 @@ const char *tasklib_list(char **files);
  * @param from_to Array containing the source and destination positions
  *                (1-based, type string), terminated by a NULL element
  * @param verbose Show list after modification (0 = false, 1 = true)
+ * @param sink Where to show it
+ * @return Error message or NULL on success
+ */
+const char *tasklib_move(
+    const char *file, char **from_to, int verbose, const struct sink *sink);
+
+/**
+ * Sorts the tasks of a list by their text, keeping equal ones in order.
+ *
+ * @param file Full path to file
+ * @param order Array containing at most the order, as letters for ignoring
+ *              case (i), natural order of numbers (n) and reverse order
+ *              (r), terminated by a NULL element
+ * @param verbose Show list after modification (0 = false, 1 = true)
+ * @param sink Where to show it
  * @return Error message or NULL on success
  */
-const char *tasklib_move(const char *file, char **from_to, int verbose);
+const char *tasklib_sort(
+    const char *file, char **order, int verbose, const struct sink *sink);
 
 /**
  * Deletes task lists.
@@ -81,6 +213,65 @@ const char *tasklib_move(const char *file, char **from_to, int verbose);
  */
 const char *tasklib_remove(char **files);
 
+/**
+ * Appends tasks to a loaded list.
+ *
+ * @param list The TaskList
+ * @param tasks Array of tasks, terminated by a NULL element
+ * @return Error message or NULL on success
+ */
+const char *tasklib_apply_add(TaskList list, char **tasks);
+
+/**
+ * Prepends tasks to a loaded list.
+ *
+ * @param list The TaskList
+ * @param tasks Array of tasks, terminated by a NULL element
+ * @return Error message or NULL on success
+ */
+const char *tasklib_apply_prepend(TaskList list, char **tasks);
+
+/**
+ * Inserts a task into a loaded list at a specific position.
+ *
+ * @param list The TaskList
+ * @param position_task Array containing the position (1-based, string), task
+ *                      text and a terminating NULL element
+ * @return Error message or NULL on success
+ */
+const char *tasklib_apply_insert(TaskList list, char **position_task);
+
+/**
+ * Deletes tasks from a loaded list.
+ *
+ * @param list The TaskList
+ * @param positions Array of task indices or ranges of them (1-based, type
+ *                  string, e.g. "7" or "10-20"), terminated by a NULL
+ *                  element
+ * @return Error message or NULL on success
+ */
+const char *tasklib_apply_done(TaskList list, char **positions);
+
+/**
+ * Moves a task inside a loaded list.
+ *
+ * @param list The TaskList
+ * @param from_to Array containing the source and destination positions
+ *                (1-based, type string), terminated by a NULL element
+ * @return Error message or NULL on success
+ */
+const char *tasklib_apply_move(TaskList list, char **from_to);
+
+/**
+ * Sorts the tasks of a loaded list by their text.
+ *
+ * @param list The TaskList
+ * @param order Array containing at most the order, see tasklib_sort(),
+ *              terminated by a NULL element
+ * @return Error message or NULL on success
+ */
+const char *tasklib_apply_sort(TaskList list, char **order);
+
 /**
  * Builds a full path to the directory where lists are stored.
  *
@@ -1,20 +1,213 @@
-/* Using strdup & strndup, need POSIX 2008 */
+/* Using strdup, strndup, mmap, posix_madvise, mkstemp & clock_gettime,
+ * need POSIX 2008 */
 #define _POSIX_C_SOURCE 200809L
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
 #include <string.h>
 #include <limits.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "catalog.h"
+#include "errors.h"
+#include "format.h"
+#include "search.h"
 #include "tasklist.h"
+#include "trace.h"
+#include "width.h"
+#include "words.h"
 
 #define STARTING_CAPACITY 16
+/* Number of columns lists are formatted for, unless on a terminal */
+#define LINE_WIDTH 80
+/* Most bytes a line of a formatted list takes besides its text */
+#define LINE_OVERHEAD 32
+#define ARENA_BLOCK_SIZE 4096
+/* Size of the blocks read from lists that can't be mapped */
+#define READ_BLOCK_SIZE 65536
+/* Size of the blocks of tasks appended from a stream at once */
+#define APPEND_BLOCK_SIZE 1048576
+/* Size a journal may grow to before it's folded back into the list file */
+#define JOURNAL_LIMIT 16384
+/* Maximum length of the first line of a journal */
+#define JOURNAL_HEADER_SIZE 128
+/* Identifies (the format of) a line index */
+#define INDEX_MAGIC "TSKIDX1"
+/* Identifies (the format of) a word index */
+#define WORDS_MAGIC "TSKWRD1"
+/* Bounds of the pause between attempts to take a contended lock, in ns */
+#define LOCK_DELAY_MIN 1000000L
+#define LOCK_DELAY_MAX 50000000L
 
+/* Values of TASUKE_SYNC, deciding what is flushed to disk on writes */
+enum sync_policy { SYNC_NONE, SYNC_FILE, SYNC_DIR };
+
+/*
+ * A task is a view on its text, which is not terminated and does not include
+ * the newline. The text either lives in the mapped file or in the list's
+ * arena. Either way it's followed by a newline, except for a final line in
+ * the mapping that lacks one.
+ */
+struct task {
+    const char *text;
+    size_t length;
+};
+
+/*
+ * The arena is a chain of blocks that task text is carved out of.
+ * The newest block is at the head of the chain, each one at least twice as
+ * large as its predecessor, so there are only ever a few of them.
+ */
+struct arena_block {
+    struct arena_block *next;
+    size_t size;
+    size_t used;
+    char data[];
+};
+
+/*
+ * A buffer that a list is formatted into, to be written all at once.
+ */
+struct output {
+    char *data;
+    size_t length;
+    size_t size;
+    // How matches are formatted
+    enum format format;
+};
+
+/*
+ * What identifies a particular version of a file, as reported by stat.
+ */
+struct file_id {
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    time_t mtime;
+    long mtime_nsec;
+};
+
+/*
+ * The line index sits next to a list file and holds the offset of every line
+ * in it, so the file can be split into tasks without scanning it. It starts
+ * with this header, followed by the offsets as uint64_t.
+ */
+struct index_header {
+    char magic[8];
+    // Version of the list file the index was built for
+    uint64_t dev;
+    uint64_t ino;
+    int64_t size;
+    int64_t mtime;
+    int64_t mtime_nsec;
+    // Number of lines
+    uint64_t count;
+    // Whether the final line ends with a newline
+    uint64_t last_newline;
+};
+
+/*
+ * The word index sits next to a list file and holds the positions of the
+ * tasks every word occurs in. It starts with this header, followed by the
+ * offsets of the tasks in the list file as uint64_t (if there are any) and
+ * the word table.
+ */
+struct words_header {
+    char magic[8];
+    // Version of the list file and size of its journal (or -1) the index
+    // was built for
+    uint64_t dev;
+    uint64_t ino;
+    int64_t size;
+    int64_t mtime;
+    int64_t mtime_nsec;
+    int64_t journal_size;
+    // Number of tasks
+    uint64_t count;
+    // Whether the offsets of the tasks follow, which they only do if the
+    // list file holds exactly the tasks. There is one more than there are
+    // tasks, so task i ends one byte before task i + 1 starts.
+    uint64_t offsets;
+};
+
+/*
+ * The tasks array is a gap buffer. The unused slots form a gap starting at
+ * index gap, so the tasks are tasks[0..gap) followed by the last
+ * length - gap slots of the array. Inserting at the gap is cheap, and
+ * consecutive insertions at the same position don't shift anything.
+ */
 struct tasklist {
     char *path;
     char *name;
-    char **tasks;
+    struct task *tasks;
     int array_size;
     int length;
+    int gap;
+    // Index of the first task that may differ from what's in the file
+    int dirty;
+    // Whether only a range of the tasks was read, which can't be written,
+    // and the number of tasks before it
+    int partial;
+    int offset;
+    // Whether the file is a regular one that can be partially rewritten
+    int regular;
+    // Mapping of the file that unmodified tasks point into
+    char *map;
+    size_t map_size;
+    // Whether tasks in the mapping are at the same offsets in the file as
+    // last seen, which replacing the file undoes
+    int map_current;
+    // Storage for the text of all other tasks
+    struct arena_block *arena;
+    // Version of the file that was read or last written
+    struct file_id id;
+    /*
+     * The journal is a log of operations next to the list file, which
+     * readers replay over it. It starts with a header naming the version of
+     * the file it applies to, followed by one record per line:
+     *   a TEXT        Append task
+     *   i POS TEXT    Insert task at position
+     *   d RANGE...    Remove tasks at positions or ranges (like 3 or 10-20)
+     *   m FROM TO     Move task
+     *   s FLAGS       Sort tasks, with the flags of sort_strings()
+     * Sorting is recorded instead of the order it led to, so replaying it
+     * relies on sort_strings() always ordering the same tasks the same way,
+     * which it does since it keeps equal ones in their order.
+     */
+    char *journal_path;
+    // Size of the journal belonging to the file, or -1 if there is none
+    off_t journal_size;
+    // Whether there is a journal that belongs to another version of the file
+    int journal_stale;
+    // Whether modifications are appended to the journal when writing
+    int journaling;
+    // Whether only what changed is rewritten, in place, when writing
+    int in_place;
+    // Path of the line index and whether it's used
+    char *index_path;
+    int indexing;
+    // Path of the word index, which is kept up to date once it exists
+    char *words_path;
+    /*
+     * Concurrent processes coordinate through fcntl locks on a lock file next
+     * to the list file, since the list file itself is replaced on writes.
+     */
+    char *lock_path;
+    int lock_fd;
+    // Type of lock held (F_RDLCK or F_WRLCK), or -1 if there is none
+    int lock_type;
+    // Records for the modifications since the list was last read or written
+    char *records;
+    size_t records_length;
+    size_t records_size;
 };
 
 /**
@@ -40,299 +233,2789 @@ static char *path_to_name(const char *path) {
 }
 
 /**
- * Copies at most n chars from src into dest, splitting at spaces.
+ * Returns the path of a file next to the list file, with another extension.
+ *
+ * Because a new string needs to be allocated, the user must free it.
+ *
+ * @param path The full path to the list file
+ * @param extension The extension of the other file, including the dot
+ * @return The path to the other file (freed by user)
+ */
+static char *sidecar_path(const char *path, const char *extension) {
+    const char *name_start = strrchr(path, '/') + 1;
+    const char *name_end = strrchr(name_start, '.');
+    int length = name_end ? name_end - path : (int) strlen(path);
+    char *sidecar = malloc(length + strlen(extension) + 1);
+    sprintf(sidecar, "%.*s%s", length, path, extension);
+
+    return sidecar;
+}
+
+/**
+ * Returns whether an environment variable switching on a feature is set.
  *
- * It returns a pointer to the next character after the space where the
- * split was made.
- * It's imperative that the string is at least n characters long, because this
- * function does not check for the end.
- * The dest buffer needs to be n + 1 bytes large for the \0 terminator.
+ * @param name The name of the variable
+ * @return 1 if it's set to something other than the empty string or 0
+ */
+static int env_enabled(const char *name) {
+    const char *value = getenv(name);
+
+    return value && *value && strcmp(value, "0") != 0;
+}
+
+/**
+ * Makes room in the output buffer for the next n bytes.
  *
- * @param dest The buffer characters are copied into
- * @param src The string characters are copied from
- * @param n Maximum number of characters to copy
- * @return Pointer to the character that should be printed next
+ * @param output The output buffer
+ * @param end End of what was formatted into the buffer so far
+ * @param n Number of bytes needed
+ * @return End of the formatted data, possibly after moving the buffer
  */
-static const char *fold(char *dest, const char *src, int n) {
-    // Initialize end of copy (exclusive) to maximum number of characters,
-    // because that's where we'll split if there are no spaces
-    const char *end = src + n;
-    // This is the next character that should be printed
-    const char *next = src + n;
-    // Find the last space within n characters
-    for (int i = 0; i <= n; ++i) {
-        if (src[i] == ' ') {
-            // Set end (exclusive) to the space
-            end = src + i;
-            // The character after that is the next one that should be printed
-            next = src + i + 1;
+static char *output_reserve(struct output *output, char *end, size_t n) {
+    output->length = end - output->data;
+    if (output->size - output->length < n) {
+        while (output->size - output->length < n) {
+            output->size *= 2;
         }
+        output->data = realloc(output->data, output->size);
     }
-    // Copy characters before the last space into the destination buffer
-    strncpy(dest, src, end - src);
-    // Terminate the string
-    dest[end - src] = '\0';
 
-    return next;
+    return output->data + output->length;
 }
 
-TaskList tasklist_init(const char *path) {
-    // Allocate memory for ADT
-    TaskList list;
-    list = malloc(sizeof(*list));
+/**
+ * Copies bytes to the output.
+ *
+ * @param dest Where to copy to
+ * @param src The bytes to copy
+ * @param n Number of bytes to copy
+ * @return Pointer to the byte after the copy
+ */
+static char *put(char *dest, const char *src, size_t n) {
+    memcpy(dest, src, n);
 
-    // Initialize members
-    list->path = strdup(path);
-    list->name = path_to_name(list->path);
-    list->tasks = malloc(STARTING_CAPACITY * sizeof(char *));
-    list->array_size = STARTING_CAPACITY;
-    list->length = 0;
+    return dest + n;
+}
 
-    return list;
+/**
+ * Copies a line to the output, followed by the indentation of the next one.
+ *
+ * @param output The output buffer
+ * @param end End of the formatted data so far
+ * @param line The line
+ * @param line_end End of the line (exclusive)
+ * @param indent Number of columns the next line is indented by
+ * @return End of the formatted data
+ */
+static char *put_line(
+    struct output *output, char *end, const char *line, const char *line_end,
+    int indent) {
+    end = output_reserve(output, end, (line_end - line) + 1 + indent);
+    end = put(end, line, line_end - line);
+    *end++ = '\n';
+    memset(end, ' ', indent);
+
+    return end + indent;
 }
 
-void tasklist_destroy(TaskList list) {
-    // Free content of tasks array
-    for (int i = 0; i < list->length; ++i) {
-        free(list->tasks[i]);
+/**
+ * Formats a task, wrapping it onto as many lines as it needs.
+ *
+ * Lines are split at the last space that fits, which is dropped, or in the
+ * middle of a word if there is none. The text is measured in terminal
+ * columns in a single pass, without going back over any of it.
+ *
+ * @param output The output buffer
+ * @param end End of the formatted data so far, following the position
+ * @param task The task text
+ * @param task_end End of the task text (exclusive)
+ * @param space Number of columns available for the text (at least 1)
+ * @param indent Number of columns the following lines are indented by
+ * @return End of the formatted data
+ */
+static char *wrap(
+    struct output *output, char *end, const char *task, const char *task_end,
+    int space, int indent) {
+    // Text never takes more columns than bytes, so short tasks fit as they are
+    const char *line = task;
+    if (task_end - task > space) {
+        // Last space on the line and the columns up to and including it
+        const char *blank = NULL;
+        int blank_columns = 0;
+        // Columns taken by the line so far
+        int columns = 0;
+        const char *c = task;
+        while (c < task_end) {
+            // Every character in a run of ASCII takes a single column
+            const char *run_end = c + width_ascii(c, task_end - c);
+            for ( ; c < run_end; ++c) {
+                // A character wider than the space on its own can leave the
+                // line past it
+                if (columns >= space) {
+                    if (*c == ' ') {
+                        // Split right at this space
+                        end = put_line(output, end, line, c, indent);
+                        line = c + 1;
+                        columns = 0;
+                        blank = NULL;
+                        continue;
+                    } else if (blank) {
+                        // Split at the last space, keeping what follows it
+                        end = put_line(output, end, line, blank, indent);
+                        line = blank + 1;
+                        columns -= blank_columns;
+                        blank = NULL;
+                    } else {
+                        // Split the word
+                        end = put_line(output, end, line, c, indent);
+                        line = c;
+                        columns = 0;
+                    }
+                }
+                if (*c == ' ') {
+                    blank = c;
+                    blank_columns = columns + 1;
+                }
+                ++columns;
+            }
+            if (c == task_end) {
+                break;
+            }
+
+            // Other characters may take none or two
+            int char_columns;
+            const char *next = width_decode(c, task_end, &char_columns);
+            while (columns > 0 && columns + char_columns > space) {
+                if (blank) {
+                    end = put_line(output, end, line, blank, indent);
+                    line = blank + 1;
+                    columns -= blank_columns;
+                    blank = NULL;
+                } else {
+                    end = put_line(output, end, line, c, indent);
+                    line = c;
+                    columns = 0;
+                }
+            }
+            columns += char_columns;
+            c = next;
+        }
     }
-    // Free tasks array
-    free(list->tasks);
-    // Free other properties
-    free(list->path);
-    free(list->name);
-    // Free ADT
-    free(list);
+
+    // Print final line
+    end = output_reserve(output, end, (task_end - line) + 1);
+    end = put(end, line, task_end - line);
+    *end++ = '\n';
+
+    return end;
 }
 
-void tasklist_print(TaskList list) {
-    // Print list name
-    printf("\x1b[4m\x1b[1m%s\x1b[0m\n", list->name);
-    // If there are no tasks, show notice and return early
-    if (list->length == 0) {
-        printf(" No tasks\n");
-        return;
+/**
+ * Formats a positive number, right-aligned in a field of the given width.
+ *
+ * @param dest Where to format the number
+ * @param number The number
+ * @param width Minimum number of characters, padded with leading spaces
+ * @return Pointer to the character after the number
+ */
+static char *put_number(char *dest, long number, int width) {
+    char digits[24];
+    int length = 0;
+    do {
+        digits[length++] = '0' + number % 10;
+        number /= 10;
+    } while (number > 0);
+    for ( ; width > length; --width) {
+        *dest++ = ' ';
     }
-    // Determine format (for padding) depending on number of tasks
-    const char *format, *pad;
-    int space;
-    if (list->length < 10) {
-        format = " \x1b[1m%d\x1b[0m %s";
-        pad = "   ";
-        space = 80 - 3;
-    } else if (list->length < 100) {
-        format = " \x1b[1m%2d\x1b[0m %s";
-        pad = "    ";
-        space = 80 - 4;
-    } else {
-        format = " \x1b[1m%3d\x1b[0m %s";
-        pad = "     ";
-        space = 80 - 5;
+    while (length > 0) {
+        *dest++ = digits[--length];
     }
-    // Print tasks
-    for (int i = 0; i < list->length; ++i) {
-        if (strlen(list->tasks[i]) <= space + 1) {
-            // There is enough space to print the whole task on one line
-            printf(format, i + 1, list->tasks[i]);
-        } else {
-            // Need to split the task over several lines
-            const char *task = list->tasks[i];
-            char out[space + 1];
-            // Print the first line
-            task = fold(out, task, space);
-            printf(format, i + 1, out);
-            printf("\n");
-            // Print remaining lines
-            while (strlen(task) > space + 1) {
-                task = fold(out, task, space);
-                printf("%s%s\n", pad, out);
 
-            }
-            // Print final line
-            printf("%s%s", pad, task);
+    return dest;
+}
+
+/**
+ * Allocates memory for task text from the list's arena.
+ *
+ * The memory is only released together with the list.
+ *
+ * @param list The TaskList
+ * @param size Number of bytes needed
+ * @return Pointer to the memory
+ */
+static char *arena_alloc(TaskList list, size_t size) {
+    struct arena_block *block = list->arena;
+    if (block == NULL || block->size - block->used < size) {
+        // Start a new block, growing geometrically
+        size_t block_size = block ? 2 * block->size : ARENA_BLOCK_SIZE;
+        if (block_size < size) {
+            block_size = size;
         }
+        block = malloc(sizeof(*block) + block_size);
+        block->next = list->arena;
+        block->size = block_size;
+        block->used = 0;
+        list->arena = block;
     }
+    char *memory = block->data + block->used;
+    block->used += size;
+
+    return memory;
 }
 
-const char *tasklist_insert(
-    TaskList list, long position, const char *task) {
-    /*
-     * Preparatory work: sanity check, memory allocation
-     */
-    // Handle position out of range
-    if (position < 1 || position > list->length + 1) {
-        return "Invalid position\n";
+/**
+ * Copies n characters of text into the list's arena, followed by a newline.
+ *
+ * Having the newline right behind the text, like in the mapping, lets
+ * consecutive tasks be written in one piece.
+ *
+ * @param list The TaskList
+ * @param text The text to copy (needn't be terminated)
+ * @param n Number of characters to copy
+ * @return Pointer to the copy (not terminated)
+ */
+static const char *arena_copy(TaskList list, const char *text, size_t n) {
+    char *copy = arena_alloc(list, n + 1);
+    memcpy(copy, text, n);
+    copy[n] = '\n';
+
+    return copy;
+}
+
+/**
+ * Releases all arena blocks and the file mapping of a list.
+ *
+ * @param list The TaskList
+ */
+static void release_storage(TaskList list) {
+    while (list->arena) {
+        struct arena_block *next = list->arena->next;
+        free(list->arena);
+        list->arena = next;
     }
-    // If task array is full, allocate memory for an additional element
-    if (list->array_size == list->length) {
-        list->tasks = realloc(
-            list->tasks, (list->array_size + 1) * sizeof(char *));
-        ++(list->array_size);
+    if (list->map) {
+        munmap(list->map, list->map_size);
+        list->map = NULL;
+        list->map_size = 0;
     }
-    // Allocate memory for the task
-    char *new_task = malloc((strlen(task) + 2) * sizeof(char));
-    // Copy the task into the new memory, appending newline
-    sprintf(new_task, "%s\n", task);
-    // Turn 1-based position into 0-based index
-    long index = position - 1;
+}
 
-    /*
-     * Insertion
-     */
-    if (index == list->length) {
-        // Simple case: append task to end
-        list->tasks[list->length] = new_task;
-    } else {
-        // Normal case: insert somewhere and bubble other elements down
-        char *current, *previous = new_task;
-        for (int i = index; i < list->length + 1; ++i) {
-            current = list->tasks[i];
-            list->tasks[i] = previous;
-            previous = current;
-        }
-    }
-    // Increment length
-    ++(list->length);
+/**
+ * Compares two task ranges by their first position.
+ *
+ * This is a comparison function to be passed into qsort().
+ *
+ * @param r1 The first range
+ * @param r2 The second range
+ * @return Integer greater than, equal to or less than 0 depending on how
+ *         r1 compares to r2.
+ */
+static int cmprangep(const void *r1, const void *r2) {
+    long first1 = ((const struct tasklist_range *) r1)->first;
+    long first2 = ((const struct tasklist_range *) r2)->first;
+    return (first1 > first2) - (first1 < first2);
+}
 
-    return NULL;
+/**
+ * Marks the tasks from the given index onwards as differing from the file.
+ *
+ * @param list The TaskList
+ * @param index Index of the first task that changed (0-based)
+ */
+static void mark_dirty(TaskList list, long index) {
+    if (index < list->dirty) {
+        list->dirty = index;
+    }
 }
 
-const char *tasklist_done(TaskList list, const long *positions) {
-    /*
-     * Delete selected tasks
-     */
-    int done_count = 0;
-    // Iterate over given positions
-    for ( ; *positions != -1; ++positions) {
-        // Handle position out of range
-        if (*positions < 1 || *positions > list->length) {
-            return "Invalid position\n";
+/**
+ * Writes a buffer to a file descriptor, retrying partial writes.
+ *
+ * @param fd The file descriptor
+ * @param buffer The data to write
+ * @param size Number of bytes to write
+ * @return 0 on success or -1 on error
+ */
+static int write_all(int fd, const char *buffer, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, buffer, size);
+        if (written == -1) {
+            return -1;
         }
-        // Turn 1-based position into 0-based index
-        long index = *positions - 1;
-        // Remove task from list
-        free(list->tasks[index]);
-        list->tasks[index] = NULL;
-        // Remember we deleted a task
-        ++done_count;
+        buffer += written;
+        size -= written;
     }
 
-    /*
-     * Build new task list with the remaining ones
-     */
-    int new_length = list->length - done_count;
-    // If no tasks remain, just update the count and terminate
-    if (new_length == 0) {
-        list->length = 0;
-        return NULL;
-    }
-    // Allocate memory for the new task list
-    char **tasks = malloc(new_length * sizeof(char *));
-    // Iterate over the old list, copying over the surviving elements
-    for (int i = 0, y = 0; i < list->length; ++i) {
-        if (list->tasks[i]) {
-            tasks[y++] = list->tasks[i];
+    return 0;
+}
+
+/**
+ * Writes a buffer to a file descriptor at an offset, retrying partial writes.
+ *
+ * @param fd The file descriptor
+ * @param buffer The data to write
+ * @param size Number of bytes to write
+ * @param offset Offset in the file to start writing at
+ * @return 0 on success or -1 on error
+ */
+static int pwrite_all(int fd, const char *buffer, size_t size, off_t offset) {
+    while (size > 0) {
+        ssize_t written = pwrite(fd, buffer, size, offset);
+        if (written == -1) {
+            return -1;
         }
+        buffer += written;
+        size -= written;
+        offset += written;
     }
-    // Free the old list of task references
-    free(list->tasks);
-    // Use the new list of references instead
-    list->tasks = tasks;
-    // Update the count
-    list->length = new_length;
-    list->array_size = new_length;
 
-    return NULL;
+    return 0;
 }
 
-const char *tasklist_move(TaskList list, long from_pos, long to_pos) {
-    /*
-     * Preparatory work with sanity checking
-     */
-    // Handle positions out of range
-    if (from_pos < 1 || from_pos > list->length ||
-        to_pos < 1 || to_pos > list->length) {
-        return "Invalid position\n";
+/**
+ * Takes the version of a file from the result of stat.
+ *
+ * @param id The file_id to fill in
+ * @param st The stat result
+ */
+static void file_id_from_stat(struct file_id *id, const struct stat *st) {
+    id->dev = st->st_dev;
+    id->ino = st->st_ino;
+    id->size = st->st_size;
+    id->mtime = st->st_mtim.tv_sec;
+    id->mtime_nsec = st->st_mtim.tv_nsec;
+}
+
+/**
+ * Formats the header line of a journal for a version of the list file.
+ *
+ * @param buffer Buffer of JOURNAL_HEADER_SIZE bytes for the header
+ * @param id The version of the list file the journal applies to
+ * @return Length of the header, including its newline
+ */
+static int journal_header(char *buffer, const struct file_id *id) {
+    return snprintf(
+        buffer, JOURNAL_HEADER_SIZE, "tasuke-journal %ju %ju %jd %jd %ld\n",
+        (uintmax_t) id->dev, (uintmax_t) id->ino, (intmax_t) id->size,
+        (intmax_t) id->mtime, id->mtime_nsec);
+}
+
+/**
+ * Appends a formatted record to the list's pending journal records.
+ *
+ * Nothing is recorded unless the list is journaling.
+ *
+ * @param list The TaskList
+ * @param format printf-style format of the record, including its newline
+ */
+static void record(TaskList list, const char *format, ...) {
+    if (!list->journaling) {
+        return;
     }
-    // Abort when there's nothing to do
-    if (from_pos == to_pos) {
-        return NULL;
+    va_list args;
+    // Find out how long the record is going to be
+    va_start(args, format);
+    int length = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    // Grow the buffer geometrically, leaving space for the terminator
+    if (list->records_size - list->records_length < (size_t) length + 1) {
+        list->records_size = 2 * list->records_size + length + 1;
+        list->records = realloc(list->records, list->records_size);
     }
-    // Turn 1-based positions into 0-based indices
-    long from = from_pos - 1, to = to_pos - 1;
+    va_start(args, format);
+    vsprintf(list->records + list->records_length, format, args);
+    va_end(args);
+    list->records_length += length;
+}
 
-    /*
-     * Movement
-     */
-    if (from < to) {
-        for (int i = from; i < to; ++i) {
-            char *current = list->tasks[i];
-            list->tasks[i] = list->tasks[i + 1];
-            list->tasks[i + 1] = current;
-        }
-    } else {
-        for (int i = from; i > to; --i) {
-            char *current = list->tasks[i];
-            list->tasks[i] = list->tasks[i - 1];
-            list->tasks[i - 1] = current;
-        }
+/**
+ * Moves the gap of the tasks array so that it starts at the given index.
+ *
+ * @param list The TaskList
+ * @param index The new start of the gap (0-based, at most length)
+ */
+static void move_gap(TaskList list, int index) {
+    int gap_size = list->array_size - list->length;
+    if (index < list->gap) {
+        // Shift the tasks between index and gap to the end of the gap
+        memmove(
+            list->tasks + index + gap_size, list->tasks + index,
+            (list->gap - index) * sizeof(struct task));
+    } else if (index > list->gap) {
+        // Shift the tasks after the gap to its start
+        memmove(
+            list->tasks + list->gap, list->tasks + list->gap + gap_size,
+            (index - list->gap) * sizeof(struct task));
     }
+    list->gap = index;
+}
 
-    return NULL;
+/**
+ * Makes the tasks contiguous, so that tasks[i] is the task at index i.
+ *
+ * @param list The TaskList
+ */
+static void close_gap(TaskList list) {
+    move_gap(list, list->length);
 }
 
-const char *tasklist_read(TaskList list) {
-    // Open file in read mode
-    FILE *fp;
-    if ((fp = fopen(list->path, "r")) == NULL) {
-        return "Unable to open list\n";
+/**
+ * Makes sure the gap has room for at least count tasks.
+ *
+ * The array grows geometrically, so repeated insertions are amortized.
+ *
+ * @param list The TaskList
+ * @param count Number of tasks that are about to be inserted at the gap
+ */
+static void reserve(TaskList list, int count) {
+    int gap_size = list->array_size - list->length;
+    if (gap_size >= count) {
+        return;
+    }
+    // At least double the array size
+    int new_size = 2 * list->array_size;
+    if (new_size < list->length + count) {
+        new_size = list->length + count;
     }
+    list->tasks = realloc(list->tasks, new_size * sizeof(struct task));
+    // Move the tasks after the gap to the end of the larger array
+    int tail = list->length - list->gap;
+    memmove(
+        list->tasks + new_size - tail,
+        list->tasks + list->gap + gap_size,
+        tail * sizeof(struct task));
+    list->array_size = new_size;
+}
 
-    // Read tasks
-    char line[LINE_MAX];
-    int i = 0;
-    while (fgets(line, LINE_MAX, fp) != NULL) {
-        if (list->array_size - i == 0) {
-            // Double array size
-            list->tasks = realloc(
-                list->tasks, 2 * list->array_size * sizeof(char *));
-            list->array_size *= 2;
+/**
+ * Appends a task view to the end of the list, growing the array if necessary.
+ *
+ * @param list The TaskList
+ * @param text The text of the task (not terminated, without newline)
+ * @param length Number of characters in the text
+ */
+static void append_task(TaskList list, const char *text, size_t length) {
+    move_gap(list, list->length);
+    reserve(list, 1);
+    list->tasks[list->gap].text = text;
+    list->tasks[list->gap].length = length;
+    ++(list->gap);
+    ++(list->length);
+}
+
+/**
+ * Reads tasks from a stream in large blocks, splitting them into lines.
+ *
+ * This is the fallback for files that can't be mapped, like empty files or
+ * anything that isn't a regular file. Lines can be of any length. The
+ * complete lines of every block are copied into the arena at once, and only
+ * the partial line at its end is carried over to the next.
+ *
+ * @param list The TaskList
+ * @param fd File descriptor open for reading, closed by this function
+ * @return Error message or NULL on success
+ */
+static const char *read_stream(TaskList list, int fd) {
+    // Room for a block behind the partial line of the previous one
+    size_t size = 2 * READ_BLOCK_SIZE, length = 0;
+    char *buffer = malloc(size);
+    const char *error = NULL;
+    while (1) {
+        // Grow the buffer when a single line gets long
+        if (size - length < READ_BLOCK_SIZE) {
+            size *= 2;
+            buffer = realloc(buffer, size);
+        }
+        ssize_t got = read(fd, buffer + length, size - length);
+        if (got == -1 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            error = got == -1 ? error_message(ERROR_READ_LIST) : NULL;
+            break;
         }
-        // Make a copy of the task
-        char *task = strdup(line);
-        // Add task to list
-        list->tasks[i++] = task;
-        ++(list->length);
+        // The partial line has no newline, so only what was just read can
+        // complete any lines
+        char *end = buffer + length + got, *complete = end;
+        while (complete > buffer + length && complete[-1] != '\n') {
+            --complete;
+        }
+        if (complete == buffer + length) {
+            length += got;
+            continue;
+        }
+
+        // Point the tasks into a copy of the complete lines, which already
+        // have their newlines behind them like in the arena
+        size_t complete_length = complete - buffer;
+        char *text = arena_alloc(list, complete_length);
+        memcpy(text, buffer, complete_length);
+        const char *line = text, *text_end = text + complete_length;
+        while (line < text_end) {
+            const char *newline = memchr(line, '\n', text_end - line);
+            append_task(list, line, newline - line);
+            line = newline + 1;
+        }
+        length = end - complete;
+        memmove(buffer, complete, length);
     }
+    // The final line may lack its newline
+    if (!error && length > 0) {
+        append_task(list, arena_copy(list, buffer, length), length);
+    }
+    free(buffer);
 
     // Close file
-    if (fclose(fp) == EOF) {
-        return "Unable to close list\n";
+    if (close(fd) == -1 && !error) {
+        error = error_message(ERROR_CLOSE_LIST);
     }
 
-    return NULL;
+    return error;
 }
 
-const char *tasklist_write(TaskList list) {
-    // Open file in write mode
-    FILE *fp;
-    if ((fp = fopen(list->path, "w")) == NULL) {
-        return "Unable to open list\n";
+/**
+ * Counts the lines of a text, including a final one without newline.
+ *
+ * @param text The text
+ * @param end End of the text (exclusive)
+ * @return Number of lines
+ */
+static long count_lines(const char *text, const char *end) {
+    long count = 0;
+    const char *newline;
+    while ((newline = memchr(text, '\n', end - text)) != NULL) {
+        ++count;
+        text = newline + 1;
     }
 
-    // Write all tasks to file
-    for (int i = 0; i < list->length; ++i) {
-        // Attempt write
-        if (fputs(list->tasks[i], fp) == EOF) {
-            fclose(fp);
-            return "Unable to write to list\n";
-        }
+    return count + (text < end);
+}
+
+/**
+ * Turns positions counting back from the end into regular ones.
+ *
+ * @param length Number of tasks
+ * @param first First position, -1 being the last task, set to at least 1
+ * @param last Last position, -1 being the last task
+ */
+static void resolve_range(long length, long *first, long *last) {
+    if (*first < 0) {
+        *first += length + 1;
+    }
+    if (*last < 0) {
+        *last += length + 1;
+    }
+    if (*first < 1) {
+        *first = 1;
     }
+}
 
-    // Close file
-    if (fclose(fp) == EOF) {
-        return "Unable to close list\n";
+/**
+ * Drops all tasks of a list that was read as a whole but a range.
+ *
+ * @param list The TaskList
+ * @param first First position to keep, negative counting from the end
+ * @param last Last position to keep, negative counting from the end
+ */
+static void keep_range(TaskList list, long first, long last) {
+    close_gap(list);
+    resolve_range(list->length, &first, &last);
+    if (first > list->length) {
+        first = list->length + 1;
+    }
+    if (last > list->length) {
+        last = list->length;
+    }
+    int count = last >= first ? last - first + 1 : 0;
+    memmove(list->tasks, list->tasks + first - 1,
+        count * sizeof(struct task));
+    list->offset = first - 1;
+    list->length = count;
+    list->gap = count;
+}
+
+TaskList tasklist_init(const char *path) {
+    // Allocate memory for ADT
+    TaskList list;
+    list = malloc(sizeof(*list));
+
+    // Initialize members
+    list->path = strdup(path);
+    list->name = path_to_name(list->path);
+    list->tasks = malloc(STARTING_CAPACITY * sizeof(struct task));
+    list->array_size = STARTING_CAPACITY;
+    list->length = 0;
+    list->gap = 0;
+    list->dirty = 0;
+    list->partial = 0;
+    list->offset = 0;
+    list->regular = 0;
+    list->map = NULL;
+    list->map_size = 0;
+    list->map_current = 0;
+    list->arena = NULL;
+    memset(&list->id, 0, sizeof(list->id));
+    list->journal_path = sidecar_path(list->path, ".log");
+    list->journal_size = -1;
+    list->journal_stale = 0;
+    list->journaling = env_enabled("TASUKE_JOURNAL");
+    list->in_place = env_enabled("TASUKE_IN_PLACE");
+    list->index_path = sidecar_path(list->path, ".idx");
+    list->indexing = env_enabled("TASUKE_INDEX");
+    list->words_path = sidecar_path(list->path, ".words");
+    list->lock_path = sidecar_path(list->path, ".lock");
+    list->lock_fd = -1;
+    list->lock_type = -1;
+    list->records = NULL;
+    list->records_length = 0;
+    list->records_size = 0;
+
+    return list;
+}
+
+void tasklist_destroy(TaskList list) {
+    // Let others have the list
+    tasklist_unlock(list);
+    // Free tasks array
+    free(list->tasks);
+    // Release all task text at once
+    release_storage(list);
+    // Free other properties
+    free(list->path);
+    free(list->name);
+    free(list->journal_path);
+    free(list->index_path);
+    free(list->words_path);
+    free(list->lock_path);
+    free(list->records);
+    // Free ADT
+    free(list);
+}
+
+int tasklist_length(TaskList list) {
+    return list->length;
+}
+
+const char *tasklist_print(TaskList list, const struct sink *sink) {
+    struct trace_mark mark;
+    trace_begin(&mark);
+    size_t size;
+    char *output = tasklist_render(
+        list, sink_terminal(sink), tasklist_columns(sink), &size);
+    int result = sink_write(sink, output, size);
+    free(output);
+    trace_end(TRACE_PRINT, &mark);
+
+    return result == -1 ? error_message(ERROR_OUTPUT) : NULL;
+}
+
+int tasklist_columns(const struct sink *sink) {
+    struct winsize size;
+    if (sink_terminal(sink) && ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 &&
+        size.ws_col > 0) {
+        return size.ws_col;
+    }
+
+    return LINE_WIDTH;
+}
+
+char *tasklist_render(TaskList list, int ansi, int columns, size_t *size) {
+    struct trace_mark mark;
+    trace_begin(&mark);
+    close_gap(list);
+    // Positions are right-aligned to the width of the largest one, and the
+    // text follows after a space on either side
+    int width = 1;
+    for (int n = list->offset + list->length; n >= 10; n /= 10) {
+        ++width;
+    }
+    int indent = width + 2;
+    int space = columns > indent ? columns - indent : 1;
+
+    // Guess the size from the file, so the buffer rarely needs to grow
+    size_t name_length = strlen(list->name);
+    struct output output;
+    output.size = name_length + list->map_size +
+        (size_t) list->length * (width + LINE_OVERHEAD) + LINE_OVERHEAD;
+    output.data = malloc(output.size);
+    output.length = 0;
+    output.format = FORMAT_TEXT;
+    char *end = output_reserve(
+        &output, output.data, name_length + LINE_OVERHEAD);
+
+    // Print list name
+    if (ansi) {
+        end = put(end, "\x1b[4m\x1b[1m", 8);
+    }
+    end = put(end, list->name, name_length);
+    if (ansi) {
+        end = put(end, "\x1b[0m", 4);
+    }
+    *end++ = '\n';
+    // If there are no tasks, show notice
+    if (list->length == 0 && list->offset == 0) {
+        end = put(end, " No tasks\n", 10);
+    }
+
+    // Print tasks
+    for (int i = 0; i < list->length; ++i) {
+        const char *task = list->tasks[i].text;
+        const char *task_end = task + list->tasks[i].length;
+        // The position goes on the first line
+        end = output_reserve(&output, end, width + LINE_OVERHEAD);
+        *end++ = ' ';
+        if (ansi) {
+            end = put(end, "\x1b[1m", 4);
+        }
+        end = put_number(end, list->offset + i + 1, width);
+        if (ansi) {
+            end = put(end, "\x1b[0m", 4);
+        }
+        *end++ = ' ';
+        end = wrap(&output, end, task, task_end, space, indent);
+    }
+    *size = end - output.data;
+    trace_end(TRACE_RENDER, &mark);
+
+    return output.data;
+}
+
+char *tasklist_export(TaskList list, enum format format, size_t *size) {
+    struct trace_mark mark;
+    trace_begin(&mark);
+    close_gap(list);
+    size_t name_length = strlen(list->name);
+    size_t name_size = format_escaped_size(format, name_length);
+
+    // Guess the size from the file, so the buffer rarely needs to grow
+    struct output output;
+    output.size = list->map_size +
+        (size_t) list->length * (name_length + LINE_OVERHEAD) + LINE_OVERHEAD;
+    output.data = malloc(output.size);
+    output.length = 0;
+    output.format = format;
+    char *end = output.data;
+    for (int i = 0; i < list->length; ++i) {
+        const struct task *task = &list->tasks[i];
+        end = output_reserve(&output, end, FORMAT_OVERHEAD + name_size +
+            format_escaped_size(format, task->length));
+        end = format_task(
+            end, format, list->name, name_length, list->offset + i + 1,
+            task->text, task->length);
+    }
+    *size = end - output.data;
+    trace_end(TRACE_RENDER, &mark);
+
+    return output.data;
+}
+
+/**
+ * Formats a task that matched a search, in the format of the output buffer.
+ *
+ * @param output The output buffer
+ * @param end End of the formatted data so far
+ * @param list The TaskList the task is in
+ * @param position Position of the task
+ * @param text The task text
+ * @param length Length of the task text
+ * @return End of the formatted data
+ */
+static char *put_match(
+    struct output *output, char *end, TaskList list, long position,
+    const char *text, size_t length) {
+    size_t name_length = strlen(list->name);
+    if (output->format != FORMAT_TEXT) {
+        end = output_reserve(output, end, FORMAT_OVERHEAD +
+            format_escaped_size(output->format, name_length + length));
+        return format_task(
+            end, output->format, list->name, name_length, position, text,
+            length);
+    }
+    end = output_reserve(output, end, name_length + length + LINE_OVERHEAD);
+    end = put(end, list->name, name_length);
+    *end++ = ':';
+    end = put_number(end, position, 1);
+    end = put(end, ": ", 2);
+    end = put(end, text, length);
+    *end++ = '\n';
+
+    return end;
+}
+
+/**
+ * Searches the lines of a list file for a pattern.
+ *
+ * @param output The output buffer
+ * @param end End of the formatted data so far
+ * @param list The TaskList the file belongs to
+ * @param text The content of the file
+ * @param text_end End of the content (exclusive)
+ * @param pattern The pattern, which doesn't contain newlines
+ * @param ignore_case Whether to ignore case (0 = false, 1 = true)
+ * @return End of the formatted data
+ */
+static char *search_lines(
+    struct output *output, char *end, TaskList list, const char *text,
+    const char *text_end, const char *pattern, int ignore_case) {
+    size_t pattern_length = strlen(pattern);
+    // Start of the line that position refers to
+    const char *line = text;
+    long position = 1;
+    const char *match;
+    while (line < text_end &&
+        (match = search_find(
+            line, text_end - line, pattern, pattern_length, ignore_case))) {
+        // Count the lines up to the match
+        const char *newline;
+        while ((newline = memchr(line, '\n', match - line)) != NULL) {
+            line = newline + 1;
+            ++position;
+        }
+        // Print the whole line, then go on after it
+        const char *line_end = memchr(match, '\n', text_end - match);
+        if (line_end == NULL) {
+            line_end = text_end;
+        }
+        end = put_match(output, end, list, position, line, line_end - line);
+        line = line_end + 1;
+        ++position;
+    }
+
+    return end;
+}
+
+const char *tasklist_search(
+    TaskList list, const char *pattern, int ignore_case, enum format format,
+    char **result, size_t *size) {
+    struct output output;
+    output.size = 4096;
+    output.data = malloc(output.size);
+    output.length = 0;
+    output.format = format;
+    char *end = output.data;
+    *result = NULL;
+    *size = 0;
+
+    // Tasks can't contain newlines, so such a pattern can't match anything
+    if (strchr(pattern, '\n')) {
+        *result = output.data;
+        return NULL;
+    }
+
+    /*
+     * Unless the list was read already, search its file directly
+     */
+    int fd = -1;
+    struct stat st;
+    if (list->map == NULL && list->length == 0) {
+        if ((fd = open(list->path, O_RDONLY)) == -1) {
+            free(output.data);
+            return error_message(ERROR_OPEN_LIST);
+        }
+        // Only regular files without a journal hold exactly the tasks
+        if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) ||
+            access(list->journal_path, F_OK) == 0) {
+            close(fd);
+            fd = -1;
+            const char *error = tasklist_read(list);
+            if (error) {
+                free(output.data);
+                return error;
+            }
+        }
+    }
+    if (fd != -1) {
+        char *map = NULL;
+        if (st.st_size > 0 &&
+            (map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) ==
+            MAP_FAILED) {
+            close(fd);
+            free(output.data);
+            return error_message(ERROR_READ_LIST);
+        }
+        close(fd);
+        if (map) {
+            posix_madvise(map, st.st_size, POSIX_MADV_SEQUENTIAL);
+            end = search_lines(
+                &output, end, list, map, map + st.st_size, pattern,
+                ignore_case);
+            munmap(map, st.st_size);
+        }
+    } else {
+        // Search the tasks one by one
+        close_gap(list);
+        size_t pattern_length = strlen(pattern);
+        for (int i = 0; i < list->length; ++i) {
+            const struct task *task = &list->tasks[i];
+            if (search_find(task->text, task->length, pattern, pattern_length,
+                ignore_case)) {
+                end = put_match(
+                    &output, end, list, i + 1, task->text, task->length);
+            }
+        }
+    }
+    *result = output.data;
+    *size = end - output.data;
+
+    return NULL;
+}
+
+const char *tasklist_insert(
+    TaskList list, long position, const char *task) {
+    char *tasks[] = {(char *) task, NULL};
+
+    return tasklist_insert_many(list, position, tasks);
+}
+
+const char *tasklist_insert_many(
+    TaskList list, long position, char **tasks) {
+    // Handle position out of range
+    if (position < 1 || position > list->length + 1) {
+        return error_message(ERROR_INVALID_POSITION);
+    }
+    // Count the tasks to make room for all of them at once, and keep them
+    // on a line (and in a journal record) each
+    int count;
+    for (count = 0; tasks[count]; ++count) {
+        if (strchr(tasks[count], '\n')) {
+            return error_message(ERROR_NEWLINE);
+        }
+    }
+    // Turn 1-based position into 0-based index and open the gap there
+    move_gap(list, position - 1);
+    reserve(list, count);
+    mark_dirty(list, position - 1);
+    // Fill the gap with copies of the tasks, since they're not in the mapping
+    for (int i = 0; i < count; ++i) {
+        struct task *new_task = &list->tasks[list->gap++];
+        new_task->length = strlen(tasks[i]);
+        new_task->text = arena_copy(list, tasks[i], new_task->length);
+        record(list, "i %ld %s\n", position + i, tasks[i]);
+    }
+    list->length += count;
+
+    return NULL;
+}
+
+const char *tasklist_done(TaskList list, const long *positions) {
+    // Turn every position into a range covering only that position
+    int count;
+    for (count = 0; positions[count] != -1; ++count);
+    struct tasklist_range ranges[count + 1];
+    for (int i = 0; i < count; ++i) {
+        ranges[i].first = ranges[i].last = positions[i];
+    }
+    ranges[count].first = ranges[count].last = -1;
+
+    return tasklist_done_ranges(list, ranges);
+}
+
+const char *tasklist_done_ranges(
+    TaskList list, const struct tasklist_range *ranges) {
+    /*
+     * Validate the ranges and sort a copy of them by their first position
+     */
+    int count;
+    for (count = 0; ranges[count].first != -1; ++count) {
+        // Handle position out of range
+        if (ranges[count].first < 1 || ranges[count].last > list->length ||
+            ranges[count].first > ranges[count].last) {
+            return error_message(ERROR_INVALID_POSITION);
+        }
+    }
+    struct tasklist_range *sorted = malloc(
+        (count ? count : 1) * sizeof(struct tasklist_range));
+    memcpy(sorted, ranges, count * sizeof(struct tasklist_range));
+    qsort(sorted, count, sizeof(struct tasklist_range), cmprangep);
+    if (count > 0) {
+        mark_dirty(list, sorted[0].first - 1);
+    }
+
+    record(list, "d");
+    for (int i = 0; i < count; ++i) {
+        record(list, " %ld-%ld", ranges[i].first, ranges[i].last);
+    }
+    record(list, "\n");
+
+    /*
+     * Remove the ranges front to back by moving the gap over them.
+     * The tasks between ranges are moved only once and those after the last
+     * one not at all.
+     */
+    // Number of tasks removed so far, index of the next unvisited task
+    long removed = 0, read = 0;
+    for (int i = 0; i < count; ++i) {
+        // Turn 1-based positions into 0-based indices
+        long first = sorted[i].first - 1, last = sorted[i].last - 1;
+        // Skip what overlapping or duplicate ranges already removed
+        if (last < read) {
+            continue;
+        }
+        if (first < read) {
+            first = read;
+        }
+        // Close the gap up to the range, then swallow the range into it
+        move_gap(list, first - removed);
+        list->length -= last - first + 1;
+        removed += last - first + 1;
+        read = last + 1;
+    }
+    free(sorted);
+
+    return NULL;
+}
+
+const char *tasklist_move(TaskList list, long from_pos, long to_pos) {
+    /*
+     * Preparatory work with sanity checking
+     */
+    // Handle positions out of range
+    if (from_pos < 1 || from_pos > list->length ||
+        to_pos < 1 || to_pos > list->length) {
+        return error_message(ERROR_INVALID_POSITION);
+    }
+    // Abort when there's nothing to do
+    if (from_pos == to_pos) {
+        return NULL;
+    }
+    // Turn 1-based positions into 0-based indices
+    long from = from_pos - 1, to = to_pos - 1;
+    mark_dirty(list, from < to ? from : to);
+
+    record(list, "m %ld %ld\n", from_pos, to_pos);
+
+    /*
+     * Movement, by taking the task out at the gap and putting it back in at
+     * the destination, which only shifts the tasks in between
+     */
+    move_gap(list, from);
+    struct task task = list->tasks[list->gap + list->array_size - list->length];
+    --(list->length);
+    move_gap(list, to);
+    list->tasks[list->gap++] = task;
+    ++(list->length);
+
+    return NULL;
+}
+
+const char *tasklist_sort(TaskList list, int flags) {
+    close_gap(list);
+    record(list, "s %d\n", flags);
+    struct sort_string *strings = malloc(
+        (list->length ? list->length : 1) * sizeof(struct sort_string));
+    for (int i = 0; i < list->length; ++i) {
+        strings[i].text = list->tasks[i].text;
+        strings[i].length = list->tasks[i].length;
+    }
+    int *order = malloc((list->length ? list->length : 1) * sizeof(int));
+    sort_strings(strings, list->length, flags, order);
+    free(strings);
+
+    // Only the tasks from the first one that moved need to be written
+    int first = 0;
+    while (first < list->length && order[first] == first) {
+        ++first;
+    }
+    if (first < list->length) {
+        mark_dirty(list, first);
+        struct task *sorted = malloc(
+            (list->length - first) * sizeof(struct task));
+        for (int i = first; i < list->length; ++i) {
+            sorted[i - first] = list->tasks[order[i]];
+        }
+        memcpy(list->tasks + first, sorted,
+            (list->length - first) * sizeof(struct task));
+        free(sorted);
+    }
+    free(order);
+
+    return NULL;
+}
+
+/**
+ * Rewrites the file in place, starting at the first changed task.
+ *
+ * The unchanged prefix of the file is never touched.
+ *
+ * @param list The TaskList (gap closed)
+ * @return Error message or NULL on success
+ */
+static const char *write_suffix(TaskList list) {
+    /*
+     * Find where the first changed task starts in the file.
+     * Everything before that is left untouched.
+     */
+    off_t offset = 0;
+    for (int i = 0; i < list->dirty; ++i) {
+        offset += list->tasks[i].length + 1;
+    }
+    // Leave the file alone if nothing changed, but not if tasks were only
+    // removed from its end
+    if (list->dirty == list->length && offset == list->id.size) {
+        return NULL;
+    }
+
+    /*
+     * Serialize the changed tasks into a single buffer.
+     * This can't be written directly from the tasks, because unmodified ones
+     * point into the mapping of the same file we're about to overwrite.
+     */
+    size_t size = 0;
+    for (int i = list->dirty; i < list->length; ++i) {
+        size += list->tasks[i].length + 1;
+    }
+    char *buffer = arena_alloc(list, size);
+    char *out = buffer;
+    for (int i = list->dirty; i < list->length; ++i) {
+        memcpy(out, list->tasks[i].text, list->tasks[i].length);
+        out += list->tasks[i].length;
+        *out++ = '\n';
+    }
+
+    /*
+     * Point the changed tasks into the buffer, since the part of the mapping
+     * they came from is about to change. The others stay where they are.
+     */
+    out = buffer;
+    for (int i = list->dirty; i < list->length; ++i) {
+        list->tasks[i].text = out;
+        out += list->tasks[i].length + 1;
+    }
+
+    // Open file in write mode
+    int fd;
+    if ((fd = open(list->path, O_WRONLY)) == -1) {
+        return error_message(ERROR_OPEN_LIST);
+    }
+
+    // Write the changed tasks after the unchanged ones and cut off the rest
+    struct stat st;
+    if (pwrite_all(fd, buffer, size, offset) == -1 ||
+        ftruncate(fd, offset + size) == -1 || fstat(fd, &st) == -1) {
+        close(fd);
+        return error_message(ERROR_WRITE_LIST);
+    }
+    list->dirty = list->length;
+    file_id_from_stat(&list->id, &st);
+
+    // Close file
+    if (close(fd) == -1) {
+        return error_message(ERROR_CLOSE_LIST);
+    }
+
+    return NULL;
+}
+
+/**
+ * Writes the tasks to a file descriptor with as few writev calls as possible.
+ *
+ * Tasks that are adjacent in memory, like untouched lines in the mapping or
+ * tasks inserted together, are merged into a single vector element.
+ *
+ * @param list The TaskList (gap closed)
+ * @param fd The file descriptor
+ * @return 0 on success or -1 on error
+ */
+static int writev_tasks(TaskList list, int fd) {
+    // Keep the vector on the stack at a reasonable size
+    long iov_max = sysconf(_SC_IOV_MAX);
+    if (iov_max <= 0) {
+        iov_max = 16;
+    } else if (iov_max > 1024) {
+        iov_max = 1024;
+    }
+    struct iovec iov[iov_max];
+    const char *map_end = list->map + list->map_size;
+    int i = 0;
+    while (i < list->length) {
+        /*
+         * Gather as many tasks as fit into the vector
+         */
+        int count = 0;
+        size_t total = 0;
+        for ( ; i < list->length; ++i) {
+            const struct task *task = &list->tasks[i];
+            // Every task is followed by a newline, except a final mapped
+            // line without one, which needs a separate newline element
+            int has_newline = task->text + task->length != map_end;
+            int merge = count > 0 &&
+                (char *) iov[count - 1].iov_base + iov[count - 1].iov_len ==
+                task->text;
+            if (count + !merge + !has_newline > iov_max) {
+                break;
+            }
+            if (merge) {
+                iov[count - 1].iov_len += task->length + has_newline;
+            } else {
+                iov[count].iov_base = (char *) task->text;
+                iov[count++].iov_len = task->length + has_newline;
+            }
+            if (!has_newline) {
+                iov[count].iov_base = "\n";
+                iov[count++].iov_len = 1;
+            }
+            total += task->length + 1;
+        }
+
+        /*
+         * Write the vector, continuing where a partial write left off
+         */
+        struct iovec *next = iov;
+        while (total > 0) {
+            ssize_t written = writev(fd, next, count - (next - iov));
+            if (written == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return -1;
+            }
+            total -= written;
+            // Skip completely written elements and trim the partial one
+            while (written > 0 && (size_t) written >= next->iov_len) {
+                written -= next->iov_len;
+                ++next;
+            }
+            if (written > 0) {
+                next->iov_base = (char *) next->iov_base + written;
+                next->iov_len -= written;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Returns the permissions a file replacing the given one should have.
+ *
+ * Those are the permissions of the existing file, or the default ones
+ * derived from the umask if there is none.
+ *
+ * @param path Full path to the file
+ * @return The permission bits
+ */
+static mode_t file_mode(const char *path) {
+    struct stat st;
+    if (stat(path, &st) == 0) {
+        return st.st_mode & 07777;
+    }
+    mode_t mask = umask(0);
+    umask(mask);
+
+    return 0666 & ~mask;
+}
+
+/**
+ * Flushes the directory containing a file to disk.
+ *
+ * This makes a rename inside it durable.
+ *
+ * @param path Full path to the file
+ * @return 0 on success or -1 on error
+ */
+static int sync_parent(const char *path) {
+    const char *slash = strrchr(path, '/');
+    char *dir = slash ? strndup(path, slash - path + 1) : strdup(".");
+    int fd = open(dir, O_RDONLY);
+    free(dir);
+    if (fd == -1) {
+        return -1;
+    }
+    int result = fsync(fd);
+    close(fd);
+
+    return result;
+}
+
+/**
+ * Replaces the file with a temporary one holding all tasks.
+ *
+ * Since the old file stays intact until the rename, the tasks can be written
+ * straight out of the mapping without copying them first.
+ *
+ * @param list The TaskList (gap closed)
+ * @param policy What to flush to disk before returning
+ * @return Error message or NULL on success
+ */
+static const char *write_atomic(TaskList list, enum sync_policy policy) {
+    // Create the temporary file next to the list, on the same filesystem
+    char temp[strlen(list->path) + 8];
+    sprintf(temp, "%s.XXXXXX", list->path);
+    int fd;
+    if ((fd = mkstemp(temp)) == -1) {
+        return error_message(ERROR_OPEN_LIST);
+    }
+    // Write all tasks, flush them if requested and move the file into place
+    struct stat st;
+    if (fchmod(fd, file_mode(list->path)) == -1 ||
+        writev_tasks(list, fd) == -1 ||
+        (policy != SYNC_NONE && fsync(fd) == -1) || fstat(fd, &st) == -1) {
+        close(fd);
+        unlink(temp);
+        return error_message(ERROR_WRITE_LIST);
+    }
+    if (close(fd) == -1) {
+        unlink(temp);
+        return error_message(ERROR_CLOSE_LIST);
+    }
+    if (rename(temp, list->path) == -1) {
+        unlink(temp);
+        return error_message(ERROR_WRITE_LIST);
+    }
+    if (policy == SYNC_DIR && sync_parent(list->path) == -1) {
+        return error_message(ERROR_WRITE_LIST);
+    }
+    // The file now holds exactly our tasks, but elsewhere than the mapping
+    list->regular = 1;
+    list->dirty = list->length;
+    list->map_current = 0;
+    file_id_from_stat(&list->id, &st);
+
+    return NULL;
+}
+
+/**
+ * Fills in the header of a line index for the list file as last seen.
+ *
+ * @param list The TaskList
+ * @param header The header to fill in
+ * @param count Number of lines in the file
+ * @param last_newline Whether the final line ends with a newline
+ */
+static void index_header(
+    TaskList list, struct index_header *header, uint64_t count,
+    int last_newline) {
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, INDEX_MAGIC, sizeof(header->magic));
+    header->dev = list->id.dev;
+    header->ino = list->id.ino;
+    header->size = list->id.size;
+    header->mtime = list->id.mtime;
+    header->mtime_nsec = list->id.mtime_nsec;
+    header->count = count;
+    header->last_newline = last_newline;
+}
+
+/**
+ * Builds the tasks from the mapped file with the help of its line index.
+ *
+ * This only succeeds if the index belongs to the version of the file that
+ * was mapped, in which case the file's content isn't touched at all.
+ *
+ * @param list The TaskList (file mapped, no tasks yet)
+ * @return 0 on success, -1 if there is no valid index
+ */
+static int read_index(TaskList list) {
+    int fd;
+    if ((fd = open(list->index_path, O_RDONLY)) == -1) {
+        return -1;
+    }
+    // The whole index needs to be there and belong to the file
+    struct index_header expected, actual;
+    struct stat st;
+    if (pread(fd, &actual, sizeof(actual), 0) != sizeof(actual) ||
+        fstat(fd, &st) == -1) {
+        close(fd);
+        return -1;
+    }
+    index_header(list, &expected, actual.count, actual.last_newline);
+    if (memcmp(&expected, &actual, sizeof(expected)) != 0 ||
+        (uint64_t) st.st_size !=
+        sizeof(actual) + actual.count * sizeof(uint64_t)) {
+        close(fd);
+        return -1;
+    }
+    uint64_t *offsets = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (offsets == MAP_FAILED) {
+        return -1;
+    }
+
+    // Every line ends where the next one starts, minus the newline
+    const uint64_t *starts = (const uint64_t *) ((char *) offsets +
+        sizeof(actual));
+    int count = actual.count;
+    reserve(list, count);
+    for (int i = 0; i < count; ++i) {
+        uint64_t end = i + 1 < count ? starts[i + 1] - 1 :
+            list->map_size - actual.last_newline;
+        // Don't trust offsets that don't fit the file
+        if (starts[i] > end || end > list->map_size ||
+            (i > 0 && starts[i] <= starts[i - 1])) {
+            list->length = list->gap = 0;
+            munmap(offsets, st.st_size);
+            return -1;
+        }
+        list->tasks[i].text = list->map + starts[i];
+        list->tasks[i].length = end - starts[i];
+    }
+    list->length = list->gap = count;
+    munmap(offsets, st.st_size);
+
+    return 0;
+}
+
+/**
+ * Writes the line index for the freshly mapped and split file.
+ *
+ * It's written to a temporary file that is renamed into place, so readers
+ * never see a partial index. Failing to write it is not an error, it's
+ * just a cache.
+ *
+ * @param list The TaskList (gap closed, all tasks in the mapping)
+ * @param last_newline Whether the final line ends with a newline
+ */
+static void write_index(TaskList list, int last_newline) {
+    char temp[strlen(list->index_path) + 8];
+    sprintf(temp, "%s.XXXXXX", list->index_path);
+    int fd;
+    if ((fd = mkstemp(temp)) == -1) {
+        return;
+    }
+    struct index_header header;
+    index_header(list, &header, list->length, last_newline);
+    size_t size = list->length * sizeof(uint64_t);
+    uint64_t *offsets = malloc(size ? size : 1);
+    for (int i = 0; i < list->length; ++i) {
+        offsets[i] = list->tasks[i].text - list->map;
+    }
+    if (fchmod(fd, file_mode(list->path) & 0666) == -1 ||
+        write_all(fd, (char *) &header, sizeof(header)) == -1 ||
+        write_all(fd, (char *) offsets, size) == -1 ||
+        close(fd) == -1 || rename(temp, list->index_path) == -1) {
+        unlink(temp);
+    }
+    free(offsets);
+}
+
+/**
+ * Fills in the version of the list file and its journal in a word index
+ * header.
+ *
+ * @param list The TaskList
+ * @param header The header to fill in
+ * @return 0 on success or -1 if there is no list file
+ */
+static int words_version(TaskList list, struct words_header *header) {
+    struct stat st;
+    memset(header, 0, sizeof(*header));
+    if (stat(list->path, &st) == -1) {
+        return -1;
+    }
+    memcpy(header->magic, WORDS_MAGIC, sizeof(header->magic));
+    header->dev = st.st_dev;
+    header->ino = st.st_ino;
+    header->size = st.st_size;
+    header->mtime = st.st_mtim.tv_sec;
+    header->mtime_nsec = st.st_mtim.tv_nsec;
+    header->journal_size = stat(list->journal_path, &st) == 0 ?
+        st.st_size : -1;
+
+    return 0;
+}
+
+/**
+ * Builds the word table of the tasks.
+ *
+ * Because a new buffer needs to be allocated, the user must free it.
+ *
+ * @param list The TaskList (gap closed)
+ * @param size Set to the size of the table
+ * @return The table (freed by user)
+ */
+static char *build_words(TaskList list, size_t *size) {
+    WordsBuilder builder = words_builder_init();
+    for (int i = 0; i < list->length; ++i) {
+        words_builder_add(
+            builder, list->tasks[i].text, list->tasks[i].length, i + 1);
+    }
+
+    return words_builder_finish(builder, size);
+}
+
+/**
+ * Returns the offsets of the tasks in the list file, for the word index.
+ *
+ * Because a new array needs to be allocated, the user must free it.
+ *
+ * @param list The TaskList (gap closed, tasks read or written just now)
+ * @return One offset more than there are tasks (freed by user), or NULL if
+ *         the file doesn't hold exactly the tasks because of a journal
+ */
+static uint64_t *task_offsets(TaskList list) {
+    if (list->journal_size != -1) {
+        return NULL;
+    }
+    // The file is the tasks, each followed by a newline
+    uint64_t *offsets = malloc((list->length + 1) * sizeof(uint64_t));
+    offsets[0] = 0;
+    for (int i = 0; i < list->length; ++i) {
+        offsets[i + 1] = offsets[i] + list->tasks[i].length + 1;
+    }
+
+    return offsets;
+}
+
+/**
+ * Writes the word index for the list file as it is now.
+ *
+ * Like the line index, it's renamed into place and failing to write it is
+ * not an error.
+ *
+ * @param list The TaskList
+ * @param offsets Offsets of the tasks in the list file (count + 1 of them),
+ *                or NULL if they aren't known
+ * @param count Number of tasks
+ * @param table The word table of the tasks
+ * @param size Size of the table
+ */
+static void write_words(
+    TaskList list, const uint64_t *offsets, uint64_t count,
+    const char *table, size_t size) {
+    struct words_header header;
+    if (words_version(list, &header) == -1) {
+        return;
+    }
+    header.count = count;
+    header.offsets = offsets != NULL;
+    size_t offsets_size = offsets ? (count + 1) * sizeof(uint64_t) : 0;
+
+    char temp[strlen(list->words_path) + 8];
+    sprintf(temp, "%s.XXXXXX", list->words_path);
+    int fd;
+    if ((fd = mkstemp(temp)) == -1) {
+        return;
+    }
+    if (fchmod(fd, file_mode(list->path) & 0666) == -1 ||
+        write_all(fd, (char *) &header, sizeof(header)) == -1 ||
+        write_all(fd, (const char *) offsets, offsets_size) == -1 ||
+        write_all(fd, table, size) == -1 ||
+        close(fd) == -1 || rename(temp, list->words_path) == -1) {
+        unlink(temp);
+    }
+}
+
+/**
+ * Maps the word index, if it belongs to the current list file and journal.
+ *
+ * @param list The TaskList
+ * @param header Set to the header of the index
+ * @param size Set to the size of the mapping
+ * @return The mapping of the whole index or NULL if there is no valid one
+ */
+static char *map_words(
+    TaskList list, struct words_header *header, size_t *size) {
+    int fd;
+    if ((fd = open(list->words_path, O_RDONLY)) == -1) {
+        return NULL;
+    }
+    struct words_header expected;
+    struct stat st;
+    if (pread(fd, header, sizeof(*header), 0) != sizeof(*header) ||
+        fstat(fd, &st) == -1 || words_version(list, &expected) == -1) {
+        close(fd);
+        return NULL;
+    }
+    expected.count = header->count;
+    expected.offsets = header->offsets;
+    if (memcmp(&expected, header, sizeof(expected)) != 0 ||
+        header->offsets > 1 || header->count > INT_MAX ||
+        (uint64_t) st.st_size < sizeof(*header) +
+        (header->offsets ? (header->count + 1) * sizeof(uint64_t) : 0)) {
+        close(fd);
+        return NULL;
+    }
+    char *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+    *size = st.st_size;
+
+    return map;
+}
+
+/**
+ * Checks whether a word index describes the mapping tasks point into.
+ *
+ * @param list The TaskList
+ * @param header Header of the word index
+ * @return 1 if it does, 0 otherwise
+ */
+static int words_describe_map(
+    TaskList list, const struct words_header *header) {
+    return header->offsets && list->map && list->map_current &&
+        header->dev == (uint64_t) list->id.dev &&
+        header->ino == (uint64_t) list->id.ino &&
+        header->size == list->id.size && header->mtime == list->id.mtime &&
+        header->mtime_nsec == list->id.mtime_nsec;
+}
+
+/**
+ * Builds the word table of the tasks from the word index of the mapping
+ * they point into, so only tasks that were added need to be split into
+ * words.
+ *
+ * @param list The TaskList (gap closed)
+ * @param header Header of the word index, see words_describe_map()
+ * @param words Mapping of the word index
+ * @param words_size Size of the mapping
+ * @param size Set to the size of the table
+ * @return The table (freed by user) or NULL if the index is corrupt
+ */
+static char *update_words(
+    TaskList list, const struct words_header *header, const char *words,
+    size_t words_size, size_t *size) {
+    const uint64_t *offsets = (const uint64_t *) (words + sizeof(*header));
+    size_t table_offset = sizeof(*header) +
+        (header->count + 1) * sizeof(uint64_t);
+    uint64_t count = header->count;
+
+    // Find where every task that is still in the mapping used to be
+    uint32_t *positions = calloc(count ? count : 1, sizeof(uint32_t));
+    WordsBuilder builder = words_builder_init();
+    for (int i = 0; i < list->length; ++i) {
+        const struct task *task = &list->tasks[i];
+        uint64_t low = 0, high = count;
+        if (task->text >= list->map &&
+            task->text < list->map + list->map_size) {
+            // Binary search for the task's offset
+            uint64_t offset = task->text - list->map;
+            while (low < high) {
+                uint64_t middle = low + (high - low) / 2;
+                if (offsets[middle] < offset) {
+                    low = middle + 1;
+                } else {
+                    high = middle;
+                }
+            }
+        } else {
+            low = count;
+        }
+        if (low < count && offsets[low] == (uint64_t) (
+            task->text - list->map) && positions[low] == 0 &&
+            offsets[low + 1] - offsets[low] - 1 == task->length) {
+            positions[low] = i + 1;
+        } else {
+            words_builder_add(builder, task->text, task->length, i + 1);
+        }
+    }
+    char *table = words_update(
+        words + table_offset, words_size - table_offset, positions, count,
+        builder, size);
+    free(positions);
+
+    return table;
+}
+
+/**
+ * Formats tasks found through the word index, taking their text straight
+ * from the list file.
+ *
+ * @param output The output buffer
+ * @param end End of the formatted data so far
+ * @param list The TaskList
+ * @param header Header of the word index
+ * @param offsets Offsets of the tasks in the list file, from the index
+ * @param positions Positions of the tasks, in order
+ * @param count Number of positions
+ * @return End of the formatted data or NULL if the file doesn't fit the
+ *         index
+ */
+static char *put_indexed(
+    struct output *output, char *end, TaskList list,
+    const struct words_header *header, const uint64_t *offsets,
+    const uint32_t *positions, long count) {
+    int fd;
+    if (header->size == 0 || (fd = open(list->path, O_RDONLY)) == -1) {
+        return NULL;
+    }
+    char *map = mmap(NULL, header->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+    for (long i = 0; i < count; ++i) {
+        uint32_t position = positions[i];
+        // Don't trust offsets that don't fit the file
+        if (position == 0 || position > header->count ||
+            offsets[position - 1] >= offsets[position] ||
+            offsets[position] - 1 > (uint64_t) header->size) {
+            munmap(map, header->size);
+            return NULL;
+        }
+        end = put_match(
+            output, end, list, position, map + offsets[position - 1],
+            offsets[position] - 1 - offsets[position - 1]);
+    }
+    munmap(map, header->size);
+
+    return end;
+}
+
+/**
+ * Builds the tasks from the list file alone, without its journal.
+ *
+ * @param list The TaskList
+ * @return Error message or NULL on success
+ */
+static const char *read_file(TaskList list) {
+    // Open file in read mode
+    int fd;
+    if ((fd = open(list->path, O_RDONLY)) == -1) {
+        return error_message(ERROR_OPEN_LIST);
+    }
+
+    // Only non-empty regular files can be mapped
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        return read_stream(list, fd);
+    }
+    list->regular = S_ISREG(st.st_mode);
+    file_id_from_stat(&list->id, &st);
+    if (!list->regular || st.st_size == 0) {
+        return read_stream(list, fd);
+    }
+    char *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        return read_stream(list, fd);
+    }
+    // The mapping stays valid after closing the descriptor
+    if (close(fd) == -1) {
+        munmap(map, st.st_size);
+        return error_message(ERROR_CLOSE_LIST);
+    }
+    list->map = map;
+    list->map_size = st.st_size;
+    list->map_current = 1;
+    const char *end = map + st.st_size;
+    int last_newline = end[-1] == '\n';
+
+    // With a valid line index, the file doesn't need to be scanned
+    if (!list->indexing || read_index(list) == -1) {
+        // We're going to scan it front to back exactly once
+        posix_madvise(map, st.st_size, POSIX_MADV_SEQUENTIAL);
+
+        // Point tasks directly into the mapping, one per line
+        const char *line = map;
+        while (line < end) {
+            const char *newline = memchr(line, '\n', end - line);
+            // The final line may lack its newline
+            const char *line_end = newline ? newline : end;
+            append_task(list, line, line_end - line);
+            line = line_end + 1;
+        }
+        // Build the index for next time
+        if (list->indexing) {
+            write_index(list, last_newline);
+        }
+    }
+    // The file matches the tasks, except for a final line without newline
+    list->dirty = list->length;
+    if (!last_newline) {
+        mark_dirty(list, list->length - 1);
+    }
+
+    return NULL;
+}
+
+/**
+ * Applies a single journal record to the list.
+ *
+ * @param list The TaskList
+ * @param line The record (terminated, without newline)
+ * @return Error message or NULL on success
+ */
+static const char *replay_record(TaskList list, char *line) {
+    char *endptr, *next;
+    switch (line[0]) {
+        case 'a':
+            if (line[1] != ' ') {
+                break;
+            }
+            return tasklist_insert(list, list->length + 1, line + 2);
+        case 'i': {
+            long position = strtol(line + 1, &endptr, 10);
+            if (endptr == line + 1 || *endptr != ' ') {
+                break;
+            }
+            return tasklist_insert(list, position, endptr + 1);
+        }
+        case 'd': {
+            // There's a space in front of every range
+            int count = 0;
+            for (char *c = line; *c; ++c) {
+                count += *c == ' ';
+            }
+            struct tasklist_range ranges[count + 1];
+            next = line + 1;
+            for (int i = 0; i < count; ++i) {
+                ranges[i].first = strtol(next, &endptr, 10);
+                if (endptr == next || *endptr != '-') {
+                    return error_message(ERROR_CORRUPT_JOURNAL);
+                }
+                next = endptr + 1;
+                ranges[i].last = strtol(next, &endptr, 10);
+                if (endptr == next) {
+                    return error_message(ERROR_CORRUPT_JOURNAL);
+                }
+                next = endptr;
+            }
+            if (*next != '\0') {
+                break;
+            }
+            ranges[count].first = ranges[count].last = -1;
+            return tasklist_done_ranges(list, ranges);
+        }
+        case 'm': {
+            long from = strtol(line + 1, &endptr, 10);
+            if (endptr == line + 1) {
+                break;
+            }
+            next = endptr;
+            long to = strtol(next, &endptr, 10);
+            if (endptr == next || *endptr != '\0') {
+                break;
+            }
+            return tasklist_move(list, from, to);
+        }
+        case 's': {
+            long flags = strtol(line + 1, &endptr, 10);
+            if (endptr == line + 1 || *endptr != '\0' || flags < 0 ||
+                flags > (SORT_IGNORE_CASE | SORT_NATURAL | SORT_REVERSE)) {
+                break;
+            }
+            return tasklist_sort(list, flags);
+        }
+    }
+
+    return error_message(ERROR_CORRUPT_JOURNAL);
+}
+
+/**
+ * Checks whether the journal on disk belongs to the list file as last seen.
+ *
+ * Sets the list's journal size, or marks the journal as stale if there is
+ * one that belongs to another version of the file.
+ *
+ * @param list The TaskList
+ * @param fd File descriptor of the journal, open for reading
+ * @return Length of the header if it belongs to the file, 0 otherwise
+ */
+static int check_journal(TaskList list, int fd) {
+    list->journal_size = -1;
+    list->journal_stale = 1;
+    char expected[JOURNAL_HEADER_SIZE], actual[JOURNAL_HEADER_SIZE];
+    int length = journal_header(expected, &list->id);
+    struct stat st;
+    if (fstat(fd, &st) == -1 || pread(fd, actual, length, 0) != length ||
+        memcmp(expected, actual, length) != 0) {
+        return 0;
+    }
+    list->journal_size = st.st_size;
+    list->journal_stale = 0;
+
+    return length;
+}
+
+/**
+ * Replays the journal belonging to the list file over the tasks.
+ *
+ * A journal for another version of the file is ignored, as is an incomplete
+ * final record left behind by an interrupted write.
+ *
+ * @param list The TaskList
+ * @return Error message or NULL on success
+ */
+static const char *read_journal(TaskList list) {
+    int fd;
+    if ((fd = open(list->journal_path, O_RDONLY)) == -1) {
+        return errno == ENOENT ? NULL : error_message(ERROR_OPEN_JOURNAL);
+    }
+    int header_length = check_journal(list, fd);
+    if (header_length == 0) {
+        close(fd);
+        return NULL;
+    }
+
+    // Read the records into a terminated buffer
+    size_t size = list->journal_size - header_length;
+    char *buffer = malloc(size + 1);
+    size_t length = 0;
+    while (length < size) {
+        ssize_t got = pread(
+            fd, buffer + length, size - length, header_length + length);
+        if (got <= 0) {
+            break;
+        }
+        length += got;
+    }
+    buffer[length] = '\0';
+    if (close(fd) == -1) {
+        free(buffer);
+        return error_message(ERROR_CLOSE_JOURNAL);
+    }
+
+    // Replay the complete records, without recording them again
+    const char *error = NULL;
+    int journaling = list->journaling;
+    list->journaling = 0;
+    char *line = buffer, *end = buffer + length;
+    while (line < end && !error) {
+        char *newline = memchr(line, '\n', end - line);
+        if (newline == NULL) {
+            break;
+        }
+        *newline = '\0';
+        if (replay_record(list, line)) {
+            error = error_message(ERROR_CORRUPT_JOURNAL);
+        }
+        line = newline + 1;
+    }
+    list->journaling = journaling;
+    free(buffer);
+
+    return error;
+}
+
+/**
+ * Deletes the journal, once the list file holds everything.
+ *
+ * @param list The TaskList
+ * @return Error message or NULL on success
+ */
+static const char *remove_journal(TaskList list) {
+    list->records_length = 0;
+    if (list->journal_size == -1 && !list->journal_stale) {
+        return NULL;
+    }
+    if (unlink(list->journal_path) == -1 && errno != ENOENT) {
+        return error_message(ERROR_DELETE_JOURNAL);
+    }
+    list->journal_size = -1;
+    list->journal_stale = 0;
+
+    return NULL;
+}
+
+/**
+ * Appends the pending records to the journal.
+ *
+ * Once the journal grows past JOURNAL_LIMIT, it's folded into the list file
+ * instead, which keeps the replay cost for readers bounded.
+ *
+ * @param list The TaskList (gap closed)
+ * @param policy What to flush to disk before returning
+ * @return Error message or NULL on success
+ */
+static const char *write_journal(TaskList list, enum sync_policy policy) {
+    if (list->records_length == 0) {
+        return NULL;
+    }
+    // A new journal starts with the header naming the file version
+    int created = list->journal_size == -1;
+    char header[JOURNAL_HEADER_SIZE];
+    int header_length = created ? journal_header(header, &list->id) : 0;
+    off_t size = (created ? 0 : list->journal_size) + header_length +
+        list->records_length;
+    if (size > JOURNAL_LIMIT) {
+        const char *error = write_atomic(list, policy);
+        return error ? error : remove_journal(list);
+    }
+
+    // Append the records, replacing a stale journal
+    int fd;
+    int flags = O_WRONLY | O_APPEND | O_CREAT | (created ? O_TRUNC : 0);
+    if ((fd = open(list->journal_path, flags, 0666)) == -1) {
+        return error_message(ERROR_OPEN_JOURNAL);
+    }
+    if (write_all(fd, header, header_length) == -1 ||
+        write_all(fd, list->records, list->records_length) == -1 ||
+        (policy != SYNC_NONE && fsync(fd) == -1)) {
+        close(fd);
+        return error_message(ERROR_WRITE_JOURNAL);
+    }
+    if (close(fd) == -1) {
+        return error_message(ERROR_CLOSE_JOURNAL);
+    }
+    if (created && policy == SYNC_DIR &&
+        sync_parent(list->journal_path) == -1) {
+        return error_message(ERROR_WRITE_JOURNAL);
+    }
+    list->journal_size = size;
+    list->journal_stale = 0;
+    list->records_length = 0;
+
+    return NULL;
+}
+
+/**
+ * Reads the TASUKE_SYNC environment variable.
+ *
+ * @param policy The policy to fill in
+ * @return Error message or NULL on success
+ */
+static const char *get_sync_policy(enum sync_policy *policy) {
+    const char *sync = getenv("TASUKE_SYNC");
+    if (sync == NULL || strcmp(sync, "none") == 0) {
+        *policy = SYNC_NONE;
+    } else if (strcmp(sync, "file") == 0) {
+        *policy = SYNC_FILE;
+    } else if (strcmp(sync, "dir") == 0) {
+        *policy = SYNC_DIR;
+    } else {
+        return error_message(ERROR_SYNC);
+    }
+
+    return NULL;
+}
+
+/**
+ * Reads the TASUKE_LOCK_TIMEOUT environment variable.
+ *
+ * @param timeout Set to the number of seconds to wait for a lock, or to a
+ *                negative number to wait as long as it takes
+ * @return Error message or NULL on success
+ */
+static const char *get_lock_timeout(double *timeout) {
+    const char *value = getenv("TASUKE_LOCK_TIMEOUT");
+    if (value == NULL || *value == '\0') {
+        *timeout = -1;
+        return NULL;
+    }
+    errno = 0;
+    char *endptr;
+    *timeout = strtod(value, &endptr);
+    if (errno || *endptr != '\0' || *timeout < 0) {
+        return error_message(ERROR_LOCK_TIMEOUT);
+    }
+
+    return NULL;
+}
+
+/**
+ * Returns the number of seconds passed since a point in time.
+ *
+ * @param start The point in time, as taken from the monotonic clock
+ * @return Seconds passed
+ */
+static double seconds_since(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) +
+        (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/**
+ * Opens the lock file, creating it if necessary.
+ *
+ * Nobody can modify a list that doesn't exist without creating its lock
+ * file, so readers of such a list don't need to leave one behind. Neither
+ * can anybody modify a list in a directory readers can't write to.
+ *
+ * @param list The TaskList
+ * @param exclusive Whether the lock is going to be exclusive
+ * @return The descriptor, -1 on error or -2 if no lock is needed
+ */
+static int open_lock(TaskList list, int exclusive) {
+    int fd;
+    if ((fd = open(list->lock_path, O_RDWR)) == -1 && errno == ENOENT &&
+        (exclusive || access(list->path, F_OK) == 0)) {
+        fd = open(list->lock_path, O_RDWR | O_CREAT, 0666);
+    }
+    if (fd == -1 && !exclusive &&
+        (errno == ENOENT || errno == EACCES || errno == EROFS)) {
+        return -2;
+    }
+
+    return fd;
+}
+
+/**
+ * Checks whether the locked file is still the lock file of the list.
+ *
+ * The lock file is deleted along with the list, which leaves anyone who was
+ * waiting for it with a lock on a file that no longer counts.
+ *
+ * @param list The TaskList
+ * @return 1 if the lock is on the current lock file, 0 otherwise
+ */
+static int lock_current(TaskList list) {
+    struct stat held, current;
+
+    return fstat(list->lock_fd, &held) == 0 &&
+        stat(list->lock_path, &current) == 0 &&
+        held.st_dev == current.st_dev && held.st_ino == current.st_ino;
+}
+
+/**
+ * Takes a lock on the list, see tasklist_lock().
+ *
+ * @param list The TaskList
+ * @param exclusive Whether to lock it exclusively (0 = false, 1 = true)
+ * @return Error message or NULL on success
+ */
+static const char *take_lock(TaskList list, int exclusive) {
+    int type = exclusive ? F_WRLCK : F_RDLCK;
+    if (list->lock_type == type || list->lock_type == F_WRLCK) {
+        return NULL;
+    }
+    double timeout;
+    const char *error = get_lock_timeout(&timeout);
+    if (error) {
+        return error;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    struct timespec delay = {0, LOCK_DELAY_MIN};
+    int contended = 0;
+    while (1) {
+        if (list->lock_fd == -1) {
+            int fd = open_lock(list, exclusive);
+            if (fd == -2) {
+                return NULL;
+            }
+            if (fd == -1) {
+                return error_message(ERROR_LOCK);
+            }
+            list->lock_fd = fd;
+        }
+        // Without a timeout, simply wait until the lock is granted
+        struct flock lock = {0};
+        lock.l_type = type;
+        lock.l_whence = SEEK_SET;
+        if (fcntl(list->lock_fd, timeout < 0 ? F_SETLKW : F_SETLK, &lock) ==
+            0) {
+            if (lock_current(list)) {
+                break;
+            }
+            // Start over with the new lock file
+            close(list->lock_fd);
+            list->lock_fd = -1;
+            list->lock_type = -1;
+            continue;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EACCES && errno != EAGAIN) {
+            return error_message(ERROR_LOCK);
+        }
+        // Somebody else has it, try again a little later
+        contended = 1;
+        if (seconds_since(&start) >= timeout) {
+            return error_message(ERROR_TIMED_OUT);
+        }
+        nanosleep(&delay, NULL);
+        delay.tv_nsec = delay.tv_nsec * 2 > LOCK_DELAY_MAX ?
+            LOCK_DELAY_MAX : delay.tv_nsec * 2;
+    }
+    list->lock_type = type;
+
+    // Tell how long we had to wait, if asked to
+    double waited = seconds_since(&start);
+    if (env_enabled("TASUKE_LOCK_REPORT") && (contended || waited >= 0.001)) {
+        fprintf(stderr, "Waited %.3fs for %s lock on %s\n", waited,
+            exclusive ? "exclusive" : "shared", list->name);
+    }
+
+    return NULL;
+}
+
+const char *tasklist_lock(TaskList list, int exclusive) {
+    struct trace_mark mark;
+    trace_begin(&mark);
+    const char *error = take_lock(list, exclusive);
+    trace_end(TRACE_LOCK, &mark);
+
+    return error;
+}
+
+void tasklist_unlock(TaskList list) {
+    if (list->lock_fd == -1) {
+        return;
+    }
+    // Don't leave a lock file behind for a list that doesn't exist (anymore)
+    if (list->lock_type == F_WRLCK && access(list->path, F_OK) == -1 &&
+        errno == ENOENT) {
+        unlink(list->lock_path);
+    }
+    // Closing the descriptor releases the lock
+    close(list->lock_fd);
+    list->lock_fd = -1;
+    list->lock_type = -1;
+}
+
+const char *tasklist_read(TaskList list) {
+    struct trace_mark mark;
+    trace_begin(&mark);
+    const char *error = read_file(list);
+    if (!error) {
+        error = read_journal(list);
+    }
+    trace_end(TRACE_READ, &mark);
+
+    return error;
+}
+
+/**
+ * Reads a range of tasks from file, see tasklist_read_range().
+ *
+ * @param list The TaskList
+ * @param first Position of the first task to keep
+ * @param last Position of the last task to keep
+ * @return Error message or NULL on success
+ */
+static const char *read_range(TaskList list, long first, long last) {
+    list->partial = 1;
+    // Only a regular file without a journal holds exactly the tasks, in a
+    // form that can be skipped through. Anything else is read as a whole.
+    int fd;
+    struct stat st;
+    char *map = MAP_FAILED;
+    if (access(list->journal_path, F_OK) == -1 && errno == ENOENT &&
+        (fd = open(list->path, O_RDONLY)) != -1) {
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+            map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+    }
+    if (map == MAP_FAILED) {
+        const char *error = read_file(list);
+        if (!error) {
+            error = read_journal(list);
+        }
+        if (!error) {
+            keep_range(list, first, last);
+        }
+        return error;
+    }
+    list->regular = 1;
+    file_id_from_stat(&list->id, &st);
+    list->map = map;
+    list->map_size = st.st_size;
+    list->map_current = 1;
+    const char *end = map + st.st_size;
+    posix_madvise(map, st.st_size, POSIX_MADV_SEQUENTIAL);
+
+    // Positions counting back from the end take knowing where that is
+    resolve_range(
+        first < 0 || last < 0 ? count_lines(map, end) : LONG_MAX,
+        &first, &last);
+
+    // Skip the lines before the range, then stop right after it
+    const char *line = map;
+    long position = 1;
+    for ( ; position < first && line < end; ++position) {
+        const char *newline = memchr(line, '\n', end - line);
+        line = newline ? newline + 1 : end;
+    }
+    list->offset = position - 1;
+    for ( ; position <= last && line < end; ++position) {
+        const char *newline = memchr(line, '\n', end - line);
+        const char *line_end = newline ? newline : end;
+        append_task(list, line, line_end - line);
+        line = line_end + 1;
+    }
+
+    return NULL;
+}
+
+const char *tasklist_read_range(TaskList list, long first, long last) {
+    struct trace_mark mark;
+    trace_begin(&mark);
+    const char *error = read_range(list, first, last);
+    trace_end(TRACE_READ, &mark);
+
+    return error;
+}
+
+/**
+ * Writes the list to file, see tasklist_write().
+ *
+ * @param list The TaskList
+ * @return Error message or NULL on success
+ */
+static const char *write_list(TaskList list) {
+    if (list->partial) {
+        return error_message(ERROR_WRITE_PART);
+    }
+    close_gap(list);
+
+    // Determine how much durability is wanted
+    enum sync_policy policy;
+    const char *error = get_sync_policy(&policy);
+    if (error) {
+        return error;
+    }
+
+    // The word index of the file as read only needs to be updated, which
+    // has to happen while the tasks still point where they were read from
+    int wording = list->regular && access(list->words_path, F_OK) == 0;
+    char *table = NULL;
+    size_t size;
+    struct words_header header;
+    size_t words_size;
+    char *words = wording && list->map_current ?
+        map_words(list, &header, &words_size) : NULL;
+    if (words) {
+        if (words_describe_map(list, &header)) {
+            table = update_words(list, &header, words, words_size, &size);
+        }
+        munmap(words, words_size);
+    }
+
+    // Journaled lists only record what happened
+    if (list->journaling && list->regular) {
+        error = write_journal(list, policy);
+    } else {
+        // Replace the whole file, so a crash can't leave it half done and
+        // readers keep the version they mapped. Only when asked to, and
+        // durability isn't wanted, rewrite what changed in place. A journal
+        // can't be folded in place, since it belongs to the old file.
+        if (list->in_place && policy == SYNC_NONE && list->regular &&
+            list->dirty > 0 && list->journal_size == -1) {
+            error = write_suffix(list);
+        } else {
+            error = write_atomic(list, policy);
+        }
+        if (!error) {
+            error = remove_journal(list);
+        }
+    }
+
+    // Keep the word index up to date, once somebody has asked for one
+    if (!error && wording) {
+        if (table == NULL) {
+            table = build_words(list, &size);
+        }
+        uint64_t *offsets = task_offsets(list);
+        write_words(list, offsets, list->length, table, size);
+        free(offsets);
+    }
+    free(table);
+    if (!error) {
+        catalog_update(list->path, list->length);
+    }
+
+    return error;
+}
+
+const char *tasklist_write(TaskList list) {
+    struct trace_mark mark;
+    trace_begin(&mark);
+    const char *error = write_list(list);
+    trace_end(TRACE_WRITE, &mark);
+
+    return error;
+}
+
+int tasklist_changed(TaskList list) {
+    struct stat st;
+    struct file_id id;
+    if (stat(list->path, &st) == -1) {
+        return 1;
+    }
+    file_id_from_stat(&id, &st);
+    if (id.dev != list->id.dev || id.ino != list->id.ino ||
+        id.size != list->id.size || id.mtime != list->id.mtime ||
+        id.mtime_nsec != list->id.mtime_nsec) {
+        return 1;
+    }
+
+    // A stale journal is ignored, but a valid one may have grown or gone
+    if (list->journal_stale) {
+        return 0;
+    }
+    off_t journal_size = stat(list->journal_path, &st) == 0 ? st.st_size : -1;
+
+    return journal_size != list->journal_size;
+}
+
+const char *tasklist_lookup(
+    TaskList list, const char *word, int prefix, enum format format,
+    char **result, size_t *size) {
+    struct output output;
+    output.size = 4096;
+    output.data = malloc(output.size);
+    output.length = 0;
+    output.format = format;
+    char *end = output.data;
+    *result = NULL;
+    *size = 0;
+    size_t length = strlen(word);
+    uint32_t *positions = NULL;
+    long count = -1;
+    int done = 0;
+
+    /*
+     * Unless the list was read already, try its word index first
+     */
+    int unread = list->map == NULL && list->length == 0;
+    struct words_header header;
+    size_t words_size;
+    char *words = unread ? map_words(list, &header, &words_size) : NULL;
+    if (words) {
+        size_t offsets_size = header.offsets ?
+            (header.count + 1) * sizeof(uint64_t) : 0;
+        size_t table_offset = sizeof(header) + offsets_size;
+        count = words_lookup(
+            words + table_offset, words_size - table_offset, word, length,
+            prefix, &positions);
+        if (count == 0) {
+            done = 1;
+        } else if (count > 0 && header.offsets) {
+            // Without a journal, the tasks don't need to be read at all
+            char *indexed_end = put_indexed(
+                &output, end, list, &header,
+                (const uint64_t *) (words + sizeof(header)), positions,
+                count);
+            if (indexed_end) {
+                end = indexed_end;
+                done = 1;
+            } else {
+                // Start over with the tasks
+                end = output.data;
+                count = -1;
+            }
+        }
+        munmap(words, words_size);
+    }
+
+    /*
+     * Otherwise take the tasks from the list, building its index if needed
+     */
+    if (!done) {
+        const char *error = unread ? tasklist_read(list) : NULL;
+        if (error) {
+            free(positions);
+            free(output.data);
+            return error;
+        }
+        close_gap(list);
+        if (count != -1 && (uint64_t) list->length != header.count) {
+            count = -1;
+        }
+        if (count == -1) {
+            free(positions);
+            size_t table_size;
+            char *table = build_words(list, &table_size);
+            // Only what was just read is what the file holds
+            if (unread && list->regular) {
+                uint64_t *offsets = task_offsets(list);
+                write_words(list, offsets, list->length, table, table_size);
+                free(offsets);
+            }
+            count = words_lookup(
+                table, table_size, word, length, prefix, &positions);
+            free(table);
+        }
+        for (long i = 0; i < count; ++i) {
+            if (positions[i] > 0 && positions[i] <= (uint32_t) list->length) {
+                const struct task *task = &list->tasks[positions[i] - 1];
+                end = put_match(
+                    &output, end, list, positions[i], task->text,
+                    task->length);
+            }
+        }
+    }
+    free(positions);
+    *result = output.data;
+    *size = end - output.data;
+
+    return NULL;
+}
+
+/**
+ * Appends tasks to the list file.
+ *
+ * The tasks are copied into a single buffer, which is written at once.
+ *
+ * @param list The TaskList
+ * @param tasks Array of tasks, terminated by a NULL element
+ * @param policy What to flush to disk before returning
+ * @return Error message or NULL on success
+ */
+static const char *append_file(
+    TaskList list, char **tasks, enum sync_policy policy) {
+    int fd;
+    if ((fd = open(list->path, O_WRONLY | O_APPEND | O_CREAT, 0666)) == -1) {
+        return error_message(ERROR_OPEN_LIST);
+    }
+
+    // Lay out all tasks with their newlines
+    size_t size = 0;
+    for (char **task = tasks; *task; ++task) {
+        size += strlen(*task) + 1;
+    }
+    char *buffer = malloc(size ? size : 1), *end = buffer;
+    for ( ; *tasks; ++tasks) {
+        end = stpcpy(end, *tasks);
+        *end++ = '\n';
+    }
+
+    // Write and flush them if requested, then close file
+    int result = write_all(fd, buffer, size);
+    free(buffer);
+    if (result == -1 || (policy != SYNC_NONE && fsync(fd) == -1)) {
+        close(fd);
+        return error_message(ERROR_WRITE_LIST);
+    }
+    if (close(fd) == -1) {
+        return error_message(ERROR_CLOSE_LIST);
+    }
+
+    return NULL;
+}
+
+/**
+ * Adds tasks appended to the list file or its journal to its word index.
+ *
+ * @param list The TaskList
+ * @param header Header of the word index before appending
+ * @param words Mapping of the word index
+ * @param words_size Size of the mapping
+ * @param tasks The appended tasks, terminated by a NULL element
+ */
+static void append_words(
+    TaskList list, const struct words_header *header, const char *words,
+    size_t words_size, char **tasks) {
+    // Tasks recorded in a journal always come after the others. Appended to
+    // the file, they only start on lines of their own if it ended with a
+    // newline.
+    const uint64_t *old_offsets = header->offsets ?
+        (const uint64_t *) (words + sizeof(*header)) : NULL;
+    uint64_t count = header->count, added = 0;
+    if (old_offsets ? old_offsets[count] != (uint64_t) header->size :
+        header->journal_size == -1) {
+        return;
+    }
+    while (tasks[added]) {
+        ++added;
+    }
+
+    // Everything that was there stays where it was
+    uint32_t *positions = malloc((count ? count : 1) * sizeof(uint32_t));
+    for (uint64_t i = 0; i < count; ++i) {
+        positions[i] = i + 1;
+    }
+    uint64_t *offsets = NULL;
+    if (old_offsets) {
+        offsets = malloc((count + added + 1) * sizeof(uint64_t));
+        memcpy(offsets, old_offsets, (count + 1) * sizeof(uint64_t));
+    }
+    WordsBuilder builder = words_builder_init();
+    for (uint64_t i = 0; i < added; ++i) {
+        size_t length = strlen(tasks[i]);
+        words_builder_add(builder, tasks[i], length, count + i + 1);
+        if (offsets) {
+            offsets[count + i + 1] = offsets[count + i] + length + 1;
+        }
+    }
+    size_t table_offset = sizeof(*header) +
+        (old_offsets ? (count + 1) * sizeof(uint64_t) : 0);
+    size_t size;
+    char *table = words_update(
+        words + table_offset, words_size - table_offset, positions, count,
+        builder, &size);
+    if (table) {
+        write_words(list, offsets, count + added, table, size);
+        free(table);
+    }
+    free(positions);
+    free(offsets);
+}
+
+/**
+ * Records tasks appended to a list in its journal.
+ *
+ * @param list The TaskList
+ * @param tasks The tasks, terminated by a NULL element
+ * @param policy How much durability is wanted
+ * @return Error message or NULL on success
+ */
+static const char *append_journal(
+    TaskList list, char **tasks, enum sync_policy policy) {
+    // Record the tasks, even if this list isn't journaling itself
+    int journaling = list->journaling;
+    list->journaling = 1;
+    for ( ; *tasks; ++tasks) {
+        record(list, "a %s\n", *tasks);
+    }
+    list->journaling = journaling;
+    int fd;
+    if ((fd = open(list->journal_path, O_WRONLY | O_APPEND)) == -1) {
+        return error_message(ERROR_OPEN_JOURNAL);
+    }
+    if (write_all(fd, list->records, list->records_length) == -1 ||
+        (policy != SYNC_NONE && fsync(fd) == -1)) {
+        close(fd);
+        return error_message(ERROR_WRITE_JOURNAL);
+    }
+    list->records_length = 0;
+    if (close(fd) == -1) {
+        return error_message(ERROR_CLOSE_JOURNAL);
+    }
+
+    return NULL;
+}
+
+/**
+ * Appends tasks to the list file, see tasklist_append().
+ *
+ * @param list The TaskList
+ * @param tasks Array of tasks, terminated by a NULL element
+ * @param index Add the tasks to an up to date word index (0 = false, leaving
+ *              it to be rebuilt by the next lookup, 1 = true)
+ * @return Error message or NULL on success
+ */
+static const char *append_list(TaskList list, char **tasks, int index) {
+    enum sync_policy policy;
+    const char *error = get_sync_policy(&policy);
+    if (error) {
+        return error;
+    }
+    // A task on several lines would split its journal record, and come back
+    // as several tasks
+    for (char **task = tasks; *task; ++task) {
+        if (strchr(*task, '\n')) {
+            return error_message(ERROR_NEWLINE);
+        }
+    }
+    // The catalog can carry its count forward from the list as it is now,
+    // and an up to date word index only needs the new tasks added
+    struct catalog_stamp before;
+    int existed = catalog_stamp(list->path, &before) == 0;
+    struct words_header header;
+    size_t words_size = 0;
+    char *words = index && access(list->words_path, F_OK) == 0 ?
+        map_words(list, &header, &words_size) : NULL;
+
+    // If the file has a journal, the tasks need to go after its records.
+    // Otherwise they're appended to the file itself.
+    struct stat st;
+    int fd, header_length = 0;
+    if (stat(list->path, &st) == 0 &&
+        (fd = open(list->journal_path, O_RDONLY)) != -1) {
+        file_id_from_stat(&list->id, &st);
+        header_length = check_journal(list, fd);
+        close(fd);
+    }
+    error = header_length > 0 ? append_journal(list, tasks, policy) :
+        append_file(list, tasks, policy);
+    if (words) {
+        if (!error) {
+            append_words(list, &header, words, words_size, tasks);
+        }
+        munmap(words, words_size);
+    }
+    if (!error) {
+        catalog_append(list->path, existed ? &before : NULL, tasks);
+    }
+
+    return error;
+}
+
+const char *tasklist_append(TaskList list, char **tasks) {
+    struct trace_mark mark;
+    trace_begin(&mark);
+    const char *error = append_list(list, tasks, 1);
+    trace_end(TRACE_WRITE, &mark);
+
+    return error;
+}
+
+const char *tasklist_append_fd(TaskList list, int fd) {
+    struct trace_mark mark;
+    trace_begin(&mark);
+    // Room for a block behind the partial line of the previous one
+    size_t size = 2 * APPEND_BLOCK_SIZE, length = 0;
+    char *buffer = malloc(size);
+    char **tasks = NULL;
+    size_t capacity = 0;
+    int blocks = 0;
+    const char *error = NULL;
+    while (!error) {
+        // Grow the buffer when a single line gets long
+        if (size - length < APPEND_BLOCK_SIZE) {
+            size *= 2;
+            buffer = realloc(buffer, size);
+        }
+        ssize_t got = read(fd, buffer + length, size - length);
+        if (got == -1 && errno == EINTR) {
+            continue;
+        }
+        if (got == -1) {
+            error = error_message(ERROR_READ_TASKS);
+            break;
+        }
+        // Keep reading until the block is full, except at the end where the
+        // last line doesn't need a newline
+        length += got;
+        char *end = buffer + length, *complete = end;
+        if (got > 0 && length < APPEND_BLOCK_SIZE) {
+            continue;
+        }
+        if (got > 0) {
+            while (complete > buffer && complete[-1] != '\n') {
+                --complete;
+            }
+            if (complete == buffer) {
+                continue;
+            }
+        }
+
+        // Terminate the lines in place, skipping empty ones
+        size_t count = 0;
+        for (char *line = buffer; line < complete; ) {
+            char *newline = memchr(line, '\n', complete - line);
+            char *line_end = newline ? newline : complete;
+            if (line_end > line) {
+                if (count + 1 >= capacity) {
+                    capacity = capacity ? 2 * capacity : STARTING_CAPACITY;
+                    tasks = realloc(tasks, capacity * sizeof(char *));
+                }
+                tasks[count++] = line;
+            }
+            *line_end = '\0';
+            line = line_end + 1;
+        }
+        if (count > 0) {
+            tasks[count] = NULL;
+            // Updating the word index block by block would rewrite it every
+            // time, so a long stream leaves it to be rebuilt instead
+            error = append_list(list, tasks, got == 0 && blocks == 0);
+            ++blocks;
+        }
+        if (got == 0) {
+            break;
+        }
+        length = end - complete;
+        memmove(buffer, complete, length);
+    }
+    free(tasks);
+    free(buffer);
+    trace_end(TRACE_WRITE, &mark);
+
+    return error;
+}
+
+const char *tasklist_remove(TaskList list) {
+    // Attempt unlinking the list and whatever journal it has
+    if (unlink(list->path) != 0) {
+        return error_message(ERROR_DELETE_LIST);
+    }
+    if (unlink(list->journal_path) != 0 && errno != ENOENT) {
+        return error_message(ERROR_DELETE_JOURNAL);
+    }
+    if ((unlink(list->index_path) != 0 && errno != ENOENT) ||
+        (unlink(list->words_path) != 0 && errno != ENOENT)) {
+        return error_message(ERROR_DELETE_INDEX);
     }
+    catalog_update(list->path, -1);
 
     return NULL;
 }
@@ -1,8 +1,21 @@
 #ifndef TASKLIST_H
 #define TASKLIST_H
 
+#include <stddef.h>
+#include "format.h"
+#include "sink.h"
+#include "sort.h"
+
 typedef struct tasklist *TaskList;
 
+/**
+ * A range of task positions (1-based, both inclusive).
+ */
+struct tasklist_range {
+    long first;
+    long last;
+};
+
 /**
  * Returns an initialized TaskList.
  *
@@ -19,16 +32,109 @@ TaskList tasklist_init(const char *path);
 void tasklist_destroy(TaskList list);
 
 /**
- * Prints the TaskList to stdout.
+ * Returns the number of tasks in the TaskList.
+ *
+ * @param list The TaskList
+ * @return The number of tasks
+ */
+int tasklist_length(TaskList list);
+
+/**
+ * Prints the TaskList to a sink.
+ *
+ * The list is formatted as a whole and written at once. It's only
+ * highlighted and wrapped to the width of the terminal if the sink is a
+ * terminal.
+ *
+ * @param list The TaskList
+ * @param sink Where to print it
+ * @return Error message or NULL on success
+ */
+const char *tasklist_print(TaskList list, const struct sink *sink);
+
+/**
+ * Returns the number of columns lists printed to a sink should fit in.
+ *
+ * @param sink The sink
+ * @return Width of the terminal, or 80 if the sink isn't a terminal
+ */
+int tasklist_columns(const struct sink *sink);
+
+/**
+ * Formats the TaskList the way tasklist_print() prints it.
+ *
+ * Because a new buffer needs to be allocated, the user must free it.
+ *
+ * @param list The TaskList
+ * @param ansi Highlight with escape sequences (0 = false, 1 = true)
+ * @param columns Number of columns to wrap tasks at
+ * @param size Set to the size of the formatted list
+ * @return The formatted list, not terminated (freed by user)
+ */
+char *tasklist_render(TaskList list, int ansi, int columns, size_t *size);
+
+/**
+ * Formats the tasks of the TaskList as records for other programs, see
+ * format_task().
+ *
+ * Because a new buffer needs to be allocated, the user must free it.
  *
  * @param list The TaskList
+ * @param format The format, other than FORMAT_TEXT
+ * @param size Set to the size of the formatted tasks
+ * @return The formatted tasks, not terminated (freed by user)
  */
-void tasklist_print(TaskList list);
+char *tasklist_export(TaskList list, enum format format, size_t *size);
+
+/**
+ * Finds the tasks that contain a pattern.
+ *
+ * Every match is formatted as a line "list:position: text", or as a record
+ * like format_task() makes. If the TaskList wasn't read yet and has no
+ * journal, its file is searched directly without splitting it into tasks
+ * first.
+ * Because a new buffer needs to be allocated, the user must free it.
+ *
+ * @param list The TaskList
+ * @param pattern The text to look for
+ * @param ignore_case Ignore the case of ASCII letters (0 = false, 1 = true)
+ * @param format How to format the matches
+ * @param result Set to the formatted matches, not terminated (freed by user)
+ * @param size Set to the size of the formatted matches
+ * @return Error message or NULL on success
+ */
+const char *tasklist_search(
+    TaskList list, const char *pattern, int ignore_case, enum format format,
+    char **result, size_t *size);
+
+/**
+ * Finds the tasks that contain a word, with the help of the word index.
+ *
+ * Every match is formatted as a line "list:position: text", or as a record
+ * like format_task() makes. If the TaskList wasn't read yet and its word
+ * index is up to date, the tasks are found without reading the list.
+ * Otherwise the index is built from the tasks and, if it can be, written
+ * for next time. Once there is a word index, tasklist_write() keeps it up
+ * to date.
+ * Because a new buffer needs to be allocated, the user must free it.
+ *
+ * @param list The TaskList
+ * @param word The word, ignoring the case of ASCII letters
+ * @param prefix Also find words starting with it (0 = false, 1 = true)
+ * @param format How to format the matches
+ * @param result Set to the formatted matches, not terminated (freed by user)
+ * @param size Set to the size of the formatted matches
+ * @return Error message or NULL on success
+ */
+const char *tasklist_lookup(
+    TaskList list, const char *word, int prefix, enum format format,
+    char **result, size_t *size);
 
 /**
  * Inserts a task into a list at a specific position.
  *
- * Any existing items at that position and after are pushed down.
+ * Any existing items at that position and after are pushed down. The task
+ * can't contain newlines.
  *
  * @param list The TaskList
  * @param position The position to insert to (1-based)
@@ -37,6 +143,20 @@ void tasklist_print(TaskList list);
  */
 const char *tasklist_insert(TaskList list, long position, const char *task);
 
+/**
+ * Inserts several tasks into a list, starting at a specific position.
+ *
+ * The tasks keep their order, the first one ending up at the position.
+ * Any existing items at that position and after are pushed down. Tasks
+ * can't contain newlines.
+ *
+ * @param list The TaskList
+ * @param position The position to insert to (1-based)
+ * @param tasks Array of task texts, terminated by a NULL element
+ * @return Error message or NULL on success
+ */
+const char *tasklist_insert_many(TaskList list, long position, char **tasks);
+
 /**
  * Removes the tasks at the given positions from the list.
  *
@@ -46,6 +166,20 @@ const char *tasklist_insert(TaskList list, long position, const char *task);
  */
 const char *tasklist_done(TaskList list, const long *positions);
 
+/**
+ * Removes the tasks in the given ranges from the list.
+ *
+ * Ranges may overlap and come in any order, every task covered by at least
+ * one of them is removed.
+ *
+ * @param list The TaskList
+ * @param ranges Array of ranges, terminated by an element whose first
+ *               position is -1
+ * @return Error message or NULL on success
+ */
+const char *tasklist_done_ranges(
+    TaskList list, const struct tasklist_range *ranges);
+
 /**
  * Moves a task inside a list by bubbling it up or down.
  *
@@ -56,20 +190,126 @@ const char *tasklist_done(TaskList list, const long *positions);
  */
 const char *tasklist_move(TaskList list, long from, long to);
 
+/**
+ * Sorts the tasks of a list by their text, keeping equal ones in order.
+ *
+ * @param list The TaskList
+ * @param flags How to order them, see enum sort_flags
+ * @return Error message or NULL on success
+ */
+const char *tasklist_sort(TaskList list, int flags);
+
+/**
+ * Locks the TaskList's file against others, waiting if necessary.
+ *
+ * Shared locks are for reading, exclusive locks for modifying a list. A
+ * shared lock can be upgraded to an exclusive one by locking again.
+ * The TASUKE_LOCK_TIMEOUT environment variable limits how many seconds to
+ * wait, and with TASUKE_LOCK_REPORT set the time spent waiting is reported
+ * on stderr.
+ *
+ * @param list The TaskList
+ * @param exclusive Whether to lock exclusively (0 = false, 1 = true)
+ * @return Error message or NULL on success
+ */
+const char *tasklist_lock(TaskList list, int exclusive);
+
+/**
+ * Releases the lock on the TaskList's file, if it holds one.
+ *
+ * Destroying the TaskList does this as well.
+ *
+ * @param list The TaskList
+ */
+void tasklist_unlock(TaskList list);
+
 /**
  * Builds the TaskList by reading it from file.
  *
+ * If the file has a journal, the operations in it are replayed on top.
+ * If the TASUKE_INDEX environment variable is set (and not 0), the offsets
+ * of all lines are kept in an index next to the file. As long as the file
+ * doesn't change, that saves scanning it for line breaks.
+ *
  * @param list The TaskList
  * @return Error message or NULL on success
  */
 const char *tasklist_read(TaskList list);
 
+/**
+ * Builds the TaskList from a range of the tasks in its file.
+ *
+ * The file is only scanned up to the end of the range, unless positions
+ * count back from the end. Lists with a journal are read as a whole first.
+ * The tasks keep their positions when printed, and the TaskList can't be
+ * written. Positions past the end of the list are left out.
+ *
+ * @param list The TaskList
+ * @param first First position (1-based), negative counting back from the
+ *              end (-1 being the last task)
+ * @param last Last position (1-based), negative counting back from the end
+ * @return Error message or NULL on success
+ */
+const char *tasklist_read_range(TaskList list, long first, long last);
+
 /**
  * Writes the TaskList to its file.
  *
+ * If the TASUKE_JOURNAL environment variable is set (and not 0), only the
+ * operations since the list was read are appended to its journal, which is
+ * folded back into the file once it grows large enough. Otherwise the file
+ * is replaced as a whole, unless TASUKE_IN_PLACE is set (and not 0) and
+ * TASUKE_SYNC is none, in which case what changed is rewritten in place.
+ *
  * @param list The TaskList
  * @return Error message or NULL on success
  */
 const char *tasklist_write(TaskList list);
 
+/**
+ * Checks whether the TaskList's file was changed by someone else.
+ *
+ * Compares the file and its journal with the versions that were read or
+ * last written. Modifications that haven't been written yet don't count.
+ *
+ * @param list The TaskList
+ * @return 1 if the file changed or disappeared, 0 otherwise
+ */
+int tasklist_changed(TaskList list);
+
+/**
+ * Appends tasks to the TaskList's file without reading it.
+ *
+ * This doesn't change the TaskList itself, read it afterwards to see the
+ * tasks. Tasks can't contain newlines.
+ *
+ * @param list The TaskList
+ * @param tasks Array of task texts, terminated by a NULL element
+ * @return Error message or NULL on success
+ */
+const char *tasklist_append(TaskList list, char **tasks);
+
+/**
+ * Appends the newline-separated tasks read from a file descriptor to the
+ * TaskList's file without reading it, see tasklist_append().
+ *
+ * The input is appended in blocks of complete lines as it's read, so it
+ * doesn't need to fit in memory. Empty lines are skipped. Unless the input
+ * fits in a single block, the word index is left to be rebuilt by the next
+ * lookup.
+ *
+ * @param list The TaskList
+ * @param fd File descriptor open for reading, read until its end
+ * @return Error message or NULL on success
+ */
+const char *tasklist_append_fd(TaskList list, int fd);
+
+/**
+ * Deletes the TaskList's file, along with its journal and index.
+ *
+ * @param list The TaskList
+ * @return Error message or NULL on success
+ */
+const char *tasklist_remove(TaskList list);
+
 #endif // TASKLIST_H
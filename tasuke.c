@@ -1,165 +1,254 @@
-/* Using getopt, need POSIX 1992 */
+/* Using STDIN_FILENO, need POSIX 1992 */
 #define _POSIX_C_SOURCE 2
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 #include <unistd.h>
+#include "command.h"
+#include "errors.h"
+#include "server.h"
+#include "session.h"
 #include "tasklib.h"
+#include "trace.h"
 
 static const char *usage =
-    "Usage: %1$s [-s directory] [LIST]...\n"
+    "Usage: %1$s [-f format] [-s directory] [LIST]...\n"
     "  or   %1$s -a [-n list] [-s directory] [-v] TASK...\n"
     "  or   %1$s -p [-n list] [-s directory] [-v] TASK...\n"
     "  or   %1$s -i [-n list] [-s directory] [-v] POSITION TASK\n"
     "  or   %1$s -d [-n list] [-s directory] [-v] POSITION...\n"
     "  or   %1$s -m [-n list] [-s directory] [-v] PREV_POS NEW_POS\n"
-    "  or   %1$s -l [-s directory]\n"
+    "  or   %1$s -S [-n list] [-s directory] [-v] [ORDER]\n"
+    "  or   %1$s -l [-f format] [-s directory] [-v]\n"
+    "  or   %1$s -R RANGE [-f format] [-s directory] [LIST]...\n"
     "  or   %1$s -r [-s directory] [LIST]...\n"
+    "  or   %1$s -g [-y] [-f format] [-s directory] PATTERN [LIST]...\n"
+    "  or   %1$s -k [-f format] [-s directory] WORD[*] [LIST]...\n"
+    "  or   %1$s -b [-s directory] [FLUSH_EVERY]\n"
+    "  or   %1$s -D [-s directory]\n"
     "Manage your todo/task lists with this small utility.\n"
     "\n"
     "Options:\n"
-    "  -a            Add tasks by appending them to a list\n"
-    "  -d            Complete tasks and delete them\n"
+    "  -a            Add tasks by appending them to a list (read from\n"
+    "                stdin, one per line, if the only task is -)\n"
+    "  -b            Run commands read from stdin, one per line\n"
+    "  -D            Serve commands for the directory until interrupted\n"
+    "  -d            Complete tasks and delete them (positions or ranges\n"
+    "                like 10-20)\n"
+    "  -f format     Print tasks or list names as json, tsv or nul\n"
+    "                (NUL-terminated fields) records instead of text\n"
+    "  -g            Search lists for tasks containing a pattern\n"
     "  -h            Print usage information\n"
     "  -i            Insert a task into a list at a specific position\n"
+    "  -k            Look up tasks containing a word (or words starting\n"
+    "                with it) through an index\n"
     "  -l            Show all list names\n"
     "  -m            Move a task inside a list from one position to another\n"
     "  -n list       Select a specific list for your current operation\n"
-    "  -p            Add tasks by prepending them to a list\n"
+    "  -p            Add tasks by prepending them to a list (read from\n"
+    "                stdin like with -a)\n"
+    "  -R range      Show only the tasks at positions like 10-20, 10- (to\n"
+    "                the end), 20 (the first 20) or -20 (the last 20)\n"
     "  -r            Remove task lists\n"
+    "  -S            Sort a list, in the ORDER given by the letters i\n"
+    "                (ignore case), n (numbers by value) and r (reverse)\n"
     "  -s directory  Select a specific directory to store task lists\n"
-    "  -v            Show the list after modification\n"
+    "  -v            Show the list after modification, or the number of\n"
+    "                tasks in every list with -l\n"
+    "  -y            Ignore case when searching\n"
     "\n"
     "Copyright (c) 2018 Martin Disch <martindisch@gmail.com>\n"
     "Project website <https://github.com/martindisch/tasuke>\n";
 
-int main(int argc, char **argv) {
-    /*
-     * Some flags & option argument variables for user input
-     */
-    int aflg = 0, pflg = 0, iflg = 0, dflg = 0, mflg = 0, rflg = 0;
-    int lflg = 0, vflg = 0, nflg = 0;
-    // Set to 1 if there is a problem parsing options
-    int errflg = 0;
-    // Pointers to option arguments
-    const char *nvalue = NULL, *svalue = NULL;
-
-    /*
-     * Simple argument parsing, mostly just setting flags.
-     * Would be simpler with argp, but we need to use getopt for portability.
-     */
-    int c;
-    while ((c = getopt(argc, argv, "apidmrlhvn:s:")) != -1) {
-        switch (c) {
-            case 'a':
-                aflg = 1;
-                break;
-            case 'p':
-                pflg = 1;
-                break;
-            case 'i':
-                iflg = 1;
-                break;
-            case 'd':
-                dflg = 1;
-                break;
-            case 'm':
-                mflg = 1;
-                break;
-            case 'r':
-                rflg = 1;
-                break;
-            case 'l':
-                lflg = 1;
-                break;
-            case 'h':
-                printf(usage, argv[0]);
-                exit(EXIT_SUCCESS);
-            case 'v':
-                vflg = 1;
-                break;
-            case 'n':
-                nflg = 1;
-                nvalue = optarg;
-                break;
-            case 's':
-                svalue = optarg;
-                break;
-            case ':':
-                // Option flag without required option argument
-                errflg = 1;
-                break;
-            case '?':
-                // Unrecognized option
-                errflg = 1;
-                break;
+/**
+ * Runs the commands on stdin in a single session.
+ *
+ * @param dir Full path to directory
+ * @param operands Array containing at most the number of commands after
+ *                 which to write modified lists (type string), terminated
+ *                 by a NULL element
+ * @return Error message or NULL on success
+ */
+static const char *batch(const char *dir, char **operands) {
+    // Extract how often to write, by default only at the end
+    long flush_every = 0;
+    if (operands[0]) {
+        errno = 0;
+        char *endptr;
+        flush_every = strtol(operands[0], &endptr, 10);
+        if (errno || *endptr != '\0' || flush_every < 0) {
+            return error_message(ERROR_FLUSH_EVERY);
+        }
+        if (operands[1]) {
+            return error_message(ERROR_MANY_ARGUMENTS);
         }
     }
 
+    Session session = session_init(dir, &sink_stdout);
+    const char *error = session_batch(session, stdin, flush_every);
+    const char *flush_error = session_destroy(session);
+
+    return error ? error : flush_error;
+}
+
+/**
+ * Tells whether a command reads its tasks from stdin, like t -a -.
+ *
+ * @param command The command
+ * @return 1 if it does, 0 otherwise
+ */
+static int reads_stdin(const struct command *command) {
+    return (command->type == COMMAND_ADD ||
+        command->type == COMMAND_PREPEND) && command->operands[0] &&
+        strcmp(command->operands[0], "-") == 0 && !command->operands[1];
+}
+
+int main(int argc, char **argv) {
     /*
-     * Several checks for parsing problems and bad usage of flags
+     * Parse the command line, checking for bad usage of flags
      */
-    if (
-        // Problem noticed by getopt
-        errflg ||
-        // Mutually exclusive flags
-        aflg + pflg + iflg + dflg + mflg + rflg + lflg > 1 ||
-        // -r doesn't have -n option
-        nflg + rflg > 1 ||
-        // -l doesn't have -n option
-        lflg + rflg > 1 ||
-        // -n can't occur on its own
-        nflg > aflg + pflg + iflg + dflg + mflg
-    ) {
+    struct command command;
+    if (command_parse(&command, argc, argv)) {
         fprintf(stderr, usage, argv[0]);
         exit(EXIT_FAILURE);
     }
+    if (command.type == COMMAND_HELP) {
+        printf(usage, argv[0]);
+        exit(EXIT_SUCCESS);
+    }
+    trace_init(command.type);
 
     /*
-     * Get the filename(s) the commands will need
+     * Let the server run the command, if there is one and it doesn't need
+     * our stdin
      */
-    char *file = NULL, **files = NULL;
-    if (aflg + pflg + iflg + dflg + mflg) {
-        // These commands use only a single task list
-        if ((file = get_file(svalue, nvalue)) == NULL) {
-            fprintf(stderr, "Unable to access directory\n");
+    int from_stdin = reads_stdin(&command);
+    if (command.type != COMMAND_BATCH && command.type != COMMAND_SERVE &&
+        !from_stdin) {
+        char *dir;
+        if ((dir = get_dir(command.dir)) == NULL) {
+            fputs(error_message(ERROR_ACCESS_DIR), stderr);
             exit(EXIT_FAILURE);
         }
-    } else if (lflg) {
-        // The -l command needs the path to the directory, not to a list
-        if ((file = get_dir(svalue)) == NULL) {
-            fprintf(stderr, "Unable to access directory\n");
+        int status;
+        struct trace_mark mark;
+        trace_begin(&mark);
+        const char *error = server_forward(dir, &command, &status);
+        trace_end(TRACE_FORWARD, &mark);
+        free(dir);
+        if (error) {
+            fprintf(stderr, error);
             exit(EXIT_FAILURE);
         }
-    } else {
-        // The other commands (list list(s), remove list(s)) may need several
-        if ((files = get_files(svalue, &argv[optind])) == NULL) {
-            fprintf(stderr, "Unable to access directory\n");
-            exit(EXIT_FAILURE);
+        if (status != -1) {
+            exit(status == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
         }
     }
 
+    /*
+     * Get the filename(s) the commands will need
+     */
+    char *file = NULL, **files = NULL;
+    switch (command.type) {
+        case COMMAND_ADD:
+        case COMMAND_PREPEND:
+        case COMMAND_INSERT:
+        case COMMAND_DONE:
+        case COMMAND_MOVE:
+        case COMMAND_SORT:
+            // These commands use only a single task list
+            if ((file = get_file(command.dir, command.list)) == NULL) {
+                fputs(error_message(ERROR_ACCESS_DIR), stderr);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case COMMAND_NAMES:
+        case COMMAND_SEARCH:
+        case COMMAND_LOOKUP:
+        case COMMAND_BATCH:
+        case COMMAND_SERVE:
+            // These commands need the path to the directory, not to a list
+            if ((file = get_dir(command.dir)) == NULL) {
+                fputs(error_message(ERROR_ACCESS_DIR), stderr);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        default:
+            // The other commands (list list(s), list range(s), remove
+            // list(s)) may need several
+            if ((files = get_files(command.dir, command.operands)) == NULL) {
+                fputs(error_message(ERROR_ACCESS_DIR), stderr);
+                exit(EXIT_FAILURE);
+            }
+    }
+
     /*
      * Handle command
      */
     const char *error = NULL;
-    if (aflg) {
-        error = tasklib_add(file, &argv[optind], vflg);
-    } else if (pflg) {
-        error = tasklib_prepend(file, &argv[optind], vflg);
-    } else if (iflg) {
-        error = tasklib_insert(file, &argv[optind], vflg);
-    } else if (dflg) {
-        error = tasklib_done(file, &argv[optind], vflg);
-    } else if (mflg) {
-        error = tasklib_move(file, &argv[optind], vflg);
-    } else if (rflg) {
-        error = tasklib_remove(files);
-    } else if (lflg) {
-        error = tasklib_names(file);
-    } else {
-        // No command flag (= list command)
-        error = tasklib_list(files);
+    switch (command.type) {
+        case COMMAND_ADD:
+            error = from_stdin ?
+                tasklib_add_fd(
+                    file, STDIN_FILENO, command.verbose, &sink_stdout) :
+                tasklib_add(
+                    file, command.operands, command.verbose, &sink_stdout);
+            break;
+        case COMMAND_PREPEND:
+            error = from_stdin ?
+                tasklib_prepend_fd(
+                    file, STDIN_FILENO, command.verbose, &sink_stdout) :
+                tasklib_prepend(
+                    file, command.operands, command.verbose, &sink_stdout);
+            break;
+        case COMMAND_INSERT:
+            error = tasklib_insert(
+                file, command.operands, command.verbose, &sink_stdout);
+            break;
+        case COMMAND_DONE:
+            error = tasklib_done(
+                file, command.operands, command.verbose, &sink_stdout);
+            break;
+        case COMMAND_MOVE:
+            error = tasklib_move(
+                file, command.operands, command.verbose, &sink_stdout);
+            break;
+        case COMMAND_SORT:
+            error = tasklib_sort(
+                file, command.operands, command.verbose, &sink_stdout);
+            break;
+        case COMMAND_REMOVE:
+            error = tasklib_remove(files);
+            break;
+        case COMMAND_NAMES:
+            error = tasklib_names(
+                file, command.verbose, command.format, &sink_stdout);
+            break;
+        case COMMAND_SEARCH:
+            error = tasklib_search(
+                file, command.operands, command.ignore_case, command.format,
+                &sink_stdout);
+            break;
+        case COMMAND_LOOKUP:
+            error = tasklib_lookup(
+                file, command.operands, command.format, &sink_stdout);
+            break;
+        case COMMAND_BATCH:
+            error = batch(file, command.operands);
+            break;
+        case COMMAND_SERVE:
+            error = *command.operands ?
+                error_message(ERROR_MANY_ARGUMENTS) : server_run(file);
+            break;
+        case COMMAND_RANGE:
+            error = tasklib_range(
+                files, command.range, command.format, &sink_stdout);
+            break;
+        default:
+            // No command flag (= list command)
+            error = tasklib_list(files, command.format, &sink_stdout);
     }
 
     /*
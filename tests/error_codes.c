@@ -0,0 +1,28 @@
+/* Using getline, need POSIX 2008 */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../libtasuke.h"
+
+/**
+ * Prints the error messages read from stdin, one per line, that
+ * tasuke_error_code() doesn't know.
+ *
+ * @return 0 if it knows all of them, 1 otherwise
+ */
+int main(void) {
+    char *line = NULL;
+    size_t capacity = 0;
+    int unknown = 0;
+    // Messages end with their newline, like the lines
+    while (getline(&line, &capacity, stdin) != -1) {
+        if (tasuke_error_code(line) == TASUKE_ERROR_OTHER) {
+            fputs(line, stdout);
+            unknown = 1;
+        }
+    }
+    free(line);
+
+    return unknown;
+}
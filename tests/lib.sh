@@ -0,0 +1,43 @@
+# Helpers for the tests, which run in the directory of lists in $DIR
+
+# Runs tasuke on the lists of the test
+t() {
+    "$TASUKE" -s "$DIR" "$@"
+}
+
+# Fails the test, telling why on stderr
+fail() {
+    printf '%s\n' "$*" >&2
+    exit 1
+}
+
+# Runs a command that has to succeed and checks what it prints, ignoring
+# trailing newlines
+# Usage: expect EXPECTED COMMAND [ARG]...
+expect() {
+    expected=$1
+    shift
+    actual=$("$@") || fail "Failed: $*"
+    [ "$actual" = "$expected" ] ||
+        fail "Unexpected output of $*:
+$actual
+instead of:
+$expected"
+}
+
+# Runs a command that has to fail with a message on stderr
+# Usage: expect_error MESSAGE COMMAND [ARG]...
+expect_error() {
+    message=$1
+    shift
+    actual=$("$@" 2>&1) && fail "Succeeded: $*"
+    [ "$actual" = "$message" ] ||
+        fail "Unexpected error from $*: $actual instead of: $message"
+}
+
+# Prints a list's tasks as a line each, without numbering or highlighting
+tasks() {
+    esc=$(printf '\033')
+    t "$@" | sed -e 1d -e '/^ No tasks$/d' -e "s/$esc\[[0-9]*m//g" \
+        -e 's/^ *[0-9]* //'
+}
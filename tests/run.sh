@@ -0,0 +1,27 @@
+#!/bin/sh
+# Runs every test_*.sh next to this script against the tasuke built in the
+# directory above, each in a directory of lists of its own
+
+cd "$(dirname "$0")" || exit 1
+TESTS=$(pwd)
+TASUKE=$TESTS/../tasuke
+export TESTS TASUKE
+
+# The environment decides how lists are written, so start without any of it
+for variable in $(env | sed -n 's/^\(TASUKE_[A-Z_]*\)=.*/\1/p'); do
+    unset "$variable"
+done
+
+failed=0
+for test in test_*.sh; do
+    DIR=$(mktemp -d) || exit 1
+    if (. "$TESTS/lib.sh" && cd "$DIR" && . "$TESTS/$test"); then
+        echo "ok   $test"
+    else
+        echo "FAIL $test"
+        failed=1
+    fi
+    rm -rf "$DIR"
+done
+
+exit $failed
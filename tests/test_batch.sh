@@ -0,0 +1,64 @@
+# Running commands read from stdin
+
+# Arguments are split at blanks, and quotes and escapes keep them together
+t -b <<'END' || fail "Unable to run a batch"
+# Comments and empty lines are skipped
+
+-a one "two words" 'single "quoted"'
+	-a  tab\ and\ spaces  "esc\"aped \\ back" 'no \escape'
+-a -n other "x"y'z'
+END
+expect 'one
+two words
+single "quoted"
+tab and spaces
+esc"aped \ back
+no \escape' cat todo.txt
+expect "xyz" cat other.txt
+
+# Failing lines are reported, the others still run
+t -b > out 2> err <<'END' && fail "Failures not reported"
+-d 9
+-a three
+-a "open
+-a -d x
+-i 1 first
+END
+expect "first
+one
+two words
+single \"quoted\"
+tab and spaces
+esc\"aped \\ back
+no \\escape
+three" cat todo.txt
+expect "Line 1: Invalid position
+Line 3: Unterminated quote
+Line 4: Invalid usage
+Some commands failed" cat err
+[ -s out ] && fail "Unexpected output"
+
+# Lists are written only at the end, or every so many commands
+expect_error "Flush interval not a number" t -b x
+expect_error "Flush interval not a number" t -b -- -1
+expect_error "Too many arguments" t -b 1 2
+echo x > flushed.txt
+mkfifo commands
+t -b 2 < commands &
+exec 3> commands
+printf -- '-p -n flushed a\n-p -n flushed b\n-p -n flushed c\n' >&3
+tries=0
+until [ "$(cat flushed.txt)" != x ]; do
+    tries=$((tries + 1))
+    [ $tries -lt 100 ] || fail "Not written after the interval"
+    sleep 0.05
+done
+expect "b
+a
+x" cat flushed.txt
+exec 3>&-
+wait $! || fail "Unable to run a batch with an interval"
+expect "c
+b
+a
+x" cat flushed.txt
@@ -0,0 +1,30 @@
+# Listing lists and their task counts through the catalog
+
+t -a a b c || fail "Unable to add"
+t -n work -a x || fail "Unable to add"
+expect "todo
+work" t -l
+[ -f .catalog ] || fail "No catalog"
+expect "3 todo
+1 work" t -l -v
+
+# Modifying lists updates their counts
+t -d 1 || fail "Unable to delete"
+TASUKE_JOURNAL=1 t -n work -p w || fail "Unable to prepend"
+t -n work -a y || fail "Unable to append to a journal"
+expect "2 todo
+3 work" t -l -v
+
+# Lists changed, created and deleted some other way are noticed as well
+printf 'd\ne\n' >> todo.txt
+expect "4 todo
+3 work" t -l -v
+printf 'bcdefgh\n' > todo.txt
+expect "1 todo
+3 work" t -l -v
+: > new.txt
+rm work.txt work.log
+expect "0 new
+1 todo" t -l -v
+expect "new
+todo" t -l
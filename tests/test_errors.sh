@@ -0,0 +1,37 @@
+# Every error comes from the table in errors.h, which gives it a kind
+
+# Messages are the literals ending with a newline. Apart from the usage text
+# and the benchmark's own, they're only found in the table.
+literals=$(
+    for source in "$TESTS"/../*.c; do
+        case $source in
+            */bench.c) continue ;;
+        esac
+        sed '/^static const char \*usage =/,/;$/d' "$source" |
+            grep -H --label="$source" '"[A-Z][^"%]*\\n"'
+    done
+)
+[ -z "$literals" ] || fail "Messages outside of errors.h:
+$literals"
+messages=$(grep -o '"[A-Z][^"%]*\\n"' "$TESTS/../errors.h" |
+    sed 's/^"//; s/\\n"$//')
+[ "$(printf '%s\n' "$messages" | wc -l)" -gt 30 ] || fail "No table found"
+unknown=$(printf '%s\n' "$messages" | "$TESTS/error_codes") ||
+    fail "Messages without a kind:
+$unknown"
+
+# So has what failing commands print
+printf 'a\n' > todo.txt
+for command in "-d 2" "-d x" "-m 1" "-i 1 a b" "-R 0" "-k"; do
+    # Every word of the command is an argument of its own
+    t $command 2>&1 > /dev/null
+done > messages.txt
+expect "Invalid position
+Position not a number
+Not enough arguments
+Too many arguments
+Invalid range
+Not enough arguments" cat messages.txt
+unknown=$("$TESTS/error_codes" < messages.txt) ||
+    fail "Printed messages without a kind:
+$unknown"
@@ -0,0 +1,43 @@
+# -f prints tasks, matches and list names as json, tsv or nul records
+
+t -a 'say "hi"' 'back\slash' "$(printf 'tab\there')" 'ü 漢' \
+    "$(printf 'bell\001')" || fail "Unable to add"
+t -n other -a fork || fail "Unable to add to another list"
+
+expect '{"list":"todo","position":1,"text":"say \"hi\""}
+{"list":"todo","position":2,"text":"back\\slash"}
+{"list":"todo","position":3,"text":"tab\there"}
+{"list":"todo","position":4,"text":"ü 漢"}
+{"list":"todo","position":5,"text":"bell\u0001"}' t -f json todo
+expect "todo	1	say \"hi\"
+todo	2	back\\\\slash
+todo	3	tab\\there
+todo	4	ü 漢
+todo	5	bell$(printf '\001')" t -f tsv todo
+expect "todo	5	bell$(printf '\001')
+other	1	fork" t -f tsv -R -1 todo other
+expect "todo|1|say \"hi\"|todo|2|back\\slash|" \
+    eval 't -f nul -R 2 todo | tr "\0" "|"'
+
+# Matches and list names, with and without task counts
+expect '{"list":"todo","position":2,"text":"back\\slash"}
+{"list":"other","position":1,"text":"fork"}' t -f json -g -y K todo other
+expect "other	1	fork" t -f tsv -k fork other
+expect '{"list":"other"}
+{"list":"todo"}' t -f json -l
+expect '{"list":"other","tasks":1}
+{"list":"todo","tasks":5}' t -f json -l -v
+expect "other	1
+todo	5" t -f tsv -l -v
+expect "other|todo|" eval 't -f nul -l | tr "\0" "|"'
+expect "other|1|todo|5|" eval 't -f nul -l -v | tr "\0" "|"'
+
+# Text stays the default, other formats are rejected, and only commands
+# that show something take one
+expect "other
+ 1 fork" t other
+expect_error "Invalid format" t -f xml
+if t -f json -a x > /dev/null 2>&1; then
+    fail "Accepted -f for -a"
+fi
+expect "5" eval 'tasks todo | wc -l | tr -d " "'
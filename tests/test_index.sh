@@ -0,0 +1,66 @@
+# Deleting the last tasks shrinks the file, and the line index follows it
+
+export TASUKE_INDEX=1
+for in_place in 0 1; do
+    export TASUKE_IN_PLACE=$in_place
+    rm -f todo.txt todo.idx
+    t -a $(seq 6) || fail "Unable to add"
+    expect "1
+2
+3
+4
+5
+6" tasks todo
+    [ -f todo.idx ] || fail "No index"
+
+    t -d 6 || fail "Unable to delete the last task"
+    t -d 4-5 || fail "Unable to delete the last tasks"
+    expect "1
+2
+3" cat todo.txt
+    expect "1
+2
+3" tasks todo
+
+    # Tasks appended after the file shrank are read through the new index
+    t -a 7 || fail "Unable to add after deleting"
+    expect "1
+2
+3
+7" tasks todo
+    t -d 4 || fail "Unable to delete the appended task"
+    expect "1
+2
+3" tasks todo
+done
+
+# Edits in the middle keep the index in step with the file
+t -i 2 x || fail "Unable to insert"
+t -m 4 1 || fail "Unable to move"
+expect "3
+1
+x
+2" tasks todo
+t -d 2 || fail "Unable to delete"
+expect "3
+x
+2" tasks todo
+expect "3
+x
+2" cat todo.txt
+
+# Ranges are read through the index as well
+rm -f todo.txt todo.idx
+t -a $(seq 12) || fail "Unable to add"
+t > /dev/null || fail "Unable to index"
+[ -f todo.idx ] || fail "No index"
+expect "todo
+ 3 3
+ 4 4" t -R 3-4 todo
+expect "todo
+ 11 11
+ 12 12" t -R -2 todo
+t -a 13 || fail "Unable to add after indexing"
+expect "todo
+ 12 12
+ 13 13" t -R 12- todo
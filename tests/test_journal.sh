@@ -0,0 +1,63 @@
+# Operations journaled instead of written are replayed over the list, and
+# folded back into it
+
+export TASUKE_JOURNAL=1
+t -a a b c || fail "Unable to add"
+t -i 2 x || fail "Unable to insert"
+t -p y || fail "Unable to prepend"
+t -d 4 || fail "Unable to delete"
+t -m 1 3 || fail "Unable to move"
+t -a z || fail "Unable to append to the journal"
+[ -f todo.log ] || fail "No journal"
+expect "a
+x
+y
+c
+z" tasks todo
+
+# Records carry text up to the end of their line
+expect_error "Task contains a newline" t -a "$(printf 'p\nq')"
+expect_error "Task contains a newline" t -i 1 "$(printf 'p\nq')"
+expect_error "Task contains a newline" t -p p "$(printf 'p\nq')"
+TASUKE_JOURNAL=0 expect_error "Task contains a newline" t -a "$(printf 'p\nq')"
+expect "a
+x
+y
+c
+z" tasks todo
+
+# A record cut short by an interrupted write is skipped
+printf 'i 1 partial' >> todo.log
+expect "a
+x
+y
+c
+z" tasks todo
+
+# Writing without the journal folds it into the file
+TASUKE_JOURNAL=0 t -d 5 || fail "Unable to delete without the journal"
+[ -f todo.log ] && fail "Journal not folded"
+expect "a
+x
+y
+c" cat todo.txt
+
+# So does a journal growing too large, after which a new one starts
+t -i 1 first || fail "Unable to insert"
+[ -f todo.log ] || fail "No journal"
+t -p $(seq 3000) || fail "Unable to prepend many tasks"
+[ -f todo.log ] && fail "Large journal not folded"
+expect "$(seq 3000; echo first; echo a; echo x; echo y; echo c)" cat todo.txt
+t -d 1-3000 || fail "Unable to delete"
+[ -f todo.log ] || fail "No new journal"
+expect "first
+a
+x
+y
+c" tasks todo
+
+# A journal for another version of the file is ignored
+t -d 1 || fail "Unable to delete"
+printf 'a\nb\n' > todo.txt
+expect "a
+b" tasks todo
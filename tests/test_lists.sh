@@ -0,0 +1,53 @@
+# Tasks survive being read from the mapping, edited and written back
+
+t -a one two three || fail "Unable to add"
+expect "one
+two
+three" cat todo.txt
+expect "one
+two
+three" tasks todo
+
+# Inserting, prepending and moving mix new tasks with mapped ones
+t -i 2 inserted || fail "Unable to insert"
+t -p first second || fail "Unable to prepend"
+t -i 7 last || fail "Unable to insert at the end"
+t -m 1 4 || fail "Unable to move"
+expect "second
+one
+inserted
+first
+two
+three
+last" cat todo.txt
+
+# Deleting positions in any order
+t -d 7 2 3 || fail "Unable to delete"
+expect "second
+first
+two
+three" cat todo.txt
+expect_error "Invalid position" t -d 5
+
+# A final line without a newline is read like the others
+printf 'a\nb\nc' > todo.txt
+expect "a
+b
+c" tasks todo
+t -i 3 x || fail "Unable to insert before the final line"
+expect "a
+b
+x
+c" cat todo.txt
+
+# Many and long tasks are written back unchanged
+long=$(head -c 100000 /dev/zero | tr '\0' l)
+t -i 1 "$long" || fail "Unable to insert a long task"
+t -p $(seq 1000) || fail "Unable to prepend many tasks"
+expect 1005 eval 'wc -l < todo.txt | tr -d " "'
+expect "1000
+$long
+a" eval 'sed -n "1000,1002p" todo.txt'
+t -d 1001 || fail "Unable to delete the long task"
+expect "1000
+a" eval 'sed -n "1000,1001p" todo.txt'
@@ -0,0 +1,74 @@
+# Commands waiting for the locks of other commands
+
+# Runs a batch reading the given commands, then the further ones once a file
+# named go exists, keeping its stdin open until a file named after it exists
+# Usage: batch NAME COMMANDS [FURTHER]
+batch() {
+    {
+        printf -- "$2"
+        until [ -f go ]; do sleep 0.05; done
+        printf -- "${3-}"
+        until [ -f "$1.done" ]; do sleep 0.05; done
+    } | t -b > /dev/null 2> "$1.err"
+}
+
+# Waits until a file isn't empty anymore, like the stderr of a batch after a
+# line with bad usage, which tells that the lines before it have run
+wait_for() {
+    tries=0
+    until [ -s "$1" ]; do
+        tries=$((tries + 1))
+        [ $tries -lt 100 ] || fail "Nothing in $1"
+        sleep 0.05
+    done
+}
+
+printf 'a\n' > todo.txt
+TASUKE_LOCK_TIMEOUT=x expect_error "Invalid TASUKE_LOCK_TIMEOUT value" t -a y
+TASUKE_LOCK_TIMEOUT=-1 expect_error "Invalid TASUKE_LOCK_TIMEOUT value" t
+
+# A batch keeps the list it modified locked until it writes it
+touch go
+batch holder '-i 1 x\n-a -d\n' &
+holder=$!
+wait_for holder.err
+
+# Others give up after the timeout, without changing anything
+export TASUKE_LOCK_TIMEOUT=0.2
+expect_error "Timed out waiting for lock" t -a y
+expect_error "Timed out waiting for lock" t todo
+expect "a" cat todo.txt
+
+# Or get the lock once the batch is done, telling how long they waited
+TASUKE_LOCK_TIMEOUT=10 TASUKE_LOCK_REPORT=1 t -a y 2> report &
+waiter=$!
+sleep 0.3
+touch holder.done
+wait $holder
+wait $waiter || fail "Unable to add after waiting"
+grep -q '^Waited [0-9]*\.[0-9]*s for exclusive lock on todo$' report ||
+    fail "Unexpected report: $(cat report)"
+expect "x
+a
+y" cat todo.txt
+
+# Two batches reading a list and then both modifying it would wait for each
+# other forever, so one of them fails
+unset TASUKE_LOCK_TIMEOUT
+rm go
+batch first 'todo\n-a -d\n' '-i 1 one\n' &
+one=$!
+batch second 'todo\n-a -d\n' '-i 1 two\n' &
+two=$!
+wait_for first.err
+wait_for second.err
+touch go
+sleep 0.3
+touch first.done second.done
+wait $one
+wait $two
+expect "Line 2: Invalid usage
+Line 2: Invalid usage
+Line 3: Unable to lock list" \
+    eval 'cat first.err second.err | grep "^Line" | sort'
+[ "$(wc -l < todo.txt)" -eq 4 ] || fail "Both or neither modified the list"
@@ -0,0 +1,13 @@
+# Lists are printed exactly like the fixture, however many are rendered at
+# once
+
+cp "$TESTS"/fixtures/print/*.txt .
+t short empty numbered wrap > out || fail "Unable to print"
+cmp -s out "$TESTS/fixtures/print.out" ||
+    fail "Output differs from fixtures/print.out: $(diff out \
+        "$TESTS/fixtures/print.out")"
+
+# Printing stops at the first list that can't be read
+t short missing wrap > out 2> err && fail "Missing list not reported"
+expect "Unable to open list" cat err
+expect "$(head -n 3 "$TESTS/fixtures/print.out")" cat out
@@ -0,0 +1,68 @@
+# Deleting ranges of positions
+
+t -a $(seq 10) || fail "Unable to add"
+t -d 2-4 3 9-10 || fail "Unable to delete overlapping ranges"
+expect "1
+5
+6
+7
+8" cat todo.txt
+
+# Invalid ranges leave the list alone
+expect_error "Invalid position" t -d 3-2
+expect_error "Invalid position" t -d 4-6
+expect_error "Position not a number" t -d 1-
+expect_error "Position not a number" t -d 1-2x
+
+# Positions below 1 don't end the ranges early
+expect_error "Position not a number" t -d -- 2 -1
+expect_error "Position not a number" t -d -- -1 3
+expect_error "Position not a number" t -d 0
+expect_error "Position not a number" t -d 2-0
+expect "1
+5
+6
+7
+8" cat todo.txt
+
+# -R prints the tasks in a range with their real positions
+rm todo.txt
+t -a $(seq 12) || fail "Unable to add"
+t -n other -a o1 o2 || fail "Unable to add to another list"
+
+check_ranges() {
+    expect "todo
+ 3 3
+ 4 4
+ 5 5" t -R 3-5 todo
+    expect "todo
+ 10 10
+ 11 11
+ 12 12" t -R 10- todo
+    expect "todo
+ 1 1
+ 2 2" t -R 2 todo
+    expect "todo
+ 11 11
+ 12 12" t -R -2 todo
+    expect "todo
+ 11 11
+ 12 12" t -R 11-20 todo
+    expect "todo" t -R 20-30 todo
+    expect "todo
+ 1 1
+
+other
+ 1 o1" t -R 1 todo other
+}
+
+check_ranges
+for range in 0 5-3 x 1-x; do
+    expect_error "Invalid range" t -R "$range" todo
+done
+
+# Ranges come out the same when there's a journal to replay
+TASUKE_JOURNAL=1 t -i 1 0 || fail "Unable to insert"
+TASUKE_JOURNAL=1 t -d 1 || fail "Unable to delete"
+[ -f todo.log ] || fail "No journal"
+check_ranges
@@ -0,0 +1,29 @@
+# Searching lists for tasks containing a pattern
+
+t -a "Buy milk" "Study for exam" "Exam results" || fail "Unable to add"
+t -n school -a "Math exam" "Homework" || fail "Unable to add"
+t -n work -a "Review" || fail "Unable to add"
+
+expect "school:1: Math exam
+todo:2: Study for exam" t -g exam
+expect "todo:2: Study for exam" t -g exam todo work
+expect "" t -g exam work
+
+# Ignoring case only applies to ASCII letters
+expect "school:1: Math exam
+todo:2: Study for exam
+todo:3: Exam results" t -g -y EXAM
+t -a "ÉTUDE" || fail "Unable to add"
+expect "" t -g -y étude
+
+# Tasks replayed from a journal are searched as well
+TASUKE_JOURNAL=1 t -p "Final exam" || fail "Unable to prepend"
+[ -f todo.log ] || fail "No journal"
+expect "school:1: Math exam
+todo:1: Final exam
+todo:3: Study for exam" t -g exam
+
+expect_error "Not enough arguments" t -g
+if t -y exam > /dev/null 2>&1; then
+    fail "Ignored case without searching"
+fi
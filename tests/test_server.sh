@@ -0,0 +1,51 @@
+# Commands handed to a server running for the directory
+
+printf 'a\nb\n' > todo.txt
+TASUKE_JOURNAL=1 "$TASUKE" -s "$DIR" -D 2> server.err &
+server=$!
+trap 'kill -CONT $server 2>/dev/null; kill $server 2>/dev/null' EXIT
+tries=0
+until [ -S .tasuke.sock ]; do
+    tries=$((tries + 1))
+    [ $tries -lt 100 ] || fail "Server not listening"
+    sleep 0.05
+done
+expect "srw-------" eval 'ls -l .tasuke.sock | cut -c 1-10'
+expect_error "Server already running" t -D
+
+# The server runs the command, printing to the client's stdout and stderr
+export TASUKE_JOURNAL=1
+kill -STOP $server
+tasks todo > out &
+client=$!
+sleep 0.2
+[ -s out ] && fail "Command not handed to the server"
+kill -CONT $server
+wait $client || fail "Unable to list through the server"
+expect "a
+b" cat out
+expect "x
+a
+b" tasks -v -i 1 x
+[ -f todo.log ] || fail "Command not run with the journal"
+t -d 9 > out 2> err && fail "Failure not reported"
+expect "Invalid position" cat err
+[ -s out ] && fail "Unexpected output"
+
+# Commands asking for other variables than the server's run directly
+TASUKE_JOURNAL=0 t -d 1 || fail "Unable to delete without the journal"
+[ -f todo.log ] && fail "Command run with the server's variables"
+expect "a
+b" cat todo.txt
+TASUKE_SYNC=file expect "y
+a
+b" tasks -v -p y
+
+# The server stops on SIGTERM and removes its socket
+kill $server
+wait $server
+[ -S .tasuke.sock ] && fail "Socket left behind"
+[ -s server.err ] && fail "Server failed: $(cat server.err)"
+expect "y
+a
+b" tasks todo
@@ -0,0 +1,60 @@
+# -S sorts a list stably, by text, ignoring case, by numbers or reversed
+
+tasks_in_order() {
+    t -r sorted > /dev/null 2>&1
+    t -n sorted -a "item 10" "Item 2" "item 2" "apple" "item 02" "Banana" \
+        "item 1" || fail "Unable to add"
+    t -n sorted -S "$@" || fail "Unable to sort by $*"
+    tasks sorted | tr '\n' '|'
+}
+
+expect "Banana|Item 2|apple|item 02|item 1|item 10|item 2|" tasks_in_order
+expect "apple|Banana|item 02|item 1|item 10|Item 2|item 2|" tasks_in_order i
+expect "Banana|Item 2|apple|item 1|item 2|item 02|item 10|" tasks_in_order n
+expect "item 2|item 10|item 1|item 02|apple|Item 2|Banana|" tasks_in_order r
+expect "apple|Banana|item 1|Item 2|item 2|item 02|item 10|" \
+    tasks_in_order in
+expect "item 10|item 2|item 02|item 1|apple|Item 2|Banana|" \
+    tasks_in_order nr
+expect "item 10|Item 2|item 2|item 02|item 1|Banana|apple|" \
+    tasks_in_order inr
+expect_error "Invalid order" t -n sorted -S x
+expect_error "Too many arguments" t -n sorted -S n n
+
+# Lists long enough to be radix sorted agree with sort(1), and numbers
+# with their values
+awk 'BEGIN {
+    x = 1
+    for (i = 0; i < 5000; ++i) {
+        x = (x * 1103515245 + 12345) % 2147483648
+        printf "%s%d %d\n", substr("aBcDeF", x % 6 + 1, 1 + x % 3), x % 97, i
+    }
+}' > input
+t -n big -a - < input || fail "Unable to add"
+t -n big -S || fail "Unable to sort"
+LC_ALL=C sort -s input > expected
+cmp -s big.txt expected || fail "Not sorted like sort(1)"
+t -n big -S r || fail "Unable to sort in reverse"
+LC_ALL=C sort -s -r input > expected
+cmp -s big.txt expected || fail "Not reversed like sort(1)"
+awk 'BEGIN {
+    for (i = 0; i < 5000; ++i) {
+        printf "task %d\n", i * 7919 % 5000 + 1
+    }
+}' | t -n numbers -a - || fail "Unable to add"
+t -n numbers -S n || fail "Unable to sort by numbers"
+seq 5000 | sed 's/^/task /' > expected
+cmp -s numbers.txt expected || fail "Numbers not sorted by value"
+
+# A journaled sort is replayed from its record, then folded
+export TASUKE_JOURNAL=1
+cp input big.txt
+t -n big -i 1 first || fail "Unable to insert"
+t -n big -S i || fail "Unable to sort into the journal"
+grep -q '^s ' big.log || fail "No sort record"
+{ echo first; cat input; } | LC_ALL=C sort -s -f > expected
+tasks big > actual
+cmp -s actual expected || fail "Sort not replayed"
+TASUKE_JOURNAL=0 t -n big -d 1 || fail "Unable to fold"
+sed 1d expected > folded
+cmp -s big.txt folded || fail "Sort not folded"
@@ -0,0 +1,35 @@
+# -a and -p read their tasks from stdin, one per line, when the only task
+# is -
+
+printf 'a\n\nb\nc' | t -a - || fail "Unable to add from stdin"
+printf 'x\ny\n' | t -p - || fail "Unable to prepend from stdin"
+expect "x
+y
+a
+b
+c" cat todo.txt
+
+# Only a lone - means stdin
+t -a - z < /dev/null || fail "Unable to add -"
+expect "-
+z" eval 'tasks todo | tail -n 2'
+
+# Input spanning several blocks, and a line longer than one
+seq 300000 | t -n many -a - || fail "Unable to add many tasks"
+seq 300000 > expected
+cmp -s many.txt expected || fail "Tasks split wrongly across blocks"
+long=$(head -c 3000000 /dev/zero | tr '\0' l)
+printf 'first\n%s\nlast\n' "$long" | t -n long -a - ||
+    fail "Unable to add a long line"
+expect "$(printf 'first\n%s\nlast\n' "$long" | cksum)" \
+    eval 't -f tsv long | cut -f 3 | cksum'
+
+# Appended tasks go into a journal and an up to date word index
+export TASUKE_JOURNAL=1 TASUKE_INDEX=1
+t -i 1 w || fail "Unable to insert"
+[ -f todo.log ] || fail "No journal"
+printf 'from journal\n' | t -a - || fail "Unable to add to the journal"
+expect "todo	9	from journal" t -f tsv -R -1 todo
+t -k word many > /dev/null || fail "Unable to build the word index"
+printf 'word\n' | t -n many -a - || fail "Unable to add to the index"
+expect "many	300001	word" t -f tsv -k word many
@@ -0,0 +1,23 @@
+# Lists that can't be mapped, like FIFOs, are read in blocks
+
+mkfifo todo.txt
+
+# Lines may be longer than a block, and the last one may lack its newline
+x=$(head -c 200000 /dev/zero | tr '\0' x)
+printf 'a\n%s\nlast' "$x" > todo.txt &
+expect "$(printf 'todo1a2%s3last' "$x" | cksum)" \
+    eval "t | tr -d ' \n' | cksum"
+wait
+
+# Lines spread over many blocks all come through, and in order
+seq 100000 > todo.txt &
+expect "100000 100000" eval 't | tail -n 1 | sed "s/^ *//"'
+wait
+seq 100000 > todo.txt &
+expect "$(seq 100000 | cksum)" eval "t | sed -e 1d -e 's/^ *[0-9]* //' | cksum"
+wait
+
+# So may empty lines, without ending the list early
+printf 'a\n\n\nb\n' > todo.txt &
+expect "4" eval "t | sed 1d | wc -l | tr -d ' '"
+wait
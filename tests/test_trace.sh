@@ -0,0 +1,27 @@
+# The trace counts what writing a list does
+
+t -a $(seq 1000) || fail "Unable to add"
+
+# Prints a counter of the write phase from the trace on stdin
+# Usage: write_phase GROUP NAME
+write_phase() {
+    sed -n 's/.*"write":{"calls":[0-9]*,"ns":[0-9]*,\([^}]*}[^}]*}\).*/\1/p' |
+        sed -n "s/.*\"$1\":{[^}]*\"$2\":\([0-9]*\).*/\1/p"
+}
+
+# Replacing the list writes it as a whole, in a single writev
+TASUKE_TRACE=json t -d 1 2> trace.json || fail "Unable to delete"
+[ "$(wc -l < trace.json)" -eq 1 ] || fail "Not a single line"
+size=$(wc -c < todo.txt | tr -d ' ')
+expect "$size" eval 'write_phase bytes written < trace.json'
+expect "1" eval 'write_phase syscalls write < trace.json'
+expect "1" eval 'write_phase syscalls rename < trace.json'
+
+# Deleting the last task in place only truncates the file
+TASUKE_IN_PLACE=1 TASUKE_TRACE=json TASUKE_TRACE_FILE=trace.json t -d 999 ||
+    fail "Unable to delete in place"
+[ "$(wc -l < trace.json)" -eq 2 ] || fail "Not appended to the trace file"
+tail -n 1 trace.json > last.json
+expect "0" eval 'write_phase bytes written < last.json'
+expect "1" eval 'write_phase syscalls ftruncate < last.json'
+expect "0" eval 'write_phase syscalls rename < last.json'
@@ -0,0 +1,50 @@
+# Looking up words through the word index, which follows every modification
+
+# Checks that looking up a word gives the expected matches without
+# rebuilding the index, since modifying the list kept it up to date
+# Usage: lookup EXPECTED WORD [LIST]...
+lookup() {
+    expected=$1
+    shift
+    before=$(cksum < todo.words)
+    expect "$expected" t -k "$@"
+    [ "$(cksum < todo.words)" = "$before" ] || fail "Index rebuilt for $*"
+}
+
+for journal in 0 1; do
+    export TASUKE_JOURNAL=$journal
+    rm -f todo.txt todo.log todo.words
+    t -a "Buy milk" "Milky way" "Study for the exam" || fail "Unable to add"
+
+    # The first lookup builds the index
+    expect "todo:1: Buy milk" t -k milk
+    [ -f todo.words ] || fail "No index"
+    lookup "todo:1: Buy milk
+todo:2: Milky way" "MILK*"
+
+    t -i 2 "Milk the cow" || fail "Unable to insert"
+    lookup "todo:1: Buy milk
+todo:2: Milk the cow" milk
+    t -a "Exam results" "Oat milk" || fail "Unable to append"
+    lookup "todo:1: Buy milk
+todo:2: Milk the cow
+todo:6: Oat milk" milk
+    t -d 1 || fail "Unable to delete"
+    lookup "todo:1: Milk the cow
+todo:5: Oat milk" milk
+    t -m 5 1 || fail "Unable to move"
+    lookup "todo:1: Oat milk
+todo:2: Milk the cow" milk
+    lookup "todo:4: Study for the exam
+todo:5: Exam results" exam
+    lookup "todo:2: Milk the cow" cow todo
+done
+
+# Changing the list some other way makes the next lookup rebuild the index
+unset TASUKE_JOURNAL
+rm -f todo.txt todo.log todo.words
+t -a "Milk the cow" || fail "Unable to add"
+expect "todo:1: Milk the cow" t -k cow
+printf 'Cow bell\n' >> todo.txt
+expect "todo:1: Milk the cow
+todo:2: Cow bell" t -k cow
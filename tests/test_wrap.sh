@@ -0,0 +1,22 @@
+# Tasks are wrapped by the columns their characters take, at 80 columns when
+# not printing to a terminal
+
+cp "$TESTS/fixtures/wrap/wrap.txt" .
+t wrap > out || fail "Unable to print"
+cmp -s out "$TESTS/fixtures/wrap.out" ||
+    fail "Output differs from fixtures/wrap.out: $(diff out \
+        "$TESTS/fixtures/wrap.out")"
+
+# On a terminal leaving a single column for the text, every wide character
+# takes a line of its own, and so does everything after them
+command -v script > /dev/null || exit 0
+printf '%s\n' '漢字 ab' > todo.txt
+script -qc "stty cols 4; '$TASUKE' -s '$DIR'" /dev/null > out ||
+    fail "Unable to print on a terminal"
+esc=$(printf '\033')
+cr=$(printf '\r')
+expect "todo
+ 1 漢
+   字
+   a
+   b" sed -e "s/$esc\[[0-9]*m//g" -e "s/$cr\$//" out
@@ -0,0 +1,51 @@
+# Writing lists back, by replacing them or rewriting what changed in place
+
+inode() {
+    ls -i "$1" | awk '{print $1}'
+}
+
+t -a $(seq 100) || fail "Unable to add"
+chmod 640 todo.txt
+
+# By default the file is replaced, keeping its permissions
+before=$(inode todo.txt)
+t -d 100 || fail "Unable to delete"
+[ "$(inode todo.txt)" != "$before" ] || fail "List rewritten in place"
+expect "-rw-r-----" eval 'ls -l todo.txt | cut -c 1-10'
+expect "$(seq 99)" cat todo.txt
+for sync in none file dir; do
+    TASUKE_SYNC=$sync t -d 1 || fail "Unable to delete with $sync"
+done
+expect "$(seq 4 99)" cat todo.txt
+TASUKE_SYNC=all expect_error "Invalid TASUKE_SYNC value" t -d 1
+expect "$(seq 4 99)" cat todo.txt
+
+# On request, the file is rewritten in place from the first changed task on
+export TASUKE_IN_PLACE=1
+seq 100 > todo.txt
+before=$(inode todo.txt)
+t -d 50-100 || fail "Unable to delete the suffix"
+t -i 10 ten || fail "Unable to insert"
+t -i 51 last || fail "Unable to insert at the end"
+expect "$before" inode todo.txt
+expect "$(seq 9; echo ten; seq 10 49; echo last)" cat todo.txt
+
+# Changing the first task rewrites everything
+t -m 1 51 || fail "Unable to move"
+expect "$(seq 2 9; echo ten; seq 10 49; echo last; echo 1)" cat todo.txt
+
+# Durability can't be had in place
+before=$(inode todo.txt)
+TASUKE_SYNC=file t -d 51 || fail "Unable to delete with file"
+[ "$(inode todo.txt)" != "$before" ] || fail "List synced in place"
+before=$(inode todo.txt)
+TASUKE_IN_PLACE=0 t -d 50 || fail "Unable to delete with in place off"
+[ "$(inode todo.txt)" != "$before" ] || fail "List rewritten in place"
+
+# A final line without a newline gets its newline back
+printf 'a\nb' > todo.txt
+t -i 3 c || fail "Unable to insert after the final line"
+expect "a
+b
+c" cat todo.txt
+expect 6 eval 'wc -c < todo.txt | tr -d " "'
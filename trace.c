@@ -0,0 +1,421 @@
+/* Using clock_gettime, strdup, strndup & mkstemp, need POSIX 2008 */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "trace.h"
+
+/* Largest report, which has room for every phase */
+#define REPORT_SIZE 16384
+
+/* What a phase took, over all the times it was entered */
+struct phase {
+    long calls;
+    long ns;
+    long counters[TRACE_COUNTERS];
+};
+
+/* A report being formatted */
+struct report {
+    char data[REPORT_SIZE];
+    size_t length;
+};
+
+static const char *phase_names[TRACE_PHASES] = {
+    "dir", "forward", "lock", "read", "modify", "write", "render", "print",
+    "search", "catalog"
+};
+
+/* The JSON object every counter is reported in, and its name there */
+static const char *counter_names[TRACE_COUNTERS][2] = {
+    {"syscalls", "open"}, {"syscalls", "close"}, {"syscalls", "read"},
+    {"syscalls", "write"}, {"syscalls", "fsync"}, {"syscalls", "mmap"},
+    {"syscalls", "munmap"}, {"syscalls", "rename"}, {"syscalls", "unlink"},
+    {"syscalls", "ftruncate"}, {"syscalls", "stat"}, {"syscalls", "fcntl"},
+    {"bytes", "read"}, {"bytes", "written"}, {"bytes", "mapped"},
+    {"allocations", "malloc"}, {"allocations", "realloc"},
+    {"allocations", "free"}, {"allocations", "bytes"}
+};
+
+// Whether tracing was asked for (0 = false, 1 = true)
+static int tracing = 0;
+// The command reported when the program exits
+static int exit_option = 0;
+static struct timespec start;
+static atomic_long counters[TRACE_COUNTERS];
+static struct phase phases[TRACE_PHASES];
+static pthread_mutex_t phases_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Private helper functions
+ */
+
+/**
+ * Returns the nanoseconds from one point in time to another.
+ *
+ * @param from The earlier point in time
+ * @param to The later point in time
+ * @return Nanoseconds in between
+ */
+static long ns_between(const struct timespec *from, const struct timespec *to) {
+    return (to->tv_sec - from->tv_sec) * 1000000000L +
+        (to->tv_nsec - from->tv_nsec);
+}
+
+/**
+ * Appends formatted text to a report, cutting it off when it's full.
+ *
+ * @param report The report
+ * @param format printf-style format
+ * @param ... Arguments for the format
+ */
+static void put(struct report *report, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    size_t room = REPORT_SIZE - report->length;
+    int length = vsnprintf(report->data + report->length, room, format, args);
+    va_end(args);
+    if (length > 0) {
+        report->length += (size_t) length < room ? (size_t) length : room - 1;
+    }
+}
+
+/**
+ * Appends counters to a report, as one JSON object per group of counters.
+ *
+ * @param report The report
+ * @param values The counters
+ */
+static void put_counters(struct report *report, const long *values) {
+    for (int i = 0; i < TRACE_COUNTERS; ++i) {
+        // Every group starts with its first counter
+        if (i == 0 || strcmp(counter_names[i][0], counter_names[i - 1][0])) {
+            put(report, "%s\"%s\":{", i == 0 ? "" : "},", counter_names[i][0]);
+        } else {
+            put(report, ",");
+        }
+        put(report, "\"%s\":%ld", counter_names[i][1], values[i]);
+    }
+    put(report, "}");
+}
+
+/**
+ * Reports at exit what's left to report.
+ */
+static void report_exit(void) {
+    trace_report(exit_option);
+}
+
+/*
+ * Public functions
+ */
+
+void trace_init(int option) {
+    const char *value = getenv("TASUKE_TRACE");
+    if (value == NULL || strcmp(value, "json") != 0) {
+        return;
+    }
+    exit_option = option;
+    tracing = 1;
+    trace_reset();
+    atexit(report_exit);
+}
+
+void trace_begin(struct trace_mark *mark) {
+    if (!tracing) {
+        return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &mark->start);
+    for (int i = 0; i < TRACE_COUNTERS; ++i) {
+        mark->counters[i] = atomic_load(&counters[i]);
+    }
+}
+
+void trace_end(enum trace_phase phase, const struct trace_mark *mark) {
+    if (!tracing) {
+        return;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    pthread_mutex_lock(&phases_mutex);
+    ++phases[phase].calls;
+    phases[phase].ns += ns_between(&mark->start, &now);
+    for (int i = 0; i < TRACE_COUNTERS; ++i) {
+        phases[phase].counters[i] +=
+            atomic_load(&counters[i]) - mark->counters[i];
+    }
+    pthread_mutex_unlock(&phases_mutex);
+}
+
+void trace_report(int option) {
+    if (!tracing) {
+        return;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long totals[TRACE_COUNTERS];
+    for (int i = 0; i < TRACE_COUNTERS; ++i) {
+        totals[i] = atomic_load(&counters[i]);
+    }
+
+    // A single line, so reports of several processes can share a file
+    static struct report report;
+    report.length = 0;
+    // Commands are named by their option, listing has none
+    char name[3] = {'-', option, '\0'};
+    put(&report, "{\"command\":\"%s\",\"pid\":%ld,\"ns\":%ld,",
+        option ? name : "", (long) getpid(), ns_between(&start, &now));
+    put_counters(&report, totals);
+    put(&report, ",\"phases\":{");
+    pthread_mutex_lock(&phases_mutex);
+    int first = 1;
+    for (int i = 0; i < TRACE_PHASES; ++i) {
+        if (phases[i].calls == 0) {
+            continue;
+        }
+        put(&report, "%s\"%s\":{\"calls\":%ld,\"ns\":%ld,", first ? "" : ",",
+            phase_names[i], phases[i].calls, phases[i].ns);
+        put_counters(&report, phases[i].counters);
+        put(&report, "}");
+        first = 0;
+    }
+    pthread_mutex_unlock(&phases_mutex);
+    put(&report, "}}\n");
+
+    // Write it in one go, appending to the file if there is one
+    const char *path = getenv("TASUKE_TRACE_FILE");
+    int fd = path && *path ?
+        open(path, O_WRONLY | O_APPEND | O_CREAT, 0666) : STDERR_FILENO;
+    if (fd != -1) {
+        if (write(fd, report.data, report.length) == -1) {
+            // Nothing else to do about it, tracing mustn't get in the way
+        }
+        if (fd != STDERR_FILENO) {
+            close(fd);
+        }
+    }
+    trace_reset();
+}
+
+void trace_reset(void) {
+    if (!tracing) {
+        return;
+    }
+    pthread_mutex_lock(&phases_mutex);
+    memset(phases, 0, sizeof(phases));
+    pthread_mutex_unlock(&phases_mutex);
+    for (int i = 0; i < TRACE_COUNTERS; ++i) {
+        atomic_store(&counters[i], 0);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+}
+
+#ifdef TRACE_WRAP
+/*
+ * Counting wrappers, which the linker substitutes for the originals in
+ * every call made by tasuke itself (but not inside the C library)
+ */
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+char *__real_strdup(const char *s);
+char *__real_strndup(const char *s, size_t n);
+int __real_open(const char *path, int flags, ...);
+int __real_mkstemp(char *template);
+int __real_close(int fd);
+ssize_t __real_read(int fd, void *buf, size_t count);
+ssize_t __real_write(int fd, const void *buf, size_t count);
+ssize_t __real_writev(int fd, const struct iovec *iov, int iovcnt);
+ssize_t __real_pread(int fd, void *buf, size_t count, off_t offset);
+ssize_t __real_pwrite(int fd, const void *buf, size_t count, off_t offset);
+int __real_fsync(int fd);
+void *__real_mmap(
+    void *addr, size_t length, int prot, int flags, int fd, off_t offset);
+int __real_munmap(void *addr, size_t length);
+int __real_rename(const char *old, const char *new);
+int __real_unlink(const char *path);
+int __real_ftruncate(int fd, off_t length);
+int __real_stat(const char *path, struct stat *st);
+int __real_fstat(int fd, struct stat *st);
+int __real_fcntl(int fd, int command, ...);
+size_t __real_fwrite(const void *ptr, size_t size, size_t n, FILE *stream);
+
+/**
+ * Adds to a counter, if tracing.
+ *
+ * @param counter The counter
+ * @param n The amount to add
+ */
+static void count(enum trace_counter counter, long n) {
+    if (tracing) {
+        atomic_fetch_add_explicit(&counters[counter], n, memory_order_relaxed);
+    }
+}
+
+void *__wrap_malloc(size_t size) {
+    count(TRACE_MALLOCS, 1);
+    count(TRACE_BYTES_ALLOCATED, size);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+    count(TRACE_MALLOCS, 1);
+    count(TRACE_BYTES_ALLOCATED, n * size);
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    count(ptr ? TRACE_REALLOCS : TRACE_MALLOCS, 1);
+    count(TRACE_BYTES_ALLOCATED, size);
+    return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void *ptr) {
+    if (ptr) {
+        count(TRACE_FREES, 1);
+    }
+    __real_free(ptr);
+}
+
+char *__wrap_strdup(const char *s) {
+    count(TRACE_MALLOCS, 1);
+    count(TRACE_BYTES_ALLOCATED, strlen(s) + 1);
+    return __real_strdup(s);
+}
+
+char *__wrap_strndup(const char *s, size_t n) {
+    count(TRACE_MALLOCS, 1);
+    count(TRACE_BYTES_ALLOCATED, strnlen(s, n) + 1);
+    return __real_strndup(s, n);
+}
+
+int __wrap_open(const char *path, int flags, ...) {
+    // The mode is only passed along when a file may be created
+    int mode = 0;
+    if (flags & O_CREAT) {
+        va_list args;
+        va_start(args, flags);
+        mode = va_arg(args, int);
+        va_end(args);
+    }
+    count(TRACE_OPENS, 1);
+    return __real_open(path, flags, mode);
+}
+
+int __wrap_mkstemp(char *template) {
+    count(TRACE_OPENS, 1);
+    return __real_mkstemp(template);
+}
+
+int __wrap_close(int fd) {
+    count(TRACE_CLOSES, 1);
+    return __real_close(fd);
+}
+
+ssize_t __wrap_read(int fd, void *buf, size_t n) {
+    ssize_t got = __real_read(fd, buf, n);
+    count(TRACE_READS, 1);
+    count(TRACE_BYTES_READ, got > 0 ? got : 0);
+    return got;
+}
+
+ssize_t __wrap_write(int fd, const void *buf, size_t n) {
+    ssize_t written = __real_write(fd, buf, n);
+    count(TRACE_WRITES, 1);
+    count(TRACE_BYTES_WRITTEN, written > 0 ? written : 0);
+    return written;
+}
+
+ssize_t __wrap_writev(int fd, const struct iovec *iov, int iovcnt) {
+    ssize_t written = __real_writev(fd, iov, iovcnt);
+    count(TRACE_WRITES, 1);
+    count(TRACE_BYTES_WRITTEN, written > 0 ? written : 0);
+    return written;
+}
+
+ssize_t __wrap_pread(int fd, void *buf, size_t n, off_t offset) {
+    ssize_t got = __real_pread(fd, buf, n, offset);
+    count(TRACE_READS, 1);
+    count(TRACE_BYTES_READ, got > 0 ? got : 0);
+    return got;
+}
+
+ssize_t __wrap_pwrite(int fd, const void *buf, size_t n, off_t offset) {
+    ssize_t written = __real_pwrite(fd, buf, n, offset);
+    count(TRACE_WRITES, 1);
+    count(TRACE_BYTES_WRITTEN, written > 0 ? written : 0);
+    return written;
+}
+
+int __wrap_fsync(int fd) {
+    count(TRACE_SYNCS, 1);
+    return __real_fsync(fd);
+}
+
+void *__wrap_mmap(
+    void *addr, size_t length, int prot, int flags, int fd, off_t offset) {
+    void *map = __real_mmap(addr, length, prot, flags, fd, offset);
+    count(TRACE_MAPS, 1);
+    count(TRACE_BYTES_MAPPED, map != MAP_FAILED ? (long) length : 0);
+    return map;
+}
+
+int __wrap_munmap(void *addr, size_t length) {
+    count(TRACE_UNMAPS, 1);
+    return __real_munmap(addr, length);
+}
+
+int __wrap_rename(const char *old, const char *new) {
+    count(TRACE_RENAMES, 1);
+    return __real_rename(old, new);
+}
+
+int __wrap_unlink(const char *path) {
+    count(TRACE_UNLINKS, 1);
+    return __real_unlink(path);
+}
+
+int __wrap_ftruncate(int fd, off_t length) {
+    count(TRACE_TRUNCATES, 1);
+    return __real_ftruncate(fd, length);
+}
+
+int __wrap_stat(const char *path, struct stat *st) {
+    count(TRACE_STATS, 1);
+    return __real_stat(path, st);
+}
+
+int __wrap_fstat(int fd, struct stat *st) {
+    count(TRACE_STATS, 1);
+    return __real_fstat(fd, st);
+}
+
+int __wrap_fcntl(int fd, int command, ...) {
+    // Whatever argument the command takes is passed along as it came, the
+    // way the C library itself forwards it
+    va_list args;
+    va_start(args, command);
+    void *argument = va_arg(args, void *);
+    va_end(args);
+    count(TRACE_FCNTLS, 1);
+    return __real_fcntl(fd, command, argument);
+}
+
+size_t __wrap_fwrite(const void *ptr, size_t size, size_t n, FILE *stream) {
+    // Buffered output isn't a system call of its own, but it's written
+    size_t written = __real_fwrite(ptr, size, n, stream);
+    count(TRACE_BYTES_WRITTEN, written * size);
+    return written;
+}
+#endif // TRACE_WRAP
@@ -0,0 +1,94 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <time.h>
+
+/* The phases a command spends its time in, which may be nested */
+enum trace_phase {
+    TRACE_DIR,
+    TRACE_FORWARD,
+    TRACE_LOCK,
+    TRACE_READ,
+    TRACE_MODIFY,
+    TRACE_WRITE,
+    TRACE_RENDER,
+    TRACE_PRINT,
+    TRACE_SEARCH,
+    TRACE_CATALOG,
+    TRACE_PHASES
+};
+
+/* What is counted, both in total and for every phase */
+enum trace_counter {
+    TRACE_OPENS,
+    TRACE_CLOSES,
+    TRACE_READS,
+    TRACE_WRITES,
+    TRACE_SYNCS,
+    TRACE_MAPS,
+    TRACE_UNMAPS,
+    TRACE_RENAMES,
+    TRACE_UNLINKS,
+    TRACE_TRUNCATES,
+    TRACE_STATS,
+    TRACE_FCNTLS,
+    TRACE_BYTES_READ,
+    TRACE_BYTES_WRITTEN,
+    TRACE_BYTES_MAPPED,
+    TRACE_MALLOCS,
+    TRACE_REALLOCS,
+    TRACE_FREES,
+    TRACE_BYTES_ALLOCATED,
+    TRACE_COUNTERS
+};
+
+/* Where a phase started, to be handed back when it ends */
+struct trace_mark {
+    struct timespec start;
+    long counters[TRACE_COUNTERS];
+};
+
+/**
+ * Starts tracing if the TASUKE_TRACE environment variable asks for it.
+ *
+ * The only format is "json", which reports every command as a single line
+ * of JSON, either on stderr or appended to the file TASUKE_TRACE_FILE.
+ * The command is reported when the program exits, unless it's reported
+ * before.
+ *
+ * @param option The option selecting the command, or 0 for none
+ */
+void trace_init(int option);
+
+/**
+ * Marks the start of a phase.
+ *
+ * @param mark The mark to fill in
+ */
+void trace_begin(struct trace_mark *mark);
+
+/**
+ * Marks the end of a phase, adding its time and counters to the phase.
+ *
+ * Phases can be entered any number of times and from several threads at
+ * once. Whatever the other threads do in the meantime is counted as well.
+ *
+ * @param phase The phase that ended
+ * @param mark The mark from when it started
+ */
+void trace_end(enum trace_phase phase, const struct trace_mark *mark);
+
+/**
+ * Reports everything traced since tracing started or was last reset, then
+ * resets it.
+ *
+ * @param option The option selecting the command, or 0 for none
+ */
+void trace_report(int option);
+
+/**
+ * Forgets everything traced so far, starting over.
+ */
+void trace_reset(void);
+
+#endif // TRACE_H
@@ -0,0 +1,189 @@
+#include <stdint.h>
+#include <string.h>
+#include "width.h"
+
+/* A range of code points (both inclusive) */
+struct range {
+    uint32_t first;
+    uint32_t last;
+};
+
+/*
+ * Characters that take no columns, mostly combining marks that are drawn
+ * over the previous character, along with invisible formatting characters.
+ */
+static const struct range zero_width[] = {
+    {0x0300, 0x036F}, {0x0483, 0x0489}, {0x0591, 0x05BD}, {0x05BF, 0x05BF},
+    {0x05C1, 0x05C2}, {0x05C4, 0x05C5}, {0x05C7, 0x05C7}, {0x0610, 0x061A},
+    {0x064B, 0x065F}, {0x0670, 0x0670}, {0x06D6, 0x06DC}, {0x06DF, 0x06E4},
+    {0x06E7, 0x06E8}, {0x06EA, 0x06ED}, {0x0711, 0x0711}, {0x0730, 0x074A},
+    {0x07A6, 0x07B0}, {0x07EB, 0x07F3}, {0x0816, 0x082D}, {0x0859, 0x085B},
+    {0x08D3, 0x0902}, {0x093A, 0x093A}, {0x093C, 0x093C}, {0x0941, 0x0948},
+    {0x094D, 0x094D}, {0x0951, 0x0957}, {0x0962, 0x0963}, {0x0981, 0x0981},
+    {0x09BC, 0x09BC}, {0x09C1, 0x09C4}, {0x09CD, 0x09CD}, {0x09E2, 0x09E3},
+    {0x0A01, 0x0A02}, {0x0A3C, 0x0A3C}, {0x0A41, 0x0A51}, {0x0A70, 0x0A71},
+    {0x0A81, 0x0A82}, {0x0ABC, 0x0ABC}, {0x0AC1, 0x0AC8}, {0x0ACD, 0x0ACD},
+    {0x0B01, 0x0B01}, {0x0B3C, 0x0B3C}, {0x0B3F, 0x0B3F}, {0x0B41, 0x0B44},
+    {0x0B4D, 0x0B4D}, {0x0BC0, 0x0BC0}, {0x0BCD, 0x0BCD}, {0x0C3E, 0x0C40},
+    {0x0C46, 0x0C56}, {0x0CBC, 0x0CBC}, {0x0CCC, 0x0CCD}, {0x0D41, 0x0D44},
+    {0x0D4D, 0x0D4D}, {0x0DCA, 0x0DCA}, {0x0DD2, 0x0DD6}, {0x0E31, 0x0E31},
+    {0x0E34, 0x0E3A}, {0x0E47, 0x0E4E}, {0x0EB1, 0x0EB1}, {0x0EB4, 0x0EBC},
+    {0x0EC8, 0x0ECD}, {0x0F18, 0x0F19}, {0x0F35, 0x0F35}, {0x0F37, 0x0F37},
+    {0x0F39, 0x0F39}, {0x0F71, 0x0F7E}, {0x0F80, 0x0F84}, {0x0F86, 0x0F87},
+    {0x0F8D, 0x0FBC}, {0x102D, 0x1030}, {0x1032, 0x1037}, {0x1039, 0x103A},
+    {0x1160, 0x11FF}, {0x135D, 0x135F}, {0x1712, 0x1714}, {0x17B4, 0x17B5},
+    {0x17B7, 0x17BD}, {0x17C6, 0x17C6}, {0x17C9, 0x17D3}, {0x180B, 0x180E},
+    {0x1AB0, 0x1AFF}, {0x1DC0, 0x1DFF}, {0x200B, 0x200F}, {0x202A, 0x202E},
+    {0x2060, 0x2064}, {0x20D0, 0x20F0}, {0x2CEF, 0x2CF1}, {0x2DE0, 0x2DFF},
+    {0x302A, 0x302D}, {0x3099, 0x309A}, {0xA66F, 0xA672}, {0xA674, 0xA67D},
+    {0xA69E, 0xA69F}, {0xA6F0, 0xA6F1}, {0xA8E0, 0xA8F1}, {0xFB1E, 0xFB1E},
+    {0xFE00, 0xFE0F}, {0xFE20, 0xFE2F}, {0xFEFF, 0xFEFF}, {0x1D167, 0x1D169},
+    {0x1D17B, 0x1D182}, {0x1F3FB, 0x1F3FF}, {0xE0001, 0xE007F},
+    {0xE0100, 0xE01EF}
+};
+
+/*
+ * Characters that take two columns, East Asian wide and fullwidth ones as
+ * well as emoji that are displayed as such by default.
+ */
+static const struct range double_width[] = {
+    {0x1100, 0x115F}, {0x231A, 0x231B}, {0x2329, 0x232A}, {0x23E9, 0x23EC},
+    {0x23F0, 0x23F0}, {0x23F3, 0x23F3}, {0x25FD, 0x25FE}, {0x2614, 0x2615},
+    {0x2648, 0x2653}, {0x267F, 0x267F}, {0x2693, 0x2693}, {0x26A1, 0x26A1},
+    {0x26AA, 0x26AB}, {0x26BD, 0x26BE}, {0x26C4, 0x26C5}, {0x26CE, 0x26CE},
+    {0x26D4, 0x26D4}, {0x26EA, 0x26EA}, {0x26F2, 0x26F3}, {0x26F5, 0x26F5},
+    {0x26FA, 0x26FA}, {0x26FD, 0x26FD}, {0x2705, 0x2705}, {0x270A, 0x270B},
+    {0x2728, 0x2728}, {0x274C, 0x274C}, {0x274E, 0x274E}, {0x2753, 0x2755},
+    {0x2757, 0x2757}, {0x2795, 0x2797}, {0x27B0, 0x27B0}, {0x27BF, 0x27BF},
+    {0x2B1B, 0x2B1C}, {0x2B50, 0x2B50}, {0x2B55, 0x2B55}, {0x2E80, 0x303E},
+    {0x3041, 0x33FF}, {0x3400, 0x4DBF}, {0x4E00, 0x9FFF}, {0xA000, 0xA4CF},
+    {0xA960, 0xA97F}, {0xAC00, 0xD7A3}, {0xF900, 0xFAFF}, {0xFE10, 0xFE19},
+    {0xFE30, 0xFE6F}, {0xFF00, 0xFF60}, {0xFFE0, 0xFFE6}, {0x16FE0, 0x16FE4},
+    {0x17000, 0x18AFF}, {0x1B000, 0x1B2FF}, {0x1F004, 0x1F004},
+    {0x1F0CF, 0x1F0CF}, {0x1F18E, 0x1F18E}, {0x1F191, 0x1F19A},
+    {0x1F200, 0x1F202}, {0x1F210, 0x1F23B}, {0x1F240, 0x1F248},
+    {0x1F250, 0x1F251}, {0x1F260, 0x1F265}, {0x1F300, 0x1F320},
+    {0x1F32D, 0x1F335}, {0x1F337, 0x1F37C}, {0x1F37E, 0x1F393},
+    {0x1F3A0, 0x1F3CA}, {0x1F3CF, 0x1F3D3}, {0x1F3E0, 0x1F3F0},
+    {0x1F3F4, 0x1F3F4}, {0x1F3F8, 0x1F43E}, {0x1F440, 0x1F440},
+    {0x1F442, 0x1F4FC}, {0x1F4FF, 0x1F53D}, {0x1F54B, 0x1F54E},
+    {0x1F550, 0x1F567}, {0x1F57A, 0x1F57A}, {0x1F595, 0x1F596},
+    {0x1F5A4, 0x1F5A4}, {0x1F5FB, 0x1F64F}, {0x1F680, 0x1F6C5},
+    {0x1F6CC, 0x1F6CC}, {0x1F6D0, 0x1F6D2}, {0x1F6D5, 0x1F6D7},
+    {0x1F6EB, 0x1F6EC}, {0x1F6F4, 0x1F6FC}, {0x1F7E0, 0x1F7EB},
+    {0x1F90C, 0x1F93A}, {0x1F93C, 0x1F945}, {0x1F947, 0x1F9FF},
+    {0x1FA70, 0x1FAFF}, {0x20000, 0x2FFFD}, {0x30000, 0x3FFFD}
+};
+
+/**
+ * Checks whether a code point is in a table of ranges.
+ *
+ * @param table The ranges, sorted and not overlapping
+ * @param count Number of ranges
+ * @param code_point The code point to look for
+ * @return 1 if it is in one of the ranges, 0 otherwise
+ */
+static int in_table(
+    const struct range *table, size_t count, uint32_t code_point) {
+    // Binary search for the range that could contain it
+    size_t low = 0, high = count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (code_point > table[middle].last) {
+            low = middle + 1;
+        } else if (code_point < table[middle].first) {
+            high = middle;
+        } else {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Returns the number of columns a code point takes.
+ *
+ * @param code_point The code point (not ASCII)
+ * @return 0, 1 or 2
+ */
+static int code_point_width(uint32_t code_point) {
+    if (in_table(zero_width, sizeof(zero_width) / sizeof(*zero_width),
+        code_point)) {
+        return 0;
+    }
+    if (in_table(double_width, sizeof(double_width) / sizeof(*double_width),
+        code_point)) {
+        return 2;
+    }
+
+    return 1;
+}
+
+size_t width_ascii(const char *s, size_t n) {
+    size_t i = 0;
+    // Check eight bytes at once for any with the high bit set
+    for ( ; i + 8 <= n; i += 8) {
+        uint64_t word;
+        memcpy(&word, s + i, 8);
+        if (word & UINT64_C(0x8080808080808080)) {
+            break;
+        }
+    }
+    // Find the exact position in what's left
+    while (i < n && !(s[i] & 0x80)) {
+        ++i;
+    }
+
+    return i;
+}
+
+const char *width_decode(const char *s, const char *end, int *columns) {
+    const unsigned char *u = (const unsigned char *) s;
+    size_t available = end - s;
+    uint32_t code_point = 0;
+    size_t length;
+    // Determine the length from the first byte, along with the range the
+    // second one needs to be in to rule out overlong forms and surrogates
+    unsigned char low = 0x80, high = 0xBF;
+    if (u[0] < 0x80) {
+        *columns = 1;
+        return s + 1;
+    } else if (u[0] >= 0xC2 && u[0] <= 0xDF) {
+        length = 2;
+        code_point = u[0] & 0x1F;
+    } else if (u[0] >= 0xE0 && u[0] <= 0xEF) {
+        length = 3;
+        code_point = u[0] & 0x0F;
+        low = u[0] == 0xE0 ? 0xA0 : 0x80;
+        high = u[0] == 0xED ? 0x9F : 0xBF;
+    } else if (u[0] >= 0xF0 && u[0] <= 0xF4) {
+        length = 4;
+        code_point = u[0] & 0x07;
+        low = u[0] == 0xF0 ? 0x90 : 0x80;
+        high = u[0] == 0xF4 ? 0x8F : 0xBF;
+    } else {
+        length = 0;
+    }
+
+    // Collect the continuation bytes
+    if (length > available || (length > 0 && (u[1] < low || u[1] > high))) {
+        length = 0;
+    }
+    for (size_t i = 1; i < length; ++i) {
+        if ((u[i] & 0xC0) != 0x80) {
+            length = 0;
+            break;
+        }
+        code_point = (code_point << 6) | (u[i] & 0x3F);
+    }
+
+    // An invalid byte stands for itself
+    if (length == 0) {
+        *columns = 1;
+        return s + 1;
+    }
+    *columns = code_point_width(code_point);
+
+    return s + length;
+}
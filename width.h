@@ -0,0 +1,32 @@
+#ifndef WIDTH_H
+#define WIDTH_H
+
+#include <stddef.h>
+
+/**
+ * Returns how many bytes at the start of a string are ASCII.
+ *
+ * Checks several bytes at a time, so text that is mostly ASCII can be
+ * measured quickly. Every ASCII byte takes a single column.
+ *
+ * @param s The string (doesn't need to be terminated)
+ * @param n Length of the string
+ * @return Number of leading ASCII bytes
+ */
+size_t width_ascii(const char *s, size_t n);
+
+/**
+ * Decodes a UTF-8 character and measures how many columns it takes.
+ *
+ * Combining characters take no columns and East Asian wide characters two.
+ * Bytes that don't form a valid character are treated as a single column
+ * each, like ASCII.
+ *
+ * @param s The character (doesn't need to be terminated)
+ * @param end End of the string the character is in (exclusive)
+ * @param columns Set to the number of columns
+ * @return Pointer to the byte after the character
+ */
+const char *width_decode(const char *s, const char *end, int *columns);
+
+#endif // WIDTH_H
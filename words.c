@@ -0,0 +1,584 @@
+#include <stdlib.h>
+#include <string.h>
+#include "words.h"
+
+#define STARTING_CAPACITY 64
+
+/*
+ * A word table starts with this header, followed by the entries sorted by
+ * their word, the positions of all entries one after another and finally
+ * the text of the words.
+ */
+struct table_header {
+    uint64_t words;
+    uint64_t postings;
+    uint64_t text_size;
+};
+
+/* A word in the table */
+struct table_entry {
+    // Offset and length of the word in the text
+    uint32_t text;
+    uint32_t length;
+    // Index of its first position and number of positions
+    uint32_t first;
+    uint32_t count;
+};
+
+/*
+ * A word while building, whose positions form a chain of postings.
+ */
+struct word {
+    uint32_t hash;
+    uint32_t text;
+    uint32_t length;
+    uint32_t count;
+    // Indices of the first and last posting of the chain
+    uint32_t first;
+    uint32_t last;
+};
+
+/* A position in the chain of a word */
+struct posting {
+    uint32_t position;
+    uint32_t next;
+};
+
+/* A word along with its text, for sorting */
+struct sorted_word {
+    const char *text;
+    const struct word *word;
+};
+
+struct words_builder {
+    // The words, found through a hash table of their indices + 1
+    struct word *words;
+    uint32_t length;
+    uint32_t size;
+    uint32_t *slots;
+    uint32_t slot_count;
+    struct posting *postings;
+    uint32_t posting_count;
+    uint32_t posting_size;
+    // The text of all words, folded to lowercase
+    char *text;
+    size_t text_length;
+    size_t text_size;
+};
+
+/*
+ * Private helper functions
+ */
+
+/**
+ * Converts an ASCII letter to lowercase.
+ *
+ * @param c The character
+ * @return The lowercase letter or the character itself if it isn't one
+ */
+static char to_lower(char c) {
+    return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+/**
+ * Returns whether a byte is part of a word.
+ *
+ * @param c The byte
+ * @return 1 if it is, 0 otherwise
+ */
+static int is_word(char c) {
+    unsigned char u = c;
+
+    return (u >= 'a' && u <= 'z') || (u >= 'A' && u <= 'Z') ||
+        (u >= '0' && u <= '9') || u >= 0x80;
+}
+
+/**
+ * Hashes a word, ignoring case (FNV-1a).
+ *
+ * @param text The word
+ * @param length Length of the word
+ * @return The hash
+ */
+static uint32_t hash_word(const char *text, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; ++i) {
+        hash = (hash ^ (unsigned char) to_lower(text[i])) * 16777619u;
+    }
+
+    return hash;
+}
+
+/**
+ * Compares two words byte by byte, a shorter one first if it's a prefix.
+ *
+ * @param a The first word
+ * @param a_length Length of the first word
+ * @param b The second word
+ * @param b_length Length of the second word
+ * @return Integer greater than, equal to or less than 0 depending on how a
+ *         compares to b
+ */
+static int compare_words(
+    const char *a, size_t a_length, const char *b, size_t b_length) {
+    int result = memcmp(a, b, a_length < b_length ? a_length : b_length);
+    if (result != 0) {
+        return result;
+    }
+
+    return (a_length > b_length) - (a_length < b_length);
+}
+
+/**
+ * Compares two sorted_word structs.
+ *
+ * This is a comparison function to be passed into qsort().
+ *
+ * @param w1 The first sorted_word
+ * @param w2 The second sorted_word
+ * @return Integer greater than, equal to or less than 0 depending on how
+ *         w1 compares to w2
+ */
+static int cmpwordp(const void *w1, const void *w2) {
+    const struct sorted_word *a = w1, *b = w2;
+
+    return compare_words(a->text, a->word->length, b->text, b->word->length);
+}
+
+/**
+ * Compares two positions.
+ *
+ * This is a comparison function to be passed into qsort().
+ *
+ * @param p1 The first position
+ * @param p2 The second position
+ * @return Integer greater than, equal to or less than 0 depending on how
+ *         p1 compares to p2
+ */
+static int cmppositionp(const void *p1, const void *p2) {
+    uint32_t a = * (const uint32_t *) p1, b = * (const uint32_t *) p2;
+
+    return (a > b) - (a < b);
+}
+
+/**
+ * Finds the parts of a word table, checking that they add up to its size.
+ *
+ * @param table The table
+ * @param size Size of the table
+ * @param header Set to the header
+ * @param entries Set to the entries
+ * @param positions Set to the positions
+ * @param text Set to the text
+ * @return 0 on success or -1 if the table is corrupt
+ */
+static int open_table(
+    const char *table, size_t size, struct table_header *header,
+    const struct table_entry **entries, const uint32_t **positions,
+    const char **text) {
+    if (size < sizeof(*header)) {
+        return -1;
+    }
+    memcpy(header, table, sizeof(*header));
+    if (header->words > size / sizeof(struct table_entry) ||
+        header->postings > size / sizeof(uint32_t) ||
+        sizeof(*header) + header->words * sizeof(struct table_entry) +
+        header->postings * sizeof(uint32_t) + header->text_size != size) {
+        return -1;
+    }
+    *entries = (const struct table_entry *) (table + sizeof(*header));
+    *positions = (const uint32_t *) (*entries + header->words);
+    *text = (const char *) (*positions + header->postings);
+
+    return 0;
+}
+
+/**
+ * Checks that an entry lies within its word table.
+ *
+ * @param header The header of the table
+ * @param entry The entry
+ * @return 1 if it does, 0 otherwise
+ */
+static int valid_entry(
+    const struct table_header *header, const struct table_entry *entry) {
+    return (uint64_t) entry->text + entry->length <= header->text_size &&
+        (uint64_t) entry->first + entry->count <= header->postings;
+}
+
+/**
+ * Doubles the size of the hash table, inserting all words again.
+ *
+ * @param builder The WordsBuilder
+ */
+static void grow_slots(WordsBuilder builder) {
+    free(builder->slots);
+    builder->slot_count *= 2;
+    builder->slots = calloc(builder->slot_count, sizeof(uint32_t));
+    uint32_t mask = builder->slot_count - 1;
+    for (uint32_t i = 0; i < builder->length; ++i) {
+        uint32_t slot = builder->words[i].hash & mask;
+        while (builder->slots[slot]) {
+            slot = (slot + 1) & mask;
+        }
+        builder->slots[slot] = i + 1;
+    }
+}
+
+/**
+ * Finds a word in the WordsBuilder, adding it if it's new.
+ *
+ * @param builder The WordsBuilder
+ * @param text The word
+ * @param length Length of the word
+ * @return The word
+ */
+static struct word *find_word(
+    WordsBuilder builder, const char *text, size_t length) {
+    uint32_t hash = hash_word(text, length);
+    uint32_t mask = builder->slot_count - 1;
+    uint32_t slot = hash & mask;
+    for ( ; builder->slots[slot]; slot = (slot + 1) & mask) {
+        struct word *word = &builder->words[builder->slots[slot] - 1];
+        if (word->hash != hash || word->length != length) {
+            continue;
+        }
+        const char *word_text = builder->text + word->text;
+        size_t i = 0;
+        while (i < length && to_lower(text[i]) == word_text[i]) {
+            ++i;
+        }
+        if (i == length) {
+            return word;
+        }
+    }
+
+    // Store the new word with its text folded
+    if (builder->length == builder->size) {
+        builder->size *= 2;
+        builder->words = realloc(
+            builder->words, builder->size * sizeof(struct word));
+    }
+    if (builder->text_size - builder->text_length < length) {
+        while (builder->text_size - builder->text_length < length) {
+            builder->text_size *= 2;
+        }
+        builder->text = realloc(builder->text, builder->text_size);
+    }
+    struct word *word = &builder->words[builder->length];
+    word->hash = hash;
+    word->text = builder->text_length;
+    word->length = length;
+    word->count = 0;
+    for (size_t i = 0; i < length; ++i) {
+        builder->text[builder->text_length++] = to_lower(text[i]);
+    }
+    builder->slots[slot] = ++(builder->length);
+    // Keep the table at most half full
+    if (2 * builder->length > builder->slot_count) {
+        grow_slots(builder);
+    }
+
+    return &builder->words[builder->length - 1];
+}
+
+/*
+ * Public functions
+ */
+
+const char *words_next(const char *text, const char *end, size_t *length) {
+    while (text < end && !is_word(*text)) {
+        ++text;
+    }
+    if (text == end) {
+        return NULL;
+    }
+    const char *word_end = text;
+    while (word_end < end && is_word(*word_end)) {
+        ++word_end;
+    }
+    *length = word_end - text;
+
+    return text;
+}
+
+WordsBuilder words_builder_init(void) {
+    WordsBuilder builder = malloc(sizeof(*builder));
+    builder->words = malloc(STARTING_CAPACITY * sizeof(struct word));
+    builder->length = 0;
+    builder->size = STARTING_CAPACITY;
+    builder->slots = calloc(2 * STARTING_CAPACITY, sizeof(uint32_t));
+    builder->slot_count = 2 * STARTING_CAPACITY;
+    builder->postings = malloc(STARTING_CAPACITY * sizeof(struct posting));
+    builder->posting_count = 0;
+    builder->posting_size = STARTING_CAPACITY;
+    builder->text = malloc(STARTING_CAPACITY);
+    builder->text_length = 0;
+    builder->text_size = STARTING_CAPACITY;
+
+    return builder;
+}
+
+void words_builder_add(
+    WordsBuilder builder, const char *text, size_t length, uint32_t position) {
+    const char *end = text + length, *word_text;
+    size_t word_length;
+    for ( ; (word_text = words_next(text, end, &word_length));
+        text = word_text + word_length) {
+        struct word *word = find_word(builder, word_text, word_length);
+        // Every task counts once per word
+        if (word->count > 0 &&
+            builder->postings[word->last].position == position) {
+            continue;
+        }
+        if (builder->posting_count == builder->posting_size) {
+            builder->posting_size *= 2;
+            builder->postings = realloc(
+                builder->postings,
+                builder->posting_size * sizeof(struct posting));
+        }
+        uint32_t index = builder->posting_count++;
+        builder->postings[index].position = position;
+        if (word->count++ == 0) {
+            word->first = index;
+        } else {
+            builder->postings[word->last].next = index;
+        }
+        word->last = index;
+    }
+}
+
+char *words_builder_finish(WordsBuilder builder, size_t *size) {
+    // Sort the words, so they can be found by binary search
+    struct sorted_word *sorted = malloc(
+        (builder->length ? builder->length : 1) * sizeof(struct sorted_word));
+    for (uint32_t i = 0; i < builder->length; ++i) {
+        sorted[i].text = builder->text + builder->words[i].text;
+        sorted[i].word = &builder->words[i];
+    }
+    qsort(sorted, builder->length, sizeof(struct sorted_word), cmpwordp);
+
+    // Lay out the header, the entries, the positions and the text
+    struct table_header header = {
+        builder->length, builder->posting_count, builder->text_length};
+    *size = sizeof(header) + header.words * sizeof(struct table_entry) +
+        header.postings * sizeof(uint32_t) + header.text_size;
+    char *table = malloc(*size);
+    memcpy(table, &header, sizeof(header));
+    struct table_entry *entries = (struct table_entry *) (table +
+        sizeof(header));
+    uint32_t *positions = (uint32_t *) (entries + header.words);
+    char *text = (char *) (positions + header.postings);
+    uint32_t position_count = 0, text_length = 0;
+    for (uint32_t i = 0; i < builder->length; ++i) {
+        const struct word *word = sorted[i].word;
+        entries[i].text = text_length;
+        entries[i].length = word->length;
+        entries[i].first = position_count;
+        entries[i].count = word->count;
+        memcpy(text + text_length, sorted[i].text, word->length);
+        text_length += word->length;
+        // Follow the chain, which is in the order tasks were added
+        uint32_t index = word->first;
+        for (uint32_t j = 0; j < word->count; ++j) {
+            positions[position_count++] = builder->postings[index].position;
+            index = builder->postings[index].next;
+        }
+    }
+    free(sorted);
+
+    // Release the builder
+    free(builder->words);
+    free(builder->slots);
+    free(builder->postings);
+    free(builder->text);
+    free(builder);
+
+    return table;
+}
+
+char *words_update(
+    const char *table, size_t size, const uint32_t *positions, size_t count,
+    WordsBuilder builder, size_t *new_size) {
+    // The added tasks get a table of their own, which is merged in
+    size_t added_size;
+    char *added = words_builder_finish(builder, &added_size);
+    struct table_header old_header, added_header;
+    const struct table_entry *old_entries, *added_entries;
+    const uint32_t *old_positions, *added_positions;
+    const char *old_text, *added_text;
+    if (open_table(table, size, &old_header, &old_entries, &old_positions,
+        &old_text) == -1) {
+        free(added);
+        return NULL;
+    }
+    open_table(added, added_size, &added_header, &added_entries,
+        &added_positions, &added_text);
+
+    /*
+     * Merge the sorted words of both tables, dropping words that are gone
+     */
+    size_t word_capacity = old_header.words + added_header.words;
+    struct table_entry *entries = malloc(
+        (word_capacity ? word_capacity : 1) * sizeof(struct table_entry));
+    uint32_t *new_positions = malloc(
+        (old_header.postings + added_header.postings + 1) * sizeof(uint32_t));
+    char *text = malloc(old_header.text_size + added_header.text_size + 1);
+    uint32_t words = 0, postings = 0, text_size = 0;
+    size_t i = 0, j = 0;
+    while (i < old_header.words || j < added_header.words) {
+        const struct table_entry *old_entry = i < old_header.words ?
+            &old_entries[i] : NULL;
+        const struct table_entry *added_entry = j < added_header.words ?
+            &added_entries[j] : NULL;
+        if (old_entry && !valid_entry(&old_header, old_entry)) {
+            free(entries);
+            free(new_positions);
+            free(text);
+            free(added);
+            return NULL;
+        }
+        int order = !old_entry ? 1 : !added_entry ? -1 : compare_words(
+            old_text + old_entry->text, old_entry->length,
+            added_text + added_entry->text, added_entry->length);
+        const struct table_entry *word = order <= 0 ? old_entry : added_entry;
+        const char *word_text = order <= 0 ? old_text : added_text;
+
+        // Move the earlier positions to where the tasks are now
+        uint32_t first = postings;
+        int sorted = 1;
+        if (order <= 0) {
+            for (uint32_t k = 0; k < old_entry->count; ++k) {
+                uint32_t old = old_positions[old_entry->first + k];
+                uint32_t current = old > 0 && old <= count ?
+                    positions[old - 1] : 0;
+                if (current == 0) {
+                    continue;
+                }
+                sorted &= postings == first ||
+                    new_positions[postings - 1] < current;
+                new_positions[postings++] = current;
+            }
+            ++i;
+        }
+        if (order >= 0) {
+            for (uint32_t k = 0; k < added_entry->count; ++k) {
+                uint32_t current = added_positions[added_entry->first + k];
+                sorted &= postings == first ||
+                    new_positions[postings - 1] < current;
+                new_positions[postings++] = current;
+            }
+            ++j;
+        }
+        // Moved tasks can end up out of order
+        if (!sorted) {
+            qsort(new_positions + first, postings - first, sizeof(uint32_t),
+                cmppositionp);
+        }
+        if (postings == first) {
+            continue;
+        }
+        entries[words].text = text_size;
+        entries[words].length = word->length;
+        entries[words].first = first;
+        entries[words].count = postings - first;
+        memcpy(text + text_size, word_text + word->text, word->length);
+        text_size += word->length;
+        ++words;
+    }
+    free(added);
+
+    // Put the parts together
+    struct table_header header = {words, postings, text_size};
+    *new_size = sizeof(header) + words * sizeof(struct table_entry) +
+        postings * sizeof(uint32_t) + text_size;
+    char *new_table = malloc(*new_size);
+    char *end = new_table;
+    memcpy(end, &header, sizeof(header));
+    end += sizeof(header);
+    memcpy(end, entries, words * sizeof(struct table_entry));
+    end += words * sizeof(struct table_entry);
+    memcpy(end, new_positions, postings * sizeof(uint32_t));
+    end += postings * sizeof(uint32_t);
+    memcpy(end, text, text_size);
+    free(entries);
+    free(new_positions);
+    free(text);
+
+    return new_table;
+}
+
+long words_lookup(
+    const char *table, size_t size, const char *word, size_t length,
+    int prefix, uint32_t **positions) {
+    *positions = NULL;
+    struct table_header header;
+    const struct table_entry *entries;
+    const uint32_t *all_positions;
+    const char *text;
+    if (open_table(table, size, &header, &entries, &all_positions, &text) ==
+        -1) {
+        return -1;
+    }
+
+    // Words are stored folded
+    char folded[length ? length : 1];
+    for (size_t i = 0; i < length; ++i) {
+        folded[i] = to_lower(word[i]);
+    }
+
+    // Binary search for the first word that isn't smaller
+    size_t low = 0, high = header.words;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        const struct table_entry *entry = &entries[middle];
+        if (!valid_entry(&header, entry)) {
+            return -1;
+        }
+        if (compare_words(text + entry->text, entry->length, folded,
+            length) < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    // Collect the positions of the matching words
+    size_t count = 0, capacity = 0;
+    int merged = 0;
+    for (size_t i = low; i < header.words; ++i) {
+        const struct table_entry *entry = &entries[i];
+        if (!valid_entry(&header, entry)) {
+            free(*positions);
+            *positions = NULL;
+            return -1;
+        }
+        if (entry->length < length ||
+            memcmp(text + entry->text, folded, length) != 0 ||
+            (!prefix && entry->length != length)) {
+            break;
+        }
+        if (count + entry->count > capacity) {
+            capacity = 2 * (count + entry->count);
+            *positions = realloc(*positions, capacity * sizeof(uint32_t));
+        }
+        memcpy(*positions + count, all_positions + entry->first,
+            entry->count * sizeof(uint32_t));
+        count += entry->count;
+        merged += i > low;
+    }
+
+    // Positions of several words need to be put in order, once each
+    if (merged) {
+        qsort(*positions, count, sizeof(uint32_t), cmppositionp);
+        size_t unique = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (unique == 0 || (*positions)[unique - 1] != (*positions)[i]) {
+                (*positions)[unique++] = (*positions)[i];
+            }
+        }
+        count = unique;
+    }
+
+    return count;
+}
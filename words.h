@@ -0,0 +1,94 @@
+#ifndef WORDS_H
+#define WORDS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct words_builder *WordsBuilder;
+
+/**
+ * Finds the next word in a text.
+ *
+ * Words are runs of ASCII letters and digits along with any non-ASCII
+ * bytes, so words in other scripts stay whole.
+ *
+ * @param text The text (doesn't need to be terminated)
+ * @param end End of the text (exclusive)
+ * @param length Set to the length of the word
+ * @return Start of the word or NULL if there is none
+ */
+const char *words_next(const char *text, const char *end, size_t *length);
+
+/**
+ * Returns an initialized WordsBuilder, collecting the words of tasks.
+ *
+ * @return The new WordsBuilder
+ */
+WordsBuilder words_builder_init(void);
+
+/**
+ * Adds the words of a task to the WordsBuilder.
+ *
+ * Tasks need to be added in the order of their positions.
+ *
+ * @param builder The WordsBuilder
+ * @param text The task text (doesn't need to be terminated)
+ * @param length Length of the task text
+ * @param position Position of the task
+ */
+void words_builder_add(
+    WordsBuilder builder, const char *text, size_t length, uint32_t position);
+
+/**
+ * Builds the word table and releases the WordsBuilder.
+ *
+ * The table holds every word with the positions of the tasks it occurs in
+ * and can be searched in place, for example from a mapped file.
+ * Because a new buffer needs to be allocated, the user must free it.
+ *
+ * @param builder The WordsBuilder
+ * @param size Set to the size of the table
+ * @return The table (freed by user)
+ */
+char *words_builder_finish(WordsBuilder builder, size_t *size);
+
+/**
+ * Builds the word table of tasks from the table of an earlier version of
+ * them, so only the tasks added since need to be split into words.
+ *
+ * Because a new buffer needs to be allocated, the user must free it.
+ *
+ * @param table The earlier word table
+ * @param size Size of the earlier table
+ * @param positions The current position of the task at every earlier
+ *                  position (at index position - 1), 0 if it's gone
+ * @param count Number of earlier positions
+ * @param builder Holds the words of the added tasks, released by this
+ *                function
+ * @param new_size Set to the size of the new table
+ * @return The new table (freed by user) or NULL if the earlier one is
+ *         corrupt
+ */
+char *words_update(
+    const char *table, size_t size, const uint32_t *positions, size_t count,
+    WordsBuilder builder, size_t *new_size);
+
+/**
+ * Looks up the positions of the tasks containing a word in a word table.
+ *
+ * Case is ignored for ASCII letters. Because a new array needs to be
+ * allocated, the user must free it.
+ *
+ * @param table The word table
+ * @param size Size of the table
+ * @param word The word (a single one, see words_next())
+ * @param length Length of the word
+ * @param prefix Also find words starting with it (0 = false, 1 = true)
+ * @param positions Set to the sorted positions (freed by user)
+ * @return Number of positions or -1 if the table is corrupt
+ */
+long words_lookup(
+    const char *table, size_t size, const char *word, size_t length,
+    int prefix, uint32_t **positions);
+
+#endif // WORDS_H